@@ -3,10 +3,50 @@
 #include <string>
 #include <ctime>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <iterator>
 #include <vector>
+#include <thread>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PINGPONG_SSE
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PINGPONG_TSC
+#endif
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <SFML/Audio.hpp>
+#include <SFML/Network.hpp>
 
 using namespace std;
 using namespace sf;
@@ -24,6 +64,9 @@ public:
     static const int PADDLE_WIDTH = 20;
     static const int PADDLE_HEIGHT = 120;
     static const int BALL_RADIUS = 15;
+    static const int MULTI_BALL_COUNT = 300;
+    static const int MULTI_BALL_RADIUS = 4;
+    static const int MULTI_BALL_MAX_SCORE = 200;
     static const float BALL_SPEED;
     static const float PADDLE_SPEED;
 
@@ -50,1699 +93,12809 @@ const Color GameConstants::PLAYER2_COLOR = Color::Magenta;
 const Color GameConstants::INPUT_COLOR = Color::Yellow;
 
 
-class GameObject
+#ifdef PINGPONG_COUNT_ALLOCS
+// Allocation-counting build (-DPINGPONG_COUNT_ALLOCS): every heap allocation
+// bumps a global counter so frames can be checked for zero allocations.
+class AllocationCounter
 {
-protected:
-    float xPosition;
-    float yPosition;
-    float width;
-    float height;
-    Color objectColor;
-
 public:
+    static atomic<unsigned long long> count;
 
-    GameObject(float x, float y, float w, float h, Color c)
+    static unsigned long long get()
     {
-        xPosition = x;
-        yPosition = y;
-        width = w;
-        height = h;
-        objectColor = c;
+        return count.load(memory_order_relaxed);
     }
+};
 
-    // Virtual destructor
-    virtual ~GameObject()
-    {
+atomic<unsigned long long> AllocationCounter::count(0);
+
+#if defined(__GLIBC__)
+// On glibc malloc itself is hooked, which also catches operator new and C allocations
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    AllocationCounter::count.fetch_add(1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    AllocationCounter::count.fetch_add(1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
 
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    AllocationCounter::count.fetch_add(1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#else
+void* operator new(size_t size)
+{
+    AllocationCounter::count.fetch_add(1, memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw bad_alloc();
     }
+    return ptr;
+}
 
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
 
-    virtual void draw(RenderWindow& window) = 0;
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
 
-    // Getters
-    float getX() const
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+#endif
+#endif
+
+
+// Scoped-zone profiler, compiled in with PINGPONG_PROFILE. PROFILE_ZONE("name")
+// times the rest of the enclosing scope. Each thread writes finished zones into
+// its own ring, so recording takes no lock; Profiler::exportTrace writes the
+// rings as Chrome trace_event JSON (open it in chrome://tracing or Perfetto).
+// Without PINGPONG_PROFILE the macro expands to nothing.
+#ifdef PINGPONG_PROFILE
+#ifdef PINGPONG_TSC
+#define PINGPONG_PROFILE_TSC
+#endif
+
+class Profiler
+{
+public:
+    // Times are in ticks of now(); exportTrace converts them to nanoseconds
+    struct Zone
+    {
+        const char* name;
+        long long start;
+        long long end;
+    };
+
+    // Zones kept per thread; older ones are overwritten
+    static const int RING_SIZE = 1 << 16;
+
+    struct Ring
     {
-        return xPosition;
+        Zone zones[RING_SIZE];
+        atomic<unsigned long long> written;
+        int threadId;
+    };
+
+private:
+    static mutex& registryMutex()
+    {
+        static mutex instance;
+        return instance;
     }
 
-    float getY() const
+    // Rings live for the whole run, so threads that have exited still show up in exports
+    static vector<Ring*>& rings()
     {
-        return yPosition;
+        static vector<Ring*> instance;
+        return instance;
     }
 
-    float getWidth() const
+    static Ring* createRing()
     {
-        return width;
+        epoch();
+        Ring* ring = new Ring();
+        ring->written = 0;
+        lock_guard<mutex> lock(registryMutex());
+        ring->threadId = (int)rings().size() + 1;
+        rings().push_back(ring);
+        return ring;
     }
 
-    float getHeight() const
+    static long long steadyNs()
     {
-        return height;
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
     }
 
-    Color getColor() const
+    // First reading of both clocks, to turn ticks into nanoseconds later
+    struct Epoch
     {
-        return objectColor;
+        long long ticks;
+        long long ns;
+    };
+
+    static const Epoch& epoch()
+    {
+        static const Epoch instance = { now(), steadyNs() };
+        return instance;
     }
 
-    // Setters
-    void setX(float x)
+public:
+    // The time stamp counter is a few times cheaper to read than steady_clock
+    static long long now()
     {
-        xPosition = x;
+#ifdef PINGPONG_PROFILE_TSC
+        return (long long)__rdtsc();
+#else
+        return steadyNs();
+#endif
     }
 
-    void setY(float y)
+    // Nanoseconds per tick of now(), measured against steady_clock since the first zone
+    static double nsPerTick()
     {
-        yPosition = y;
+#ifdef PINGPONG_PROFILE_TSC
+        long long ticks = now() - epoch().ticks;
+        long long ns = steadyNs() - epoch().ns;
+        if (ticks <= 0 || ns <= 0)
+        {
+            return 1.0;
+        }
+        return ns / (double)ticks;
+#else
+        return 1.0;
+#endif
     }
 
-    void setColor(Color c)
+    static Ring& threadRing()
     {
-        objectColor = c;
+        thread_local Ring* ring = createRing();
+        return *ring;
     }
 
-    // Check if this object collides with another
-    bool checkCollision(const GameObject& other) const
+    // Only the owning thread writes; the release store publishes the zone to exporters
+    static void record(const char* name, long long start, long long end)
     {
-        bool collisionX = false;
-        bool collisionY = false;
+        Ring& ring = threadRing();
+        unsigned long long index = ring.written.load(memory_order_relaxed);
+        Zone& zone = ring.zones[index & (RING_SIZE - 1)];
+        zone.name = name;
+        zone.start = start;
+        zone.end = end;
+        ring.written.store(index + 1, memory_order_release);
+    }
 
-        // Check X axis collision
-        if (xPosition < other.xPosition + other.width)
+    // Write every zone still in the rings as Chrome trace JSON; returns zones written
+    static long long exportTrace(const string& path)
+    {
+        ofstream file(path);
+        if (!file)
         {
-            if (xPosition + width > other.xPosition)
-            {
-                collisionX = true;
-            }
+            return -1;
         }
 
-        // Check Y axis collision
-        if (yPosition < other.yPosition + other.height)
+        vector<Ring*> snapshot;
         {
-            if (yPosition + height > other.yPosition)
-            {
-                collisionY = true;
-            }
+            lock_guard<mutex> lock(registryMutex());
+            snapshot = rings();
         }
 
-        // Return true only if both axes collide
-        if (collisionX && collisionY)
-        {
-            return true;
-        }
-        else
+        double scale = nsPerTick();
+        long long origin = epoch().ticks;
+        long long exported = 0;
+        file << "{\"traceEvents\":[" << endl;
+        for (size_t r = 0; r < snapshot.size(); r++)
         {
-            return false;
+            Ring& ring = *snapshot[r];
+            unsigned long long end = ring.written.load(memory_order_acquire);
+            unsigned long long begin = (end > (unsigned long long)RING_SIZE) ? end - RING_SIZE : 0;
+
+            for (unsigned long long i = begin; i < end; i++)
+            {
+                Zone zone = ring.zones[i & (RING_SIZE - 1)];
+
+                // The owner may have lapped us while copying; such zones are skipped. The
+                // slot is already being rewritten once written reaches i + RING_SIZE, and the
+                // fence keeps the copy above from moving past the check
+                atomic_thread_fence(memory_order_acquire);
+                if (ring.written.load(memory_order_relaxed) - i >= (unsigned long long)RING_SIZE)
+                {
+                    continue;
+                }
+
+                if (exported > 0)
+                {
+                    file << "," << endl;
+                }
+                // Timestamps are microseconds since the first zone, with nanosecond decimals
+                long long startNs = (long long)((zone.start - origin) * scale);
+                long long durationNs = (long long)((zone.end - zone.start) * scale);
+                char line[256];
+                snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld}",
+                         zone.name, ring.threadId, startNs / 1000, startNs % 1000, durationNs / 1000, durationNs % 1000);
+                file << line;
+                exported = exported + 1;
+            }
         }
+        file << endl << "]}" << endl;
+        return exported;
     }
 };
 
-
-class Paddle : public GameObject
+class ProfileZone
 {
 private:
-    float speed;
-    int playerNumber;
-    int score;
-    RectangleShape paddleShape;
-    Color originalColor;
+    const char* name;
+    long long start;
 
 public:
-    // Constructor
-    Paddle(int playerNum) : GameObject(0, 0, GameConstants::PADDLE_WIDTH,
-                                       GameConstants::PADDLE_HEIGHT,
-                                       GameConstants::PADDLE_COLOR)
+    ProfileZone(const char* zoneName)
     {
-        playerNumber = playerNum;
-        score = 0;
-        speed = GameConstants::PADDLE_SPEED;
-        paddleShape.setSize(Vector2f(width, height));
-
+        name = zoneName;
+        start = Profiler::now();
+    }
 
-        if (playerNumber == 1)
-        {
-            originalColor = GameConstants::PLAYER1_COLOR;
-        }
-        else
-        {
-            originalColor = GameConstants::PLAYER2_COLOR;
-        }
+    ~ProfileZone()
+    {
+        Profiler::record(name, start, Profiler::now());
+    }
+};
 
-        paddleShape.setFillColor(originalColor);
-        paddleShape.setOutlineThickness(2);
-        paddleShape.setOutlineColor(Color::White);
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
 
-        resetPosition();
-    }
 
+// Structured logging off the game thread. A call copies its level, message and up
+// to four key=value fields into the calling thread's own queue; a background thread
+// formats them later and writes them in batches to game.log, which rotates at 1 MB.
+// A full queue drops the record rather than wait, so a log call never blocks a frame.
+enum LogLevel
+{
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR
+};
 
-    void resetPosition()
+// One key and value, copied into the record so nothing has to outlive the call.
+// Keys must be string literals; text values are cut to 31 characters.
+struct LogField
+{
+    enum Type
     {
-        if (playerNumber == 1)
-        {
-            xPosition = 50;
-        }
-        else
-        {
-            xPosition = GameConstants::WINDOW_WIDTH - 50 - width;
-        }
+        TYPE_NONE,
+        TYPE_INTEGER,
+        TYPE_REAL,
+        TYPE_TEXT
+    };
+
+    const char* key;
+    int type;
+    union
+    {
+        long long integer;
+        double real;
+        char text[32];
+    };
 
-        yPosition = GameConstants::WINDOW_HEIGHT / 2 - height / 2;
-        paddleShape.setPosition(xPosition, yPosition);
+    LogField()
+    {
+        key = nullptr;
+        type = TYPE_NONE;
     }
 
-
-    void moveUp()
+    LogField(const char* name, int value)
     {
-        if (yPosition > 0)
-        {
-            yPosition = yPosition - speed;
-            if (yPosition < 0)
-            {
-                yPosition = 0;
-            }
-            paddleShape.setPosition(xPosition, yPosition);
-        }
+        key = name;
+        type = TYPE_INTEGER;
+        integer = value;
     }
 
-
-    void moveDown()
+    LogField(const char* name, long long value)
     {
-        if (yPosition + height < GameConstants::WINDOW_HEIGHT)
-        {
-            yPosition = yPosition + speed;
-            if (yPosition + height > GameConstants::WINDOW_HEIGHT)
-            {
-                yPosition = GameConstants::WINDOW_HEIGHT - height;
-            }
-            paddleShape.setPosition(xPosition, yPosition);
-        }
+        key = name;
+        type = TYPE_INTEGER;
+        integer = value;
     }
 
-
-    void draw(RenderWindow& window)
+    LogField(const char* name, double value)
     {
-        window.draw(paddleShape);
+        key = name;
+        type = TYPE_REAL;
+        real = value;
     }
 
-    int getScore() const
+    LogField(const char* name, const char* value)
     {
-        return score;
+        key = name;
+        type = TYPE_TEXT;
+        size_t length = strnlen(value, sizeof(text) - 1);
+        memcpy(text, value, length);
+        text[length] = 0;
     }
 
-    int getPlayerNumber() const
+    LogField(const char* name, const string& value) : LogField(name, value.c_str())
     {
-        return playerNumber;
     }
+};
 
-    RectangleShape getShape() const
+class Logger
+{
+public:
+    static const int QUEUE_SIZE = 1024;
+    static constexpr int MAX_THREADS = 64;
+    static const int MAX_FIELDS = 4;
+    static const long long MAX_FILE_BYTES = 1 << 20;
+    static const int ROTATED_FILES = 3;
+    static constexpr int WRITE_INTERVAL_MS = 100;
+
+    struct Record
     {
-        return paddleShape;
-    }
+        long long ticks;
+        const char* message;
+        int level;
+        int fieldCount;
+        LogField fields[MAX_FIELDS];
+    };
+
+    // Written only by its thread (head) and the writer (tail). released is set
+    // when the thread exits; the queue is reused once the writer has emptied it.
+    struct Queue
+    {
+        Record records[QUEUE_SIZE];
+        atomic<unsigned long long> head;
+        atomic<unsigned long long> tail;
+        atomic<bool> released;
+        int threadId;
+    };
 
-    float getCenterY() const
+private:
+    // Hands a thread's queue back when the thread exits, so short-lived workers do not use up the slots
+    struct QueueOwner
     {
-        return yPosition + height / 2;
-    }
+        Queue* queue;
+        bool exited;
 
+        QueueOwner(Logger& logger) : queue(logger.createQueue()), exited(false)
+        {
+        }
 
-    void setScore(int s)
+        ~QueueOwner()
+        {
+            if (queue != nullptr)
+            {
+                queue->released.store(true, memory_order_release);
+                queue = nullptr;
+            }
+            exited = true;
+        }
+    };
+
+    // Queues are never freed, so a thread that has exited still gets its last records written.
+    // A slot is published with release; the writer may see the count first and skip a null slot.
+    atomic<Queue*> queues[MAX_THREADS];
+    atomic<int> queueCount;
+    atomic<int> nextThreadId;
+    atomic<int> minimumLevel;
+    atomic<unsigned long long> dropped;
+    unsigned long long droppedReported;
+    atomic<bool> running;
+
+    mutex wakeMutex;
+    condition_variable wake;
+    thread writer;
+
+    ofstream file;
+    long long fileBytes;
+    long long epochTicks;
+    long long epochSteadyNs;
+    long long epochWallNs;
+    double nsPerTick;
+    char line[512];
+    char batch[64 * 1024];
+    size_t batchBytes;
+
+    static long long steadyNs()
     {
-        score = s;
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
     }
 
-    void incrementScore()
+    // Records are stamped with the time stamp counter where there is one, as it is
+    // several times cheaper to read than steady_clock; the writer converts it
+    static long long now()
     {
-        score = score + 1;
+#ifdef PINGPONG_TSC
+        return (long long)__rdtsc();
+#else
+        return steadyNs();
+#endif
     }
 
-    // Update paddle position
-    void updatePosition()
+    static char* path()
     {
-        paddleShape.setPosition(xPosition, yPosition);
+        static char instance[64] = "game.log";
+        return instance;
     }
 
-    // Flash paddle when score is made
-    void flash()
+    Logger()
     {
-        paddleShape.setFillColor(Color::Yellow);
+        queueCount = 0;
+        nextThreadId = 1;
+        for (int i = 0; i < MAX_THREADS; i++)
+        {
+            queues[i].store(nullptr, memory_order_relaxed);
+        }
+        minimumLevel = LOG_DEBUG;
+        dropped = 0;
+        droppedReported = 0;
+        batchBytes = 0;
+        epochTicks = now();
+        epochSteadyNs = steadyNs();
+        nsPerTick = 1.0;
+        epochWallNs = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+        file.open(path(), ios::app);
+        fileBytes = 0;
+        if (file.is_open() == true)
+        {
+            fileBytes = (long long)file.tellp();
+        }
+
+        running = true;
+        writer = thread(&Logger::writeLoop, this);
     }
 
-    // Reset paddle color
-    void resetColor()
+    ~Logger()
     {
-        paddleShape.setFillColor(originalColor);
+        running = false;
+        wake.notify_one();
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+        for (int i = 0; i < min((int)queueCount, MAX_THREADS); i++)
+        {
+            delete queues[i].load(memory_order_acquire);
+        }
     }
-};
-
-
-class Ball : public GameObject
-{
-private:
-    float velocityX;
-    float velocityY;
-    float speed;
-    CircleShape ballShape;
-    bool isActive;
-
-public:
 
-    Ball() : GameObject(GameConstants::WINDOW_WIDTH / 2,
-                       GameConstants::WINDOW_HEIGHT / 2,
-                       GameConstants::BALL_RADIUS * 2,
-                       GameConstants::BALL_RADIUS * 2,
-                       GameConstants::BALL_COLOR)
+    static Logger& instance()
     {
-        speed = GameConstants::BALL_SPEED;
-        isActive = true;
-        ballShape.setRadius(GameConstants::BALL_RADIUS);
-        ballShape.setFillColor(objectColor);
-        ballShape.setOutlineThickness(2);
-        ballShape.setOutlineColor(Color::White);
-        ballShape.setPosition(xPosition, yPosition);
-
-        reset();
+        static Logger logger;
+        return logger;
     }
 
-
-    void reset()
+    Queue* createQueue()
     {
-        xPosition = GameConstants::WINDOW_WIDTH / 2 - GameConstants::BALL_RADIUS;
-        yPosition = GameConstants::WINDOW_HEIGHT / 2 - GameConstants::BALL_RADIUS;
-
-        // Random direction for X
-        int randomDirectionX = rand() % 2;
-        int directionX;
-        if (randomDirectionX == 0)
-        {
-            directionX = 1;
-        }
-        else
+        // Take over the queue of a thread that has exited, once its last records are written.
+        // Its head no longer moves, and the exchange keeps two new threads from both taking it.
+        int count = min((int)queueCount, MAX_THREADS);
+        for (int i = 0; i < count; i++)
         {
-            directionX = -1;
+            Queue* queue = queues[i].load(memory_order_acquire);
+            bool released = true;
+            if (queue != nullptr && queue->released.load(memory_order_acquire) == true &&
+                queue->tail.load(memory_order_acquire) == queue->head.load(memory_order_relaxed) &&
+                queue->released.compare_exchange_strong(released, false, memory_order_acq_rel) == true)
+            {
+                queue->threadId = nextThreadId.fetch_add(1);
+                return queue;
+            }
         }
 
-        // Random direction for Y
-        int randomDirectionY = rand() % 2;
-        int directionY;
-        if (randomDirectionY == 0)
+        if (queueCount.load() >= MAX_THREADS)
         {
-            directionY = 1;
+            return nullptr;
         }
-        else
+        int index = queueCount.fetch_add(1);
+        if (index >= MAX_THREADS)
         {
-            directionY = -1;
+            return nullptr;
         }
 
-        // Random Y velocity
-        int randomY = rand() % 3 + 1;
-        velocityX = speed * directionX;
-        velocityY = speed * randomY * 0.5 * directionY;
+        Queue* queue = new Queue();
+        queue->head = 0;
+        queue->tail = 0;
+        queue->released = false;
+        queue->threadId = nextThreadId.fetch_add(1);
+        queues[index].store(queue, memory_order_release);
+        return queue;
+    }
+
+    Queue* threadQueue()
+    {
+        // A thread that found every slot taken tries again, as exited threads free theirs
+        thread_local QueueOwner owner(*this);
+        if (owner.queue == nullptr && owner.exited == false)
+        {
+            owner.queue = createQueue();
+        }
+        return owner.queue;
+    }
 
-        ballShape.setPosition(xPosition, yPosition);
-        isActive = true;
+    static const char* getLevelName(int level)
+    {
+        static const char* names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+        return names[level];
     }
 
-    // Update ball position
-    void update()
+    void writeBatch()
     {
-        if (isActive == false)
+        if (batchBytes == 0)
         {
             return;
         }
+        if (file.is_open() == true)
+        {
+            file.write(batch, batchBytes);
+            file.flush();
+            fileBytes = fileBytes + (long long)batchBytes;
+        }
+        batchBytes = 0;
 
-        xPosition = xPosition + velocityX;
-        yPosition = yPosition + velocityY;
-
-        // Bounce off top
-        if (yPosition <= 0)
+        if (fileBytes >= MAX_FILE_BYTES)
         {
-            velocityY = -velocityY;
-            yPosition = 0;
+            rotate();
         }
+    }
 
-        // Bounce off bottom
-        if (yPosition + height >= GameConstants::WINDOW_HEIGHT)
+    // game.log becomes game.log.1, game.log.1 becomes game.log.2, and so on
+    void rotate()
+    {
+        file.close();
+        char from[80];
+        char to[80];
+        for (int i = ROTATED_FILES; i >= 1; i--)
         {
-            velocityY = -velocityY;
-            yPosition = GameConstants::WINDOW_HEIGHT - height;
+            snprintf(to, sizeof(to), "%s.%d", path(), i);
+            if (i == 1)
+            {
+                snprintf(from, sizeof(from), "%s", path());
+            }
+            else
+            {
+                snprintf(from, sizeof(from), "%s.%d", path(), i - 1);
+            }
+            remove(to);
+            rename(from, to);
         }
+        file.open(path(), ios::trunc);
+        fileBytes = 0;
+    }
 
-        ballShape.setPosition(xPosition, yPosition);
+    // Format one record into line; returns where the message starts, for the console copy
+    int format(const Record& record, int threadId)
+    {
+        long long wallNs = epochWallNs + (long long)((record.ticks - epochTicks) * nsPerTick);
+        time_t seconds = (time_t)(wallNs / 1000000000);
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &seconds);
+#else
+        localtime_r(&seconds, &local);
+#endif
+        int length = (int)strftime(line, sizeof(line), "%Y-%m-%d %H:%M:%S", &local);
+        length += snprintf(line + length, sizeof(line) - length, ".%03d t%d ",
+                           (int)(wallNs / 1000000 % 1000), threadId);
+        int messageStart = length;
+        length += snprintf(line + length, sizeof(line) - length, "%-5s %s", getLevelName(record.level), record.message);
+
+        for (int i = 0; i < record.fieldCount && length < (int)sizeof(line) - 64; i++)
+        {
+            const LogField& field = record.fields[i];
+            if (field.type == LogField::TYPE_INTEGER)
+            {
+                length += snprintf(line + length, sizeof(line) - length, " %s=%lld", field.key, field.integer);
+            }
+            else if (field.type == LogField::TYPE_REAL)
+            {
+                length += snprintf(line + length, sizeof(line) - length, " %s=%g", field.key, field.real);
+            }
+            else if (strchr(field.text, ' ') != nullptr || field.text[0] == 0)
+            {
+                length += snprintf(line + length, sizeof(line) - length, " %s=\"%s\"", field.key, field.text);
+            }
+            else
+            {
+                length += snprintf(line + length, sizeof(line) - length, " %s=%s", field.key, field.text);
+            }
+        }
+        length = min(length, (int)sizeof(line) - 2);
+        line[length] = '\n';
+        line[length + 1] = 0;
+        return messageStart;
     }
 
-    // Bounce from paddle with angle calculation
-    void bounceFromPaddle(const Paddle& paddle)
+    // Drain every queue; lines go to the batch, and INFO and above also to the console
+    void drain()
     {
-        velocityX = -velocityX * 1.05f;
+#ifdef PINGPONG_TSC
+        long long ticks = now() - epochTicks;
+        long long ns = steadyNs() - epochSteadyNs;
+        if (ticks > 0 && ns > 0)
+        {
+            nsPerTick = ns / (double)ticks;
+        }
+#endif
+        bool echoed = false;
+        int count = min((int)queueCount, MAX_THREADS);
+        for (int q = 0; q < count; q++)
+        {
+            Queue* queue = queues[q].load(memory_order_acquire);
+            if (queue == nullptr)
+            {
+                continue;
+            }
+
+            unsigned long long tail = queue->tail.load(memory_order_relaxed);
+            unsigned long long head = queue->head.load(memory_order_acquire);
+            while (tail < head)
+            {
+                const Record& record = queue->records[tail & (QUEUE_SIZE - 1)];
+                int messageStart = format(record, queue->threadId);
+                size_t length = strlen(line);
+                if (batchBytes + length > sizeof(batch))
+                {
+                    writeBatch();
+                }
+                memcpy(batch + batchBytes, line, length);
+                batchBytes = batchBytes + length;
+
+                if (record.level >= LOG_INFO)
+                {
+                    cout << line + messageStart;
+                    echoed = true;
+                }
 
-        // Calculate bounce angle based on where the ball hit the paddle
-        float ballCenterY = yPosition + GameConstants::BALL_RADIUS;
-        float paddleCenterY = paddle.getCenterY();
-        float hitPosition = ballCenterY - paddleCenterY;
-        float normalizedHit = hitPosition / (paddle.getHeight() / 2);
-        velocityY = normalizedHit * speed;
+                tail = tail + 1;
+                queue->tail.store(tail, memory_order_release);
+            }
+        }
 
-        // Limit maximum angle
-        if (velocityY > speed)
+        unsigned long long totalDropped = dropped.load();
+        if (totalDropped > droppedReported)
         {
-            velocityY = speed;
+            int length = snprintf(line, sizeof(line), "WARN  %llu log records dropped, queues were full\n",
+                                  totalDropped - droppedReported);
+            droppedReported = totalDropped;
+            if (batchBytes + length <= sizeof(batch))
+            {
+                memcpy(batch + batchBytes, line, length);
+                batchBytes = batchBytes + length;
+            }
         }
 
-        if (velocityY < -speed)
+        writeBatch();
+        if (echoed == true)
         {
-            velocityY = -speed;
+            cout.flush();
         }
     }
 
-    // Draw the ball
-    void draw(RenderWindow& window)
+    void writeLoop()
     {
-        if (isActive == true)
+        while (true)
         {
-            window.draw(ballShape);
+            bool stopping = running == false;
+            drain();
+            if (stopping == true)
+            {
+                return;
+            }
+
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait_for(lock, chrono::milliseconds(WRITE_INTERVAL_MS));
         }
     }
 
-    // Check if ball is out of bounds
-    bool isOutOfBounds() const
+public:
+    static void write(int level, const char* message, const LogField& a, const LogField& b,
+                      const LogField& c, const LogField& d)
     {
-        if (xPosition < 0)
+        Logger& logger = instance();
+        if (level < logger.minimumLevel.load(memory_order_relaxed))
         {
-            return true;
+            return;
         }
 
-        if (xPosition > GameConstants::WINDOW_WIDTH)
+        Queue* queue = logger.threadQueue();
+        if (queue == nullptr)
         {
-            return true;
+            logger.dropped.fetch_add(1, memory_order_relaxed);
+            return;
         }
 
-        return false;
-    }
-
-    // Check which side the ball went out
-    int getOutSide() const
-    {
-        if (xPosition < 0)
+        unsigned long long head = queue->head.load(memory_order_relaxed);
+        if (head - queue->tail.load(memory_order_acquire) >= (unsigned long long)QUEUE_SIZE)
         {
-            return 1;
+            logger.dropped.fetch_add(1, memory_order_relaxed);
+            return;
         }
 
-        if (xPosition > GameConstants::WINDOW_WIDTH)
+        Record& record = queue->records[head & (QUEUE_SIZE - 1)];
+        record.ticks = now();
+        record.message = message;
+        record.level = level;
+        const LogField* fields[MAX_FIELDS] = { &a, &b, &c, &d };
+        int count = 0;
+        for (int i = 0; i < MAX_FIELDS; i++)
         {
-            return 2;
+            if (fields[i]->type != LogField::TYPE_NONE)
+            {
+                record.fields[count] = *fields[i];
+                count = count + 1;
+            }
         }
-
-        return 0;
+        record.fieldCount = count;
+        queue->head.store(head + 1, memory_order_release);
     }
 
-    // Getters
-    float getVelocityX() const
+    // message must be a string literal: only the pointer is queued
+    static void debug(const char* message, const LogField& a = LogField(), const LogField& b = LogField(),
+                      const LogField& c = LogField(), const LogField& d = LogField())
     {
-        return velocityX;
+        write(LOG_DEBUG, message, a, b, c, d);
     }
 
-    float getVelocityY() const
+    static void info(const char* message, const LogField& a = LogField(), const LogField& b = LogField(),
+                     const LogField& c = LogField(), const LogField& d = LogField())
     {
-        return velocityY;
+        write(LOG_INFO, message, a, b, c, d);
     }
 
-    bool getIsActive() const
+    static void warning(const char* message, const LogField& a = LogField(), const LogField& b = LogField(),
+                        const LogField& c = LogField(), const LogField& d = LogField())
     {
-        return isActive;
+        write(LOG_WARNING, message, a, b, c, d);
     }
 
-    CircleShape getShape() const
+    static void error(const char* message, const LogField& a = LogField(), const LogField& b = LogField(),
+                      const LogField& c = LogField(), const LogField& d = LogField())
     {
-        return ballShape;
+        write(LOG_ERROR, message, a, b, c, d);
     }
 
-    // Setters
-    void setVelocityX(float vx)
+    // Only takes effect before the first log call, which opens the file
+    static void setPath(const char* file)
     {
-        velocityX = vx;
+        snprintf(path(), 64, "%s", file);
     }
 
-    void setVelocityY(float vy)
+    // Records below this level are discarded by the caller before anything is copied
+    static void setMinimumLevel(int level)
     {
-        velocityY = vy;
+        instance().minimumLevel = level;
     }
 
-    void setIsActive(bool active)
+    // Have the writer drain the queues now instead of at its next interval
+    static void flush()
     {
-        isActive = active;
+        instance().wake.notify_one();
+    }
+
+    static unsigned long long getDropped()
+    {
+        return instance().dropped.load();
     }
 };
 
-class GameText
+
+// Health metrics for scraping. The game thread and workers update relaxed
+// atomics and never lock; a background thread serves them in the Prometheus
+// text format on 127.0.0.1, port 9108 unless PINGPONG_METRICS_PORT says
+// otherwise (0 turns the endpoint off).
+class MetricsHistogram
 {
+public:
+    static const int MAX_BOUNDS = 10;
+
 private:
-    Font font;
-    Text text;
-    bool fontLoaded;
+    const double* bounds;
+    int boundCount;
+    atomic<unsigned long long> buckets[MAX_BOUNDS + 1];
+    atomic<unsigned long long> count;
+    atomic<unsigned long long> sumNanos;
 
 public:
-    GameText()
+    MetricsHistogram(const double* upperBounds, int upperBoundCount)
     {
-        fontLoaded = false;
-        loadFont();
+        bounds = upperBounds;
+        boundCount = min(upperBoundCount, (int)MAX_BOUNDS);
+        for (int i = 0; i <= MAX_BOUNDS; i++)
+        {
+            buckets[i] = 0;
+        }
+        count = 0;
+        sumNanos = 0;
     }
 
-    // Try to load font
-    void loadFont()
+    void observe(double seconds)
     {
-        bool loadSuccess = font.loadFromFile("arial.ttf");
-
-        if (loadSuccess == false)
+        int bucket = 0;
+        while (bucket < boundCount && seconds > bounds[bucket])
         {
-            loadSuccess = font.loadFromFile("C:\\Windows\\Fonts\\arial.ttf");
-
-            if (loadSuccess == false)
-            {
-                cout << "Warning: Could not load font. Text will not display properly." << endl;
-                return;
-            }
+            bucket = bucket + 1;
         }
-
-        fontLoaded = true;
-        text.setFont(font);
+        buckets[bucket].fetch_add(1, memory_order_relaxed);
+        count.fetch_add(1, memory_order_relaxed);
+        sumNanos.fetch_add((unsigned long long)(max(seconds, 0.0) * 1e9), memory_order_relaxed);
     }
 
-    // Draw text at position
-    void draw(RenderWindow& window, string str, int size, float x, float y, Color color = GameConstants::TEXT_COLOR)
+    // Buckets are kept apart so an update is one add; the cumulative counts are built here
+    void write(string& out, const char* name, const char* labels) const
     {
-        if (fontLoaded == false)
+        char line[256];
+        const char* separator = labels[0] == 0 ? "" : ",";
+        unsigned long long cumulative = 0;
+        for (int i = 0; i <= boundCount; i++)
         {
-            return;
+            cumulative = cumulative + buckets[i].load(memory_order_relaxed);
+            if (i < boundCount)
+            {
+                snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, separator, bounds[i], cumulative);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, separator, cumulative);
+            }
+            out += line;
         }
 
-        text.setString(str);
-        text.setCharacterSize(size);
-        text.setFillColor(color);
-        text.setPosition(x, y);
-        window.draw(text);
+        const char* open = labels[0] == 0 ? "" : "{";
+        const char* close = labels[0] == 0 ? "" : "}";
+        snprintf(line, sizeof(line), "%s_sum%s%s%s %.9f\n%s_count%s%s%s %llu\n",
+                 name, open, labels, close, sumNanos.load(memory_order_relaxed) / 1e9,
+                 name, open, labels, close, count.load(memory_order_relaxed));
+        out += line;
     }
+};
 
-    // Draw centered text
-    void drawCentered(RenderWindow& window, string str, int size, float y, Color color = GameConstants::TEXT_COLOR)
+class Metrics
+{
+public:
+    enum IoOperation
     {
-        if (fontLoaded == false)
-        {
-            return;
-        }
+        IO_SAVE_GAME,
+        IO_LOAD_GAME,
+        IO_SAVE_HIGH_SCORES,
+        IO_LOAD_HIGH_SCORES,
+        IO_SAVE_HISTORY,
+        IO_COUNT
+    };
 
-        text.setString(str);
-        text.setCharacterSize(size);
-        text.setFillColor(color);
+    static const int DEFAULT_PORT = 9108;
+    static const int POLL_MS = 200;
+    static const int MAX_REQUEST_BYTES = 4096;
 
-        FloatRect textBounds = text.getLocalBounds();
-        float centerX = textBounds.left + textBounds.width / 2.0f;
-        float centerY = textBounds.top + textBounds.height / 2.0f;
-        text.setOrigin(centerX, centerY);
-        text.setPosition(GameConstants::WINDOW_WIDTH / 2.0f, y);
+    // A frame on an animated screen counts as dropped past one and a half 60 Hz frames
+    static constexpr double DROPPED_FRAME_SECONDS = 1.5 / 60;
 
-        window.draw(text);
+private:
+    static const double FRAME_BOUNDS[9];
+    static const double TICK_BOUNDS[9];
+    static const double IO_BOUNDS[8];
+
+    MetricsHistogram frameSeconds;
+    MetricsHistogram tickSeconds;
+    MetricsHistogram ioSeconds[IO_COUNT];
+    atomic<unsigned long long> frames;
+    atomic<unsigned long long> droppedFrames;
+    atomic<unsigned long long> ticks;
+    atomic<unsigned long long> matches;
+    atomic<float> framesPerSecond;
+    atomic<int> gameState;
+    atomic<const char*> screenName;
+
+    // Only the thread that draws frames touches these
+    Clock fpsClock;
+    int fpsFrames;
+
+    atomic<bool> running;
+    thread server;
+    string body;
+    string response;
+
+    Metrics() : frameSeconds(FRAME_BOUNDS, 9), tickSeconds(TICK_BOUNDS, 9),
+                ioSeconds{ MetricsHistogram(IO_BOUNDS, 8), MetricsHistogram(IO_BOUNDS, 8), MetricsHistogram(IO_BOUNDS, 8),
+                           MetricsHistogram(IO_BOUNDS, 8), MetricsHistogram(IO_BOUNDS, 8) }
+    {
+        frames = 0;
+        droppedFrames = 0;
+        ticks = 0;
+        matches = 0;
+        framesPerSecond = 0;
+        gameState = 0;
+        screenName = "loading";
+        fpsFrames = 0;
+        running = false;
     }
 
-    bool isFontLoaded() const
+    ~Metrics()
     {
-        return fontLoaded;
+        running = false;
+        if (server.joinable())
+        {
+            server.join();
+        }
     }
-};
 
-class GameSounds
-{
-private:
-    SoundBuffer paddleHitBuffer;
-    SoundBuffer wallHitBuffer;
-    SoundBuffer scoreBuffer;
-    Sound paddleHitSound;
-    Sound wallHitSound;
-    Sound scoreSound;
-    bool soundsLoaded;
+    static Metrics& instance()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
 
-public:
-    GameSounds()
+    static const char* getIoName(int operation)
     {
-        soundsLoaded = false;
-        loadSounds();
+        static const char* names[IO_COUNT] =
+        {
+            "save_game", "load_game", "save_high_scores", "load_high_scores", "save_history"
+        };
+        return names[operation];
     }
 
-    void loadSounds()
+    void writeCounter(const char* name, const char* help, const char* type, double value)
     {
-        soundsLoaded = true;
+        char line[256];
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+        body += line;
     }
 
-    void playPaddleHit()
+    void buildBody()
     {
-        if (soundsLoaded == true)
+        char line[256];
+        body.clear();
+
+        body += "# HELP pingpong_frame_seconds Frame time on the animated screens.\n# TYPE pingpong_frame_seconds histogram\n";
+        frameSeconds.write(body, "pingpong_frame_seconds", "");
+        body += "# HELP pingpong_tick_seconds Time to simulate one gameplay tick.\n# TYPE pingpong_tick_seconds histogram\n";
+        tickSeconds.write(body, "pingpong_tick_seconds", "");
+        body += "# HELP pingpong_io_seconds Time taken by save and high score file operations.\n# TYPE pingpong_io_seconds histogram\n";
+        for (int i = 0; i < IO_COUNT; i++)
         {
-            paddleHitSound.play();
+            snprintf(line, sizeof(line), "operation=\"%s\"", getIoName(i));
+            ioSeconds[i].write(body, "pingpong_io_seconds", line);
         }
+
+        writeCounter("pingpong_frames_total", "Frames drawn.", "counter", (double)frames.load(memory_order_relaxed));
+        writeCounter("pingpong_dropped_frames_total", "Frames on animated screens that took longer than 1.5 frames at 60 Hz.",
+                     "counter", (double)droppedFrames.load(memory_order_relaxed));
+        writeCounter("pingpong_fps", "Frames drawn in the last second.", "gauge", framesPerSecond.load(memory_order_relaxed));
+        writeCounter("pingpong_ticks_total", "Gameplay ticks simulated.", "counter", (double)ticks.load(memory_order_relaxed));
+        writeCounter("pingpong_matches_played_total", "Matches played to the end.", "counter",
+                     (double)matches.load(memory_order_relaxed));
+        writeCounter("pingpong_game_state", "Game state: 0 menu, 1 playing, 2 paused, 3 game over, 4 high scores.",
+                     "gauge", gameState.load(memory_order_relaxed));
+        snprintf(line, sizeof(line), "# HELP pingpong_screen Screen being shown.\n# TYPE pingpong_screen gauge\n"
+                 "pingpong_screen{screen=\"%s\"} 1\n", screenName.load(memory_order_relaxed));
+        body += line;
+        writeCounter("pingpong_log_dropped_total", "Log records dropped because a queue was full.", "counter",
+                     (double)Logger::getDropped());
+#ifdef PINGPONG_COUNT_ALLOCS
+        writeCounter("pingpong_allocations_total", "Heap allocations on every thread.", "counter",
+                     (double)AllocationCounter::get());
+#endif
     }
 
-    void playWallHit()
+    // Answer one scrape; anything but /metrics or / gets a 404
+    void answer(TcpSocket& client)
     {
-        if (soundsLoaded == true)
+        char request[MAX_REQUEST_BYTES];
+        size_t received = 0;
+        SocketSelector selector;
+        selector.add(client);
+        while (received < sizeof(request) - 1 && selector.wait(seconds(1)) == true)
         {
-            wallHitSound.play();
+            size_t count = 0;
+            if (client.receive(request + received, sizeof(request) - 1 - received, count) != Socket::Done)
+            {
+                break;
+            }
+            received = received + count;
+            request[received] = 0;
+            if (strstr(request, "\r\n\r\n") != nullptr)
+            {
+                break;
+            }
         }
-    }
+        request[received] = 0;
 
-    void playScore()
-    {
-        if (soundsLoaded == true)
+        response.clear();
+        if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0)
         {
-            scoreSound.play();
+            buildBody();
+            char header[160];
+            snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %d\r\nConnection: close\r\n\r\n", (int)body.size());
+            response += header;
+            response += body;
         }
+        else
+        {
+            response += "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+        client.send(response.data(), response.size());
+        client.disconnect();
     }
 
-    bool areSoundsLoaded() const
+    // Waits in short slices so the thread notices shutdown
+    void serve(unsigned short port)
     {
-        return soundsLoaded;
-    }
-};
-
+        TcpListener listener;
+        if (listener.listen(port, IpAddress::LocalHost) != Socket::Done)
+        {
+            Logger::warning("Metrics endpoint unavailable", LogField("port", (int)port));
+            return;
+        }
+        Logger::info("Serving metrics", LogField("address", "127.0.0.1"), LogField("port", (int)port));
 
-class HighScoreEntry
-{
-private:
-    string playerName;
-    int score;
+        SocketSelector selector;
+        selector.add(listener);
+        while (running == true)
+        {
+            if (selector.wait(milliseconds(POLL_MS)) == false)
+            {
+                continue;
+            }
+            TcpSocket client;
+            if (listener.accept(client) == Socket::Done)
+            {
+                answer(client);
+            }
+        }
+        listener.close();
+    }
 
 public:
-    HighScoreEntry()
+    // Start the endpoint once per process; the port comes from PINGPONG_METRICS_PORT if set
+    static void startServer()
     {
-        playerName = "";
-        score = 0;
+        Metrics& metrics = instance();
+        if (metrics.running == true)
+        {
+            return;
+        }
+
+        int port = DEFAULT_PORT;
+        const char* setting = getenv("PINGPONG_METRICS_PORT");
+        if (setting != nullptr)
+        {
+            port = atoi(setting);
+        }
+        if (port <= 0 || port > 65535)
+        {
+            return;
+        }
+
+        metrics.body.reserve(16 * 1024);
+        metrics.response.reserve(16 * 1024);
+        metrics.running = true;
+        metrics.server = thread(&Metrics::serve, &metrics, (unsigned short)port);
     }
 
-    HighScoreEntry(string name, int s)
+    // Called once per frame by the thread that draws
+    static void recordFrame(double seconds, const char* screen, bool animated, int state)
     {
-        playerName = name;
-        score = s;
+        Metrics& metrics = instance();
+        metrics.frames.fetch_add(1, memory_order_relaxed);
+        if (animated == true)
+        {
+            metrics.frameSeconds.observe(seconds);
+            if (seconds > DROPPED_FRAME_SECONDS)
+            {
+                metrics.droppedFrames.fetch_add(1, memory_order_relaxed);
+            }
+        }
+        metrics.screenName.store(screen, memory_order_relaxed);
+        metrics.gameState.store(state, memory_order_relaxed);
+
+        metrics.fpsFrames = metrics.fpsFrames + 1;
+        float elapsed = metrics.fpsClock.getElapsedTime().asSeconds();
+        if (elapsed >= 1)
+        {
+            metrics.framesPerSecond.store(metrics.fpsFrames / elapsed, memory_order_relaxed);
+            metrics.fpsFrames = 0;
+            metrics.fpsClock.restart();
+        }
     }
 
-    string getName() const
+    static void recordTick(double seconds)
     {
-        return playerName;
+        Metrics& metrics = instance();
+        metrics.ticks.fetch_add(1, memory_order_relaxed);
+        metrics.tickSeconds.observe(seconds);
     }
 
-    int getScore() const
+    // Headless runners count ticks in bulk without timing each one
+    static void addTicks(long long count)
     {
-        return score;
+        instance().ticks.fetch_add((unsigned long long)count, memory_order_relaxed);
     }
 
-    void setName(string name)
+    static void recordMatch()
     {
-        playerName = name;
+        instance().matches.fetch_add(1, memory_order_relaxed);
     }
 
-    void setScore(int s)
+    static void recordIo(int operation, double seconds)
     {
-        score = s;
+        instance().ioSeconds[operation].observe(seconds);
     }
 };
 
+const double Metrics::FRAME_BOUNDS[9] = { 0.004, 0.008, 0.0125, 0.0167, 0.02, 0.025, 0.0333, 0.05, 0.1 };
+const double Metrics::TICK_BOUNDS[9] = { 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016 };
+const double Metrics::IO_BOUNDS[8] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.05, 0.1, 0.5 };
 
-class HighScoreManager
+// Times a file operation for the I/O latency histogram, whichever way the scope is left
+class MetricsTimer
 {
 private:
-    string filename;
-    vector<HighScoreEntry> highScores;
-    const int MAX_HIGH_SCORES = 10;
+    int operation;
+    Clock clock;
 
-    // Function to compare two high score entries
-    static bool compareEntries(const HighScoreEntry& a, const HighScoreEntry& b)
+public:
+    MetricsTimer(int ioOperation)
     {
-        if (a.getScore() > b.getScore())
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        operation = ioOperation;
     }
 
-public:
-    HighScoreManager()
+    ~MetricsTimer()
     {
-        filename = "highscores.txt";
-        loadHighScores();
+        Metrics::recordIo(operation, clock.getElapsedTime().asMicroseconds() / 1e6);
     }
+};
 
-    // Load high scores from file
-    void loadHighScores()
+
+// Headless state of one classic match. Everything the physics needs is in
+// here, so a match can be stepped, copied, hashed or replayed on its own.
+struct MatchState
+{
+    float ballX;
+    float ballY;
+    float ballVelocityX;
+    float ballVelocityY;
+    float paddle1Y;
+    float paddle2Y;
+    int score1;
+    int score2;
+    int tick;
+    unsigned int randomState;
+};
+
+// Per-tick input bits for both players
+enum MatchInput
+{
+    INPUT_P1_UP = 1,
+    INPUT_P1_DOWN = 2,
+    INPUT_P2_UP = 4,
+    INPUT_P2_DOWN = 8
+};
+
+// What happened during a tick, so the caller can play sounds and effects
+enum MatchEvent
+{
+    EVENT_PADDLE1_HIT = 1,
+    EVENT_PADDLE2_HIT = 2,
+    EVENT_WALL_BOUNCE = 4,
+    EVENT_GOAL_P1 = 8,
+    EVENT_GOAL_P2 = 16
+};
+
+
+// Rule sets. Every tuning value is a constexpr member, so a kernel
+// instantiated on one of these has all of them folded in at compile time.
+struct ClassicRules
+{
+    static constexpr const char* NAME = "classic";
+    static constexpr float COURT_WIDTH = 1000;
+    static constexpr float COURT_HEIGHT = 700;
+    static constexpr float PADDLE_WIDTH = 20;
+    static constexpr float PADDLE_HEIGHT = 120;
+    static constexpr float PADDLE_MARGIN = 50;
+    static constexpr float BALL_SIZE = 30;
+    static constexpr float BALL_SPEED = 6;
+    static constexpr float PADDLE_SPEED = 8;
+    static constexpr float SPEED_UP = 1.05f;
+    // Below (PADDLE_WIDTH + BALL_SIZE) / 2, so a ball that crosses a paddle's face
+    // in one tick is still in front of the paddle's center and gets hit
+    static constexpr float MAX_BALL_SPEED = 18;
+    static constexpr float AI_DEAD_ZONE = 20;
+    // Largest distance from the ball's center the computer aims at; a new aim
+    // is picked at every paddle hit, so with capped ball speed it still misses
+    static constexpr float AI_AIM_ERROR = 100;
+    static constexpr int MAX_SCORE = 10;
+};
+
+struct TurboRules : ClassicRules
+{
+    static constexpr const char* NAME = "turbo";
+    static constexpr float BALL_SPEED = 9;
+    static constexpr float PADDLE_SPEED = 12;
+    static constexpr float SPEED_UP = 1.08f;
+    static constexpr float MAX_BALL_SPEED = 24;
+};
+
+struct LargeCourtRules : ClassicRules
+{
+    static constexpr const char* NAME = "large court";
+    static constexpr float COURT_WIDTH = 1600;
+    static constexpr float COURT_HEIGHT = 1000;
+    static constexpr float PADDLE_HEIGHT = 160;
+    static constexpr float AI_AIM_ERROR = 125;
+    static constexpr float BALL_SPEED = 8;
+    static constexpr float PADDLE_SPEED = 10;
+    static constexpr float MAX_BALL_SPEED = 24;
+};
+
+// The same values held at run time, for comparison and for tools that vary them
+struct DynamicRules
+{
+    const char* NAME;
+    float COURT_WIDTH;
+    float COURT_HEIGHT;
+    float PADDLE_WIDTH;
+    float PADDLE_HEIGHT;
+    float PADDLE_MARGIN;
+    float BALL_SIZE;
+    float BALL_SPEED;
+    float PADDLE_SPEED;
+    float SPEED_UP;
+    float MAX_BALL_SPEED;
+    float AI_DEAD_ZONE;
+    float AI_AIM_ERROR;
+    int MAX_SCORE;
+
+    template <class Rules>
+    static DynamicRules from()
     {
-        ifstream file(filename.c_str());
+        DynamicRules rules;
+        rules.NAME = Rules::NAME;
+        rules.COURT_WIDTH = Rules::COURT_WIDTH;
+        rules.COURT_HEIGHT = Rules::COURT_HEIGHT;
+        rules.PADDLE_WIDTH = Rules::PADDLE_WIDTH;
+        rules.PADDLE_HEIGHT = Rules::PADDLE_HEIGHT;
+        rules.PADDLE_MARGIN = Rules::PADDLE_MARGIN;
+        rules.BALL_SIZE = Rules::BALL_SIZE;
+        rules.BALL_SPEED = Rules::BALL_SPEED;
+        rules.PADDLE_SPEED = Rules::PADDLE_SPEED;
+        rules.SPEED_UP = Rules::SPEED_UP;
+        rules.MAX_BALL_SPEED = Rules::MAX_BALL_SPEED;
+        rules.AI_DEAD_ZONE = Rules::AI_DEAD_ZONE;
+        rules.AI_AIM_ERROR = Rules::AI_AIM_ERROR;
+        rules.MAX_SCORE = Rules::MAX_SCORE;
+        return rules;
+    }
+};
 
-        if (file.is_open() == false)
-        {
-            cout << "No existing high score file found. Creating new one." << endl;
-            return;
-        }
 
-        highScores.clear();
-        string name;
-        int score;
+// Physics, collision and AI for one match, specialised on a rule set.
+// The order of a tick follows the original Ball/Paddle code: the ball moves,
+// then the paddles (the computer reacting to the moved ball), then collisions
+// and goals. Serves draw from the match's own random state, and paddle
+// bounces are capped and one-sided so the ball cannot tunnel or stick.
+template <class Rules>
+class MatchSimulation
+{
+private:
+    static unsigned int nextRandom(MatchState& state)
+    {
+        state.randomState ^= state.randomState << 13;
+        state.randomState ^= state.randomState >> 17;
+        state.randomState ^= state.randomState << 5;
+        return state.randomState;
+    }
 
-        while (file >> name >> score)
+    static void movePaddle(float& paddleY, bool up, bool down, const Rules& rules)
+    {
+        if (up == true && paddleY > 0)
         {
-            if (highScores.size() < MAX_HIGH_SCORES)
+            paddleY = paddleY - rules.PADDLE_SPEED;
+            if (paddleY < 0)
             {
-                HighScoreEntry entry(name, score);
-                highScores.push_back(entry);
+                paddleY = 0;
             }
-            else
+        }
+
+        if (down == true && paddleY + rules.PADDLE_HEIGHT < rules.COURT_HEIGHT)
+        {
+            paddleY = paddleY + rules.PADDLE_SPEED;
+            if (paddleY + rules.PADDLE_HEIGHT > rules.COURT_HEIGHT)
             {
-                break;
+                paddleY = rules.COURT_HEIGHT - rules.PADDLE_HEIGHT;
             }
         }
-
-        file.close();
-        sortHighScores();
     }
 
-    // Save high scores to file
-    void saveHighScores()
+public:
+    static float getPaddleX(int player, const Rules& rules = Rules())
     {
-        ofstream file(filename.c_str());
-
-        if (file.is_open() == false)
+        if (player == 1)
         {
-            cout << "Error: Could not save high scores!" << endl;
-            return;
+            return rules.PADDLE_MARGIN;
         }
-
-        for (size_t i = 0; i < highScores.size(); i++)
+        else
         {
-            file << highScores[i].getName() << " " << highScores[i].getScore() << endl;
+            return rules.COURT_WIDTH - rules.PADDLE_MARGIN - rules.PADDLE_WIDTH;
         }
-
-        file.close();
     }
 
-    // Check if score qualifies for high score
-    bool isHighScore(int score)
+    // Put the ball back in the middle heading in a random direction
+    static void serve(MatchState& state, const Rules& rules = Rules())
     {
-        if (highScores.size() < MAX_HIGH_SCORES)
+        state.ballX = rules.COURT_WIDTH / 2 - rules.BALL_SIZE / 2;
+        state.ballY = rules.COURT_HEIGHT / 2 - rules.BALL_SIZE / 2;
+
+        float directionX;
+        if (nextRandom(state) % 2 == 0)
         {
-            return true;
+            directionX = 1;
+        }
+        else
+        {
+            directionX = -1;
         }
 
-        if (score > highScores.back().getScore())
+        float directionY;
+        if (nextRandom(state) % 2 == 0)
         {
-            return true;
+            directionY = 1;
         }
         else
         {
-            return false;
+            directionY = -1;
         }
+
+        int randomY = nextRandom(state) % 3 + 1;
+        state.ballVelocityX = rules.BALL_SPEED * directionX;
+        state.ballVelocityY = rules.BALL_SPEED * randomY * 0.5f * directionY;
+
+        state.paddle1Y = rules.COURT_HEIGHT / 2 - rules.PADDLE_HEIGHT / 2;
+        state.paddle2Y = rules.COURT_HEIGHT / 2 - rules.PADDLE_HEIGHT / 2;
     }
 
-    // Add a new high score
-    void addHighScore(const string& name, int score)
+    // Start a fresh match from a seed
+    static void reset(MatchState& state, unsigned int seed, const Rules& rules = Rules())
     {
-        HighScoreEntry newEntry(name, score);
-        highScores.push_back(newEntry);
-        sortHighScores();
+        state.score1 = 0;
+        state.score2 = 0;
+        state.tick = 0;
+        state.randomState = seed | 1;
+        serve(state, rules);
+    }
 
-        // Keep only top scores
-        if (highScores.size() > MAX_HIGH_SCORES)
+    static bool overlapsPaddle(const MatchState& state, float paddleX, float paddleY, const Rules& rules = Rules())
+    {
+        return state.ballX < paddleX + rules.PADDLE_WIDTH && state.ballX + rules.BALL_SIZE > paddleX &&
+               state.ballY < paddleY + rules.PADDLE_HEIGHT && state.ballY + rules.BALL_SIZE > paddleY;
+    }
+
+    // Reverse and speed up the ball up to MAX_BALL_SPEED; the vertical speed depends on where it hit
+    static void bounceFromPaddle(MatchState& state, float paddleY, const Rules& rules = Rules())
+    {
+        state.ballVelocityX = -state.ballVelocityX * rules.SPEED_UP;
+        if (state.ballVelocityX > rules.MAX_BALL_SPEED)
         {
-            highScores.resize(MAX_HIGH_SCORES);
+            state.ballVelocityX = rules.MAX_BALL_SPEED;
+        }
+        if (state.ballVelocityX < -rules.MAX_BALL_SPEED)
+        {
+            state.ballVelocityX = -rules.MAX_BALL_SPEED;
         }
 
-        saveHighScores();
+        float ballCenterY = state.ballY + rules.BALL_SIZE / 2;
+        float paddleCenterY = paddleY + rules.PADDLE_HEIGHT / 2;
+        float normalizedHit = (ballCenterY - paddleCenterY) / (rules.PADDLE_HEIGHT / 2);
+        state.ballVelocityY = normalizedHit * rules.BALL_SPEED;
+
+        if (state.ballVelocityY > rules.BALL_SPEED)
+        {
+            state.ballVelocityY = rules.BALL_SPEED;
+        }
+
+        if (state.ballVelocityY < -rules.BALL_SPEED)
+        {
+            state.ballVelocityY = -rules.BALL_SPEED;
+        }
     }
 
-    // Sort high scores in descending order
-    void sortHighScores()
+    // Where the ball is after this tick's move and wall bounce, which is what the
+    // original computer player saw, since the ball moved before the paddles
+    static float nextBallY(const MatchState& state, const Rules& rules = Rules())
     {
+        float ballY = state.ballY + state.ballVelocityY;
+        if (ballY <= 0)
+        {
+            ballY = 0;
+        }
+        if (ballY + rules.BALL_SIZE >= rules.COURT_HEIGHT)
+        {
+            ballY = rules.COURT_HEIGHT - rules.BALL_SIZE;
+        }
+        return ballY;
+    }
+
+    // Follow an aim point near the ball outside a small dead zone. The aim offset,
+    // up to aimError, comes from the random state, so it changes at every hit.
+    static unsigned int trackBall(const MatchState& state, int player, float aimError, const Rules& rules)
+    {
+        float paddleY;
+        unsigned int aimBits;
+        if (player == 1)
+        {
+            paddleY = state.paddle1Y;
+            aimBits = state.randomState >> 16;
+        }
+        else
+        {
+            paddleY = state.paddle2Y;
+            aimBits = state.randomState & 0xFFFF;
+        }
+        float aimOffset = (aimBits / 65535.0f * 2 - 1) * aimError;
+        float ballCenterY = nextBallY(state, rules) + rules.BALL_SIZE / 2 + aimOffset;
+        float paddleCenterY = paddleY + rules.PADDLE_HEIGHT / 2;
+
+        unsigned int up;
+        unsigned int down;
+        if (player == 1)
+        {
+            up = INPUT_P1_UP;
+            down = INPUT_P1_DOWN;
+        }
+        else
+        {
+            up = INPUT_P2_UP;
+            down = INPUT_P2_DOWN;
+        }
+
+        if (ballCenterY < paddleCenterY - rules.AI_DEAD_ZONE)
+        {
+            return up;
+        }
+        else if (ballCenterY > paddleCenterY + rules.AI_DEAD_ZONE)
+        {
+            return down;
+        }
+
+        return 0;
+    }
+
+    // The headless computer player. Its aim error makes capped computer-vs-computer matches finish.
+    static unsigned int aiInput(const MatchState& state, int player, const Rules& rules = Rules())
+    {
+        return trackBall(state, player, rules.AI_AIM_ERROR, rules);
+    }
+
+    // The single-player opponent tracks the ball exactly, like the original game
+    static unsigned int opponentInput(const MatchState& state, int player, const Rules& rules = Rules())
+    {
+        return trackBall(state, player, 0, rules);
+    }
+
+    // Advance one tick: ball, paddles, collisions, then goals. Returns MatchEvent bits.
+    static unsigned int step(MatchState& state, unsigned int inputs, const Rules& rules = Rules())
+    {
+        unsigned int events = 0;
+        state.tick = state.tick + 1;
+
+        // Ball movement and wall bounces
+        state.ballX = state.ballX + state.ballVelocityX;
+        state.ballY = state.ballY + state.ballVelocityY;
+
+        if (state.ballY <= 0)
+        {
+            state.ballVelocityY = -state.ballVelocityY;
+            state.ballY = 0;
+            events = events | EVENT_WALL_BOUNCE;
+        }
+
+        if (state.ballY + rules.BALL_SIZE >= rules.COURT_HEIGHT)
+        {
+            state.ballVelocityY = -state.ballVelocityY;
+            state.ballY = rules.COURT_HEIGHT - rules.BALL_SIZE;
+            events = events | EVENT_WALL_BOUNCE;
+        }
+
+        // Paddles
+        movePaddle(state.paddle1Y, (inputs & INPUT_P1_UP) != 0, (inputs & INPUT_P1_DOWN) != 0, rules);
+        movePaddle(state.paddle2Y, (inputs & INPUT_P2_UP) != 0, (inputs & INPUT_P2_DOWN) != 0, rules);
+
+        // Paddle collisions. Only a ball in front of a paddle and moving towards it
+        // bounces, and it is put back on the paddle's face, so it cannot stick inside.
+        float paddle1X = getPaddleX(1, rules);
+        float paddle2X = getPaddleX(2, rules);
+        float ballCenterX = state.ballX + rules.BALL_SIZE / 2;
+
+        if (state.ballVelocityX < 0 && ballCenterX > paddle1X + rules.PADDLE_WIDTH / 2 &&
+            overlapsPaddle(state, paddle1X, state.paddle1Y, rules))
+        {
+            bounceFromPaddle(state, state.paddle1Y, rules);
+            state.ballX = paddle1X + rules.PADDLE_WIDTH;
+            nextRandom(state);
+            events = events | EVENT_PADDLE1_HIT;
+        }
+
+        if (state.ballVelocityX > 0 && ballCenterX < paddle2X + rules.PADDLE_WIDTH / 2 &&
+            overlapsPaddle(state, paddle2X, state.paddle2Y, rules))
+        {
+            bounceFromPaddle(state, state.paddle2Y, rules);
+            state.ballX = paddle2X - rules.BALL_SIZE;
+            nextRandom(state);
+            events = events | EVENT_PADDLE2_HIT;
+        }
+
+        // Goals
+        if (state.ballX < 0)
+        {
+            state.score2 = state.score2 + 1;
+            events = events | EVENT_GOAL_P2;
+            serve(state, rules);
+        }
+        else if (state.ballX > rules.COURT_WIDTH)
+        {
+            state.score1 = state.score1 + 1;
+            events = events | EVENT_GOAL_P1;
+            serve(state, rules);
+        }
+
+        return events;
+    }
+
+    // 0 while the match is running, otherwise the winning player
+    static int getWinner(const MatchState& state, const Rules& rules = Rules())
+    {
+        if (state.score1 >= rules.MAX_SCORE)
+        {
+            return 1;
+        }
+        if (state.score2 >= rules.MAX_SCORE)
+        {
+            return 2;
+        }
+        return 0;
+    }
+
+    // Play whole computer-vs-computer matches; returns the number of ticks simulated
+    static long long simulateMatches(int matches, unsigned int seed, const Rules& rules = Rules())
+    {
+        long long ticks = 0;
+        MatchState state;
+
+        for (int m = 0; m < matches; m++)
+        {
+            reset(state, seed + m, rules);
+            while (getWinner(state, rules) == 0)
+            {
+                unsigned int inputs = aiInput(state, 1, rules) | aiInput(state, 2, rules);
+                step(state, inputs, rules);
+            }
+            ticks = ticks + state.tick;
+        }
+
+        return ticks;
+    }
+};
+
+
+// Q16.16 fixed-point arithmetic for the deterministic physics backend.
+// Only integer operations are used, so every compiler and optimisation
+// level produces the same bits. Right shifts of negative values are
+// arithmetic on every compiler this game targets (and guaranteed in C++20).
+typedef int32_t Fixed;
+
+class FixedPoint
+{
+public:
+    static const int SHIFT = 16;
+    static const Fixed ONE = 1 << SHIFT;
+
+    // Only for compile-time constants and for display; never used inside a tick
+    static constexpr Fixed fromFloat(float value)
+    {
+        return (Fixed)(value * ONE + (value >= 0 ? 0.5f : -0.5f));
+    }
+
+    static float toFloat(Fixed value)
+    {
+        return value / (float)ONE;
+    }
+
+    static Fixed fromInt(int value)
+    {
+        return (Fixed)(value * ONE);
+    }
+
+    static Fixed multiply(Fixed a, Fixed b)
+    {
+        return (Fixed)(((int64_t)a * b) >> SHIFT);
+    }
+
+    static Fixed divide(Fixed a, Fixed b)
+    {
+        return (Fixed)(((int64_t)a * ONE) / b);
+    }
+};
+
+// MatchState with every coordinate in fixed point
+struct FixedMatchState
+{
+    Fixed ballX;
+    Fixed ballY;
+    Fixed ballVelocityX;
+    Fixed ballVelocityY;
+    Fixed paddle1Y;
+    Fixed paddle2Y;
+    int score1;
+    int score2;
+    int tick;
+    unsigned int randomState;
+};
+
+// FNV-1a over the state's 32-bit words; compared tick by tick to detect a desync
+inline uint64_t hashMatchState(const FixedMatchState& state)
+{
+    const uint32_t words[10] =
+    {
+        (uint32_t)state.ballX, (uint32_t)state.ballY,
+        (uint32_t)state.ballVelocityX, (uint32_t)state.ballVelocityY,
+        (uint32_t)state.paddle1Y, (uint32_t)state.paddle2Y,
+        (uint32_t)state.score1, (uint32_t)state.score2,
+        (uint32_t)state.tick, state.randomState
+    };
+
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < 10; i++)
+    {
+        hash = hash ^ words[i];
+        hash = hash * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Float view of a fixed-point match, for drawing
+inline MatchState toMatchState(const FixedMatchState& fixed)
+{
+    MatchState state;
+    state.ballX = FixedPoint::toFloat(fixed.ballX);
+    state.ballY = FixedPoint::toFloat(fixed.ballY);
+    state.ballVelocityX = FixedPoint::toFloat(fixed.ballVelocityX);
+    state.ballVelocityY = FixedPoint::toFloat(fixed.ballVelocityY);
+    state.paddle1Y = FixedPoint::toFloat(fixed.paddle1Y);
+    state.paddle2Y = FixedPoint::toFloat(fixed.paddle2Y);
+    state.score1 = fixed.score1;
+    state.score2 = fixed.score2;
+    state.tick = fixed.tick;
+    state.randomState = fixed.randomState;
+    return state;
+}
+
+
+// The MatchSimulation rules in fixed point. Rule constants are converted
+// once at compile time; the tick itself is pure integer arithmetic.
+template <class Rules>
+class FixedMatchSimulation
+{
+private:
+    static constexpr Fixed COURT_WIDTH = FixedPoint::fromFloat(Rules::COURT_WIDTH);
+    static constexpr Fixed COURT_HEIGHT = FixedPoint::fromFloat(Rules::COURT_HEIGHT);
+    static constexpr Fixed PADDLE_WIDTH = FixedPoint::fromFloat(Rules::PADDLE_WIDTH);
+    static constexpr Fixed PADDLE_HEIGHT = FixedPoint::fromFloat(Rules::PADDLE_HEIGHT);
+    static constexpr Fixed PADDLE_MARGIN = FixedPoint::fromFloat(Rules::PADDLE_MARGIN);
+    static constexpr Fixed BALL_SIZE = FixedPoint::fromFloat(Rules::BALL_SIZE);
+    static constexpr Fixed BALL_SPEED = FixedPoint::fromFloat(Rules::BALL_SPEED);
+    static constexpr Fixed PADDLE_SPEED = FixedPoint::fromFloat(Rules::PADDLE_SPEED);
+    static constexpr Fixed SPEED_UP = FixedPoint::fromFloat(Rules::SPEED_UP);
+    static constexpr Fixed MAX_BALL_SPEED = FixedPoint::fromFloat(Rules::MAX_BALL_SPEED);
+    static constexpr Fixed AI_DEAD_ZONE = FixedPoint::fromFloat(Rules::AI_DEAD_ZONE);
+    static constexpr Fixed AI_AIM_ERROR = FixedPoint::fromFloat(Rules::AI_AIM_ERROR);
+
+    static unsigned int nextRandom(FixedMatchState& state)
+    {
+        state.randomState ^= state.randomState << 13;
+        state.randomState ^= state.randomState >> 17;
+        state.randomState ^= state.randomState << 5;
+        return state.randomState;
+    }
+
+    static void movePaddle(Fixed& paddleY, bool up, bool down)
+    {
+        if (up == true && paddleY > 0)
+        {
+            paddleY = paddleY - PADDLE_SPEED;
+            if (paddleY < 0)
+            {
+                paddleY = 0;
+            }
+        }
+
+        if (down == true && paddleY + PADDLE_HEIGHT < COURT_HEIGHT)
+        {
+            paddleY = paddleY + PADDLE_SPEED;
+            if (paddleY + PADDLE_HEIGHT > COURT_HEIGHT)
+            {
+                paddleY = COURT_HEIGHT - PADDLE_HEIGHT;
+            }
+        }
+    }
+
+    static bool overlapsPaddle(const FixedMatchState& state, Fixed paddleX, Fixed paddleY)
+    {
+        return state.ballX < paddleX + PADDLE_WIDTH && state.ballX + BALL_SIZE > paddleX &&
+               state.ballY < paddleY + PADDLE_HEIGHT && state.ballY + BALL_SIZE > paddleY;
+    }
+
+    static void bounceFromPaddle(FixedMatchState& state, Fixed paddleY)
+    {
+        state.ballVelocityX = -FixedPoint::multiply(state.ballVelocityX, SPEED_UP);
+        if (state.ballVelocityX > MAX_BALL_SPEED)
+        {
+            state.ballVelocityX = MAX_BALL_SPEED;
+        }
+        if (state.ballVelocityX < -MAX_BALL_SPEED)
+        {
+            state.ballVelocityX = -MAX_BALL_SPEED;
+        }
+
+        Fixed hitPosition = (state.ballY + BALL_SIZE / 2) - (paddleY + PADDLE_HEIGHT / 2);
+        Fixed normalizedHit = FixedPoint::divide(hitPosition, PADDLE_HEIGHT / 2);
+        state.ballVelocityY = FixedPoint::multiply(normalizedHit, BALL_SPEED);
+
+        if (state.ballVelocityY > BALL_SPEED)
+        {
+            state.ballVelocityY = BALL_SPEED;
+        }
+
+        if (state.ballVelocityY < -BALL_SPEED)
+        {
+            state.ballVelocityY = -BALL_SPEED;
+        }
+    }
+
+public:
+    static Fixed getPaddleX(int player)
+    {
+        if (player == 1)
+        {
+            return PADDLE_MARGIN;
+        }
+        else
+        {
+            return COURT_WIDTH - PADDLE_MARGIN - PADDLE_WIDTH;
+        }
+    }
+
+    static void serve(FixedMatchState& state)
+    {
+        state.ballX = COURT_WIDTH / 2 - BALL_SIZE / 2;
+        state.ballY = COURT_HEIGHT / 2 - BALL_SIZE / 2;
+
+        Fixed directionX;
+        if (nextRandom(state) % 2 == 0)
+        {
+            directionX = 1;
+        }
+        else
+        {
+            directionX = -1;
+        }
+
+        Fixed directionY;
+        if (nextRandom(state) % 2 == 0)
+        {
+            directionY = 1;
+        }
+        else
+        {
+            directionY = -1;
+        }
+
+        int randomY = nextRandom(state) % 3 + 1;
+        state.ballVelocityX = BALL_SPEED * directionX;
+        state.ballVelocityY = BALL_SPEED * randomY / 2 * directionY;
+
+        state.paddle1Y = COURT_HEIGHT / 2 - PADDLE_HEIGHT / 2;
+        state.paddle2Y = COURT_HEIGHT / 2 - PADDLE_HEIGHT / 2;
+    }
+
+    static void reset(FixedMatchState& state, unsigned int seed)
+    {
+        state.score1 = 0;
+        state.score2 = 0;
+        state.tick = 0;
+        state.randomState = seed | 1;
+        serve(state);
+    }
+
+    static Fixed nextBallY(const FixedMatchState& state)
+    {
+        Fixed ballY = state.ballY + state.ballVelocityY;
+        if (ballY <= 0)
+        {
+            ballY = 0;
+        }
+        if (ballY + BALL_SIZE >= COURT_HEIGHT)
+        {
+            ballY = COURT_HEIGHT - BALL_SIZE;
+        }
+        return ballY;
+    }
+
+    static unsigned int trackBall(const FixedMatchState& state, int player, Fixed aimError)
+    {
+        Fixed paddleY;
+        unsigned int up;
+        unsigned int down;
+        int aimBits;
+        if (player == 1)
+        {
+            paddleY = state.paddle1Y;
+            up = INPUT_P1_UP;
+            down = INPUT_P1_DOWN;
+            aimBits = (int)(state.randomState >> 16);
+        }
+        else
+        {
+            paddleY = state.paddle2Y;
+            up = INPUT_P2_UP;
+            down = INPUT_P2_DOWN;
+            aimBits = (int)(state.randomState & 0xFFFF);
+        }
+
+        Fixed aimOffset = (Fixed)((int64_t)(aimBits * 2 - 65535) * aimError / 65535);
+        Fixed ballCenterY = nextBallY(state) + BALL_SIZE / 2 + aimOffset;
+        Fixed paddleCenterY = paddleY + PADDLE_HEIGHT / 2;
+
+        if (ballCenterY < paddleCenterY - AI_DEAD_ZONE)
+        {
+            return up;
+        }
+        else if (ballCenterY > paddleCenterY + AI_DEAD_ZONE)
+        {
+            return down;
+        }
+
+        return 0;
+    }
+
+    static unsigned int aiInput(const FixedMatchState& state, int player)
+    {
+        return trackBall(state, player, AI_AIM_ERROR);
+    }
+
+    static unsigned int opponentInput(const FixedMatchState& state, int player)
+    {
+        return trackBall(state, player, 0);
+    }
+
+    // Same order of operations as MatchSimulation::step; returns MatchEvent bits
+    static unsigned int step(FixedMatchState& state, unsigned int inputs)
+    {
+        unsigned int events = 0;
+        state.tick = state.tick + 1;
+
+        state.ballX = state.ballX + state.ballVelocityX;
+        state.ballY = state.ballY + state.ballVelocityY;
+
+        if (state.ballY <= 0)
+        {
+            state.ballVelocityY = -state.ballVelocityY;
+            state.ballY = 0;
+            events = events | EVENT_WALL_BOUNCE;
+        }
+
+        if (state.ballY + BALL_SIZE >= COURT_HEIGHT)
+        {
+            state.ballVelocityY = -state.ballVelocityY;
+            state.ballY = COURT_HEIGHT - BALL_SIZE;
+            events = events | EVENT_WALL_BOUNCE;
+        }
+
+        movePaddle(state.paddle1Y, (inputs & INPUT_P1_UP) != 0, (inputs & INPUT_P1_DOWN) != 0);
+        movePaddle(state.paddle2Y, (inputs & INPUT_P2_UP) != 0, (inputs & INPUT_P2_DOWN) != 0);
+
+        Fixed paddle1X = getPaddleX(1);
+        Fixed paddle2X = getPaddleX(2);
+        Fixed ballCenterX = state.ballX + BALL_SIZE / 2;
+
+        if (state.ballVelocityX < 0 && ballCenterX > paddle1X + PADDLE_WIDTH / 2 &&
+            overlapsPaddle(state, paddle1X, state.paddle1Y))
+        {
+            bounceFromPaddle(state, state.paddle1Y);
+            state.ballX = paddle1X + PADDLE_WIDTH;
+            nextRandom(state);
+            events = events | EVENT_PADDLE1_HIT;
+        }
+
+        if (state.ballVelocityX > 0 && ballCenterX < paddle2X + PADDLE_WIDTH / 2 &&
+            overlapsPaddle(state, paddle2X, state.paddle2Y))
+        {
+            bounceFromPaddle(state, state.paddle2Y);
+            state.ballX = paddle2X - BALL_SIZE;
+            nextRandom(state);
+            events = events | EVENT_PADDLE2_HIT;
+        }
+
+        if (state.ballX < 0)
+        {
+            state.score2 = state.score2 + 1;
+            events = events | EVENT_GOAL_P2;
+            serve(state);
+        }
+        else if (state.ballX > COURT_WIDTH)
+        {
+            state.score1 = state.score1 + 1;
+            events = events | EVENT_GOAL_P1;
+            serve(state);
+        }
+
+        return events;
+    }
+
+    static int getWinner(const FixedMatchState& state)
+    {
+        if (state.score1 >= Rules::MAX_SCORE)
+        {
+            return 1;
+        }
+        if (state.score2 >= Rules::MAX_SCORE)
+        {
+            return 2;
+        }
+        return 0;
+    }
+
+    // Play computer-vs-computer matches; returns ticks simulated. When hashOut
+    // is given, every tick's state hash is folded into it.
+    static long long simulateMatches(int matches, unsigned int seed, uint64_t* hashOut)
+    {
+        long long ticks = 0;
+        uint64_t combined = 0;
+        FixedMatchState state;
+
+        for (int m = 0; m < matches; m++)
+        {
+            reset(state, seed + m);
+            while (getWinner(state) == 0)
+            {
+                unsigned int inputs = aiInput(state, 1) | aiInput(state, 2);
+                step(state, inputs);
+                if (hashOut != nullptr)
+                {
+                    combined = (combined * 31) ^ hashMatchState(state);
+                }
+            }
+            ticks = ticks + state.tick;
+        }
+
+        if (hashOut != nullptr)
+        {
+            *hashOut = combined;
+        }
+        return ticks;
+    }
+};
+
+
+// One entry per compiled rule set, so the game can pick a kernel at run time
+struct RuleSet
+{
+    const char* name;
+    float courtWidth;
+    float courtHeight;
+    float paddleWidth;
+    float paddleHeight;
+    float ballSize;
+    int maxScore;
+    DynamicRules values;
+    void (*reset)(MatchState& state, unsigned int seed);
+    unsigned int (*step)(MatchState& state, unsigned int inputs);
+    unsigned int (*aiInput)(const MatchState& state, int player);
+    unsigned int (*opponentInput)(const MatchState& state, int player);
+    int (*getWinner)(const MatchState& state);
+    long long (*simulateMatches)(int matches, unsigned int seed);
+
+    // Deterministic fixed-point backend of the same rules
+    void (*resetFixed)(FixedMatchState& state, unsigned int seed);
+    unsigned int (*stepFixed)(FixedMatchState& state, unsigned int inputs);
+    unsigned int (*aiInputFixed)(const FixedMatchState& state, int player);
+    unsigned int (*opponentInputFixed)(const FixedMatchState& state, int player);
+    long long (*simulateMatchesFixed)(int matches, unsigned int seed, uint64_t* hash);
+};
+
+class RuleSetRegistry
+{
+private:
+    template <class Rules>
+    static RuleSet make()
+    {
+        RuleSet ruleSet;
+        ruleSet.name = Rules::NAME;
+        ruleSet.courtWidth = Rules::COURT_WIDTH;
+        ruleSet.courtHeight = Rules::COURT_HEIGHT;
+        ruleSet.paddleWidth = Rules::PADDLE_WIDTH;
+        ruleSet.paddleHeight = Rules::PADDLE_HEIGHT;
+        ruleSet.ballSize = Rules::BALL_SIZE;
+        ruleSet.maxScore = Rules::MAX_SCORE;
+        ruleSet.values = DynamicRules::from<Rules>();
+        ruleSet.reset = [](MatchState& state, unsigned int seed) { MatchSimulation<Rules>::reset(state, seed); };
+        ruleSet.step = [](MatchState& state, unsigned int inputs) { return MatchSimulation<Rules>::step(state, inputs); };
+        ruleSet.aiInput = [](const MatchState& state, int player) { return MatchSimulation<Rules>::aiInput(state, player); };
+        ruleSet.opponentInput = [](const MatchState& state, int player) { return MatchSimulation<Rules>::opponentInput(state, player); };
+        ruleSet.getWinner = [](const MatchState& state) { return MatchSimulation<Rules>::getWinner(state); };
+        ruleSet.simulateMatches = [](int matches, unsigned int seed) { return MatchSimulation<Rules>::simulateMatches(matches, seed); };
+        ruleSet.resetFixed = [](FixedMatchState& state, unsigned int seed) { FixedMatchSimulation<Rules>::reset(state, seed); };
+        ruleSet.stepFixed = [](FixedMatchState& state, unsigned int inputs) { return FixedMatchSimulation<Rules>::step(state, inputs); };
+        ruleSet.aiInputFixed = [](const FixedMatchState& state, int player) { return FixedMatchSimulation<Rules>::aiInput(state, player); };
+        ruleSet.opponentInputFixed = [](const FixedMatchState& state, int player) { return FixedMatchSimulation<Rules>::opponentInput(state, player); };
+        ruleSet.simulateMatchesFixed = [](int matches, unsigned int seed, uint64_t* hash) { return FixedMatchSimulation<Rules>::simulateMatches(matches, seed, hash); };
+        return ruleSet;
+    }
+
+public:
+    static const vector<RuleSet>& all()
+    {
+        static const vector<RuleSet> ruleSets = { make<ClassicRules>(), make<TurboRules>(), make<LargeCourtRules>() };
+        return ruleSets;
+    }
+
+    // Look a rule set up by name; returns nullptr if there is none
+    static const RuleSet* find(const string& name)
+    {
+        for (size_t i = 0; i < all().size(); i++)
+        {
+            if (name == all()[i].name)
+            {
+                return &all()[i];
+            }
+        }
+        return nullptr;
+    }
+};
+
+
+// What happened in a match, one row per event
+enum TelemetryEventType
+{
+    TELEMETRY_RALLY_START = 1,
+    TELEMETRY_RALLY_END = 2,
+    TELEMETRY_PADDLE_HIT = 3,
+    TELEMETRY_WALL_BOUNCE = 4,
+    TELEMETRY_GOAL = 5
+};
+
+// A learned computer player: a small multilayer perceptron read from a binary
+// weights file. Hidden layers use ReLU; the three outputs score up, stay and
+// down, and the highest wins. States are evaluated four at a time with one
+// SSE lane per state, so a batch of matches costs little more per decision
+// than the weights it streams through. File layout, little-endian:
+//   "PMLP", u32 version, u32 input count (8), u32 layer count,
+//   u32 output size of each layer (the last is 3),
+//   then per layer f32 weights [output][input] followed by f32 biases [output]
+class PaddlePolicy
+{
+public:
+    static const unsigned int VERSION = 1;
+    static const int INPUTS = 8;
+    static const int OUTPUTS = 3;
+    static const int MAX_LAYERS = 4;
+    static const int MAX_WIDTH = 64;
+    static const int LANES = 4;
+
+private:
+    int layerCount;
+    int sizes[MAX_LAYERS + 1];
+    // Weights are kept transposed, [input][output], so a layer adds one input into every output at a time
+    vector<float> weights;
+    vector<float> biases;
+    int weightOffsets[MAX_LAYERS];
+    int biasOffsets[MAX_LAYERS];
+
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static float readF32(const unsigned char* p)
+    {
+        uint32_t bits = readU32(p);
+        float value;
+        memcpy(&value, &bits, 4);
+        return value;
+    }
+
+    static void writeU32(ofstream& file, uint32_t value)
+    {
+        char bytes[4];
+        bytes[0] = (char)(value & 0xFF);
+        bytes[1] = (char)((value >> 8) & 0xFF);
+        bytes[2] = (char)((value >> 16) & 0xFF);
+        bytes[3] = (char)((value >> 24) & 0xFF);
+        file.write(bytes, 4);
+    }
+
+    static void writeF32(ofstream& file, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        writeU32(file, bits);
+    }
+
+    // Network inputs from one player's side of the court, so either paddle can use the same weights
+    static void writeFeatures(const MatchState& state, int player, const DynamicRules& rules, float* lanes, int lane)
+    {
+        float ballCenterY = state.ballY + rules.BALL_SIZE / 2;
+        float ownPaddleY = player == 1 ? state.paddle1Y : state.paddle2Y;
+        float otherPaddleY = player == 1 ? state.paddle2Y : state.paddle1Y;
+        float distance = player == 1 ? state.ballX : rules.COURT_WIDTH - state.ballX - rules.BALL_SIZE;
+        float approach = player == 1 ? -state.ballVelocityX : state.ballVelocityX;
+
+        lanes[0 * LANES + lane] = distance / rules.COURT_WIDTH;
+        lanes[1 * LANES + lane] = ballCenterY / rules.COURT_HEIGHT;
+        lanes[2 * LANES + lane] = approach / rules.MAX_BALL_SPEED;
+        lanes[3 * LANES + lane] = state.ballVelocityY / rules.MAX_BALL_SPEED;
+        lanes[4 * LANES + lane] = (ownPaddleY + rules.PADDLE_HEIGHT / 2) / rules.COURT_HEIGHT;
+        lanes[5 * LANES + lane] = (otherPaddleY + rules.PADDLE_HEIGHT / 2) / rules.COURT_HEIGHT;
+        lanes[6 * LANES + lane] = rules.PADDLE_HEIGHT / rules.COURT_HEIGHT;
+        lanes[7 * LANES + lane] = rules.BALL_SIZE / rules.COURT_HEIGHT;
+    }
+
+    // Run four states through the network; inputs and activations are [neuron][lane]
+    void evaluateLanes(const float* inputs, unsigned int* actions, int player) const
+    {
+        alignas(16) float bufferA[MAX_WIDTH * LANES];
+        alignas(16) float bufferB[MAX_WIDTH * LANES];
+        const float* in = inputs;
+        float* out = bufferA;
+        int inCount = INPUTS;
+
+        for (int layer = 0; layer < layerCount; layer++)
+        {
+            int outCount = sizes[layer + 1];
+            const float* w = &weights[weightOffsets[layer]];
+            const float* b = &biases[biasOffsets[layer]];
+            bool hidden = layer < layerCount - 1;
+
+#ifdef PINGPONG_SSE
+            // Four outputs at a time stay in registers as independent sums
+            __m128 zero = _mm_setzero_ps();
+            int j = 0;
+            for (; j + 4 <= outCount; j = j + 4)
+            {
+                __m128 sum0 = _mm_set1_ps(b[j]);
+                __m128 sum1 = _mm_set1_ps(b[j + 1]);
+                __m128 sum2 = _mm_set1_ps(b[j + 2]);
+                __m128 sum3 = _mm_set1_ps(b[j + 3]);
+                for (int i = 0; i < inCount; i++)
+                {
+                    __m128 x = _mm_load_ps(in + i * LANES);
+                    const float* row = w + i * outCount + j;
+                    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_set1_ps(row[0]), x));
+                    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_set1_ps(row[1]), x));
+                    sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_set1_ps(row[2]), x));
+                    sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_set1_ps(row[3]), x));
+                }
+                if (hidden == true)
+                {
+                    sum0 = _mm_max_ps(sum0, zero);
+                    sum1 = _mm_max_ps(sum1, zero);
+                    sum2 = _mm_max_ps(sum2, zero);
+                    sum3 = _mm_max_ps(sum3, zero);
+                }
+                _mm_store_ps(out + j * LANES, sum0);
+                _mm_store_ps(out + (j + 1) * LANES, sum1);
+                _mm_store_ps(out + (j + 2) * LANES, sum2);
+                _mm_store_ps(out + (j + 3) * LANES, sum3);
+            }
+            for (; j < outCount; j++)
+            {
+                __m128 sum = _mm_set1_ps(b[j]);
+                for (int i = 0; i < inCount; i++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[i * outCount + j]), _mm_load_ps(in + i * LANES)));
+                }
+                if (hidden == true)
+                {
+                    sum = _mm_max_ps(sum, zero);
+                }
+                _mm_store_ps(out + j * LANES, sum);
+            }
+#else
+            for (int j = 0; j < outCount; j++)
+            {
+                for (int lane = 0; lane < LANES; lane++)
+                {
+                    out[j * LANES + lane] = b[j];
+                }
+            }
+            for (int i = 0; i < inCount; i++)
+            {
+                const float* row = w + i * outCount;
+                for (int j = 0; j < outCount; j++)
+                {
+                    for (int lane = 0; lane < LANES; lane++)
+                    {
+                        out[j * LANES + lane] = out[j * LANES + lane] + row[j] * in[i * LANES + lane];
+                    }
+                }
+            }
+            if (hidden == true)
+            {
+                for (int j = 0; j < outCount * LANES; j++)
+                {
+                    out[j] = max(out[j], 0.0f);
+                }
+            }
+#endif
+
+            in = out;
+            out = out == bufferA ? bufferB : bufferA;
+            inCount = outCount;
+        }
+
+        unsigned int up = player == 1 ? INPUT_P1_UP : INPUT_P2_UP;
+        unsigned int down = player == 1 ? INPUT_P1_DOWN : INPUT_P2_DOWN;
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            // Ties keep the paddle still
+            float upScore = in[0 * LANES + lane];
+            float stayScore = in[1 * LANES + lane];
+            float downScore = in[2 * LANES + lane];
+            actions[lane] = 0;
+            if (upScore > stayScore && upScore >= downScore)
+            {
+                actions[lane] = up;
+            }
+            else if (downScore > stayScore && downScore > upScore)
+            {
+                actions[lane] = down;
+            }
+        }
+    }
+
+public:
+    PaddlePolicy()
+    {
+        layerCount = 0;
+        sizes[0] = INPUTS;
+    }
+
+    bool isLoaded() const
+    {
+        return layerCount > 0;
+    }
+
+    int getLayerCount() const
+    {
+        return layerCount;
+    }
+
+    // Outputs of a layer; layer 0 is the input
+    int getSize(int layer) const
+    {
+        return sizes[layer];
+    }
+
+    // Set up an empty network of the given layer sizes, all weights zero
+    bool create(int layers, const int* layerSizes)
+    {
+        layerCount = 0;
+        if (layers < 1 || layers > MAX_LAYERS || layerSizes[layers - 1] != OUTPUTS)
+        {
+            return false;
+        }
+
+        int weightCount = 0;
+        int biasCount = 0;
+        for (int layer = 0; layer < layers; layer++)
+        {
+            if (layerSizes[layer] < 1 || layerSizes[layer] > MAX_WIDTH)
+            {
+                return false;
+            }
+            sizes[layer + 1] = layerSizes[layer];
+            weightOffsets[layer] = weightCount;
+            biasOffsets[layer] = biasCount;
+            weightCount = weightCount + sizes[layer] * sizes[layer + 1];
+            biasCount = biasCount + sizes[layer + 1];
+        }
+
+        weights.assign(weightCount, 0.0f);
+        biases.assign(biasCount, 0.0f);
+        layerCount = layers;
+        return true;
+    }
+
+    void setWeight(int layer, int output, int input, float value)
+    {
+        weights[weightOffsets[layer] + input * sizes[layer + 1] + output] = value;
+    }
+
+    float getWeight(int layer, int output, int input) const
+    {
+        return weights[weightOffsets[layer] + input * sizes[layer + 1] + output];
+    }
+
+    void setBias(int layer, int output, float value)
+    {
+        biases[biasOffsets[layer] + output] = value;
+    }
+
+    float getBias(int layer, int output) const
+    {
+        return biases[biasOffsets[layer] + output];
+    }
+
+    bool load(const string& path)
+    {
+        layerCount = 0;
+        ifstream file(path, ios::binary);
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+        file.seekg(0, ios::end);
+        size_t size = (size_t)file.tellg();
+        file.seekg(0, ios::beg);
+        vector<unsigned char> data(size);
+        file.read((char*)data.data(), size);
+
+        if (size < 16 || memcmp(data.data(), "PMLP", 4) != 0 || readU32(&data[4]) != VERSION ||
+            readU32(&data[8]) != (uint32_t)INPUTS)
+        {
+            Logger::error("Paddle policy has a bad header", LogField("path", path));
+            return false;
+        }
+
+        int layers = (int)readU32(&data[12]);
+        if (layers < 1 || layers > MAX_LAYERS || size < 16 + (size_t)layers * 4)
+        {
+            Logger::error("Paddle policy has a bad layer count", LogField("path", path), LogField("layers", layers));
+            return false;
+        }
+        int layerSizes[MAX_LAYERS];
+        for (int layer = 0; layer < layers; layer++)
+        {
+            layerSizes[layer] = (int)min(readU32(&data[16 + layer * 4]), (uint32_t)MAX_WIDTH + 1);
+        }
+        if (create(layers, layerSizes) == false)
+        {
+            Logger::error("Paddle policy layer sizes are not supported", LogField("path", path));
+            return false;
+        }
+
+        size_t offset = 16 + layers * 4;
+        if (size != offset + (weights.size() + biases.size()) * 4)
+        {
+            layerCount = 0;
+            Logger::error("Paddle policy size does not match its layers", LogField("path", path),
+                          LogField("bytes", (long long)size));
+            return false;
+        }
+
+        for (int layer = 0; layer < layers; layer++)
+        {
+            for (int j = 0; j < sizes[layer + 1]; j++)
+            {
+                for (int i = 0; i < sizes[layer]; i++)
+                {
+                    setWeight(layer, j, i, readF32(&data[offset]));
+                    offset = offset + 4;
+                }
+            }
+            for (int j = 0; j < sizes[layer + 1]; j++)
+            {
+                setBias(layer, j, readF32(&data[offset]));
+                offset = offset + 4;
+            }
+        }
+        return true;
+    }
+
+    bool save(const string& path) const
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (file.is_open() == false || isLoaded() == false)
+        {
+            return false;
+        }
+
+        file.write("PMLP", 4);
+        writeU32(file, VERSION);
+        writeU32(file, INPUTS);
+        writeU32(file, layerCount);
+        for (int layer = 0; layer < layerCount; layer++)
+        {
+            writeU32(file, sizes[layer + 1]);
+        }
+        for (int layer = 0; layer < layerCount; layer++)
+        {
+            for (int j = 0; j < sizes[layer + 1]; j++)
+            {
+                for (int i = 0; i < sizes[layer]; i++)
+                {
+                    writeF32(file, getWeight(layer, j, i));
+                }
+            }
+            for (int j = 0; j < sizes[layer + 1]; j++)
+            {
+                writeF32(file, getBias(layer, j));
+            }
+        }
+        return file.good();
+    }
+
+    // Input bits for one player of many matches; count may be anything, the last group is padded
+    void decideBatch(const MatchState* states, int count, int player, const DynamicRules& rules, unsigned int* inputs) const
+    {
+        alignas(16) float lanes[INPUTS * LANES];
+        unsigned int actions[LANES];
+
+        for (int first = 0; first < count; first = first + LANES)
+        {
+            int used = min((int)LANES, count - first);
+            for (int lane = 0; lane < LANES; lane++)
+            {
+                writeFeatures(states[first + min(lane, used - 1)], player, rules, lanes, lane);
+            }
+            evaluateLanes(lanes, actions, player);
+            for (int lane = 0; lane < used; lane++)
+            {
+                inputs[first + lane] = actions[lane];
+            }
+        }
+    }
+
+    unsigned int decide(const MatchState& state, int player, const DynamicRules& rules) const
+    {
+        unsigned int input;
+        decideBatch(&state, 1, player, rules, &input);
+        return input;
+    }
+};
+
+
+// What a headless runner keeps of one match: who played, its seed and every
+// tick's input for replays, when each goal fell and how long each rally was.
+struct HeadlessMatch
+{
+    string player1Name;
+    string player2Name;
+    vector<unsigned char> inputs;
+    vector<int> goalTicks;
+    vector<int> rallyHits;
+    MatchState state;
+    unsigned int seed;
+    bool fixedPoint;
+
+    // Room for a typical match up front, so a record rarely has to grow
+    static const int EXPECTED_TICKS = 16384;
+    static const int EXPECTED_GOALS = 32;
+
+    HeadlessMatch()
+    {
+        inputs.reserve(EXPECTED_TICKS);
+        goalTicks.reserve(EXPECTED_GOALS);
+        rallyHits.reserve(EXPECTED_GOALS);
+        seed = 0;
+        fixedPoint = false;
+    }
+
+    // Play a computer-vs-computer match to the end, or until maxTicks; state mirrors the fixed-point backend
+    void play(const RuleSet& ruleSet, unsigned int matchSeed, int maxTicks, bool useFixedPoint = false)
+    {
+        player1Name = ruleSet.name;
+        player1Name += " computer (left)";
+        player2Name = ruleSet.name;
+        player2Name += " computer (right)";
+        seed = matchSeed;
+        fixedPoint = useFixedPoint;
+
+        FixedMatchState fixedState;
+        if (fixedPoint == true)
+        {
+            ruleSet.resetFixed(fixedState, seed);
+            state = toMatchState(fixedState);
+        }
+        else
+        {
+            ruleSet.reset(state, seed);
+        }
+
+        int hits = 0;
+        while (ruleSet.getWinner(state) == 0 && state.tick < maxTicks)
+        {
+            unsigned int input;
+            unsigned int events;
+            if (fixedPoint == true)
+            {
+                input = ruleSet.aiInputFixed(fixedState, 1) | ruleSet.aiInputFixed(fixedState, 2);
+                events = ruleSet.stepFixed(fixedState, input);
+                state = toMatchState(fixedState);
+            }
+            else
+            {
+                input = ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2);
+                events = ruleSet.step(state, input);
+            }
+            inputs.push_back((unsigned char)input);
+
+            if ((events & (EVENT_PADDLE1_HIT | EVENT_PADDLE2_HIT)) != 0)
+            {
+                hits = hits + 1;
+            }
+            if ((events & (EVENT_GOAL_P1 | EVENT_GOAL_P2)) != 0)
+            {
+                goalTicks.push_back(state.tick);
+                rallyHits.push_back(hits);
+                hits = 0;
+            }
+        }
+    }
+};
+
+
+// Many replays in one file, each seekable to any tick. A replay is cut into
+// blocks of a fixed interval of ticks, stored in the header. A block holds
+// the match state at its first tick, then each player's inputs as a stream
+// of varint tokens over runs of equal 2-bit input:
+//   (length << 3) | (input << 1)                  a run of one input
+//   (count << 5) | ((period - 2) << 1) | 1         the next count runs repeat
+//                                                  the runs period back
+// A player's stream holds either the raw inputs or, when that is smaller,
+// the inputs XOR the built-in computer player's choice for the same state.
+// A computer player's stream is then a single run of zeros, and a human's
+// stays raw. Keyframes are each state word minus the replay's start state
+// (the tick minus the block's first tick), zigzag varints. After a replay's
+// blocks comes its index, and the file ends with a directory sorted by match
+// id and a trailer, little-endian:
+//   "PRPL", u32 version, u32 interval
+//   block: keyframe, u8 predicted players (bit 0 player 1, bit 1 player 2),
+//     player 1 tokens, player 2 tokens
+//   replays: blocks, then u32 ticks, u32 blocks, u32 start state[10],
+//     u32 offset[blocks]
+//   directory entries: u64 match id, u64 replay offset, u32 index offset in the
+//     replay, u32 ticks, u8 rule set, u8 flags, u16 zero
+//   trailer: u64 directory offset, u32 replay count, "PRPE"
+// Block offsets are relative to the start of their replay. States are the raw
+// words of MatchState or FixedMatchState, depending on the replay's flags.
+class ReplayArchive
+{
+public:
+    static const unsigned int VERSION = 2;
+    static constexpr int KEYFRAME_INTERVAL = 1200;
+    static const int FLAG_FIXED_POINT = 1;
+    static const int STATE_WORDS = 10;
+    static const int TICK_WORD = 8;
+    static const int KEYFRAME_BYTES = STATE_WORDS * 4;
+    static const int HEADER_BYTES = 12;
+    static const int INDEX_BYTES = 8 + KEYFRAME_BYTES;
+    static const int ENTRY_BYTES = 28;
+    static const int TRAILER_BYTES = 16;
+    static const int MIN_PERIOD = 2;
+    static const int MAX_PERIOD = 17;
+
+    // One run of equal input, the unit the repeat tokens copy
+    struct Run
+    {
+        unsigned int input;
+        int length;
+
+        bool operator==(const Run& other) const
+        {
+            return input == other.input && length == other.length;
+        }
+    };
+
+    struct Entry
+    {
+        uint64_t matchId;
+        uint64_t offset;
+        uint32_t indexOffset;
+        uint32_t ticks;
+        int ruleSet;
+        int flags;
+    };
+
+    static void writeU32(vector<unsigned char>& out, uint32_t value)
+    {
+        out.push_back((unsigned char)(value & 0xFF));
+        out.push_back((unsigned char)((value >> 8) & 0xFF));
+        out.push_back((unsigned char)((value >> 16) & 0xFF));
+        out.push_back((unsigned char)((value >> 24) & 0xFF));
+    }
+
+    static void writeU64(vector<unsigned char>& out, uint64_t value)
+    {
+        writeU32(out, (uint32_t)value);
+        writeU32(out, (uint32_t)(value >> 32));
+    }
+
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static uint64_t readU64(const unsigned char* p)
+    {
+        return (uint64_t)readU32(p) | ((uint64_t)readU32(p + 4) << 32);
+    }
+
+    static void writeVarint(vector<unsigned char>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((unsigned char)(value | 0x80));
+            value = value >> 7;
+        }
+        out.push_back((unsigned char)value);
+    }
+
+    // Returns the bytes used, or 0 if the varint runs past end
+    static int readVarint(const unsigned char* p, const unsigned char* end, uint32_t& value)
+    {
+        value = 0;
+        for (int i = 0; i < 5 && p + i < end; i++)
+        {
+            value = value | ((uint32_t)(p[i] & 0x7F) << (7 * i));
+            if ((p[i] & 0x80) == 0)
+            {
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+private:
+    ofstream file;
+    uint64_t fileBytes;
+    vector<Entry> directory;
+    vector<unsigned char> buffer;
+    vector<unsigned char> predicted;
+    vector<unsigned char> scratch;
+    vector<uint32_t> blockOffsets;
+    vector<Run> runs;
+
+    static void writeRuns(const vector<Run>& runs, vector<unsigned char>& out)
+    {
+        size_t i = 0;
+        while (i < runs.size())
+        {
+            size_t bestCount = 0;
+            int bestPeriod = 0;
+            for (int period = MIN_PERIOD; period <= MAX_PERIOD && period <= (int)i; period++)
+            {
+                size_t count = 0;
+                while (i + count < runs.size() && runs[i + count] == runs[i + count - period])
+                {
+                    count = count + 1;
+                }
+                if (count > bestCount)
+                {
+                    bestCount = count;
+                    bestPeriod = period;
+                }
+            }
+
+            if (bestCount >= 2)
+            {
+                writeVarint(out, ((uint32_t)bestCount << 5) | ((uint32_t)(bestPeriod - MIN_PERIOD) << 1) | 1);
+                i = i + bestCount;
+            }
+            else
+            {
+                writeVarint(out, ((uint32_t)runs[i].length << 3) | (runs[i].input << 1));
+                i = i + 1;
+            }
+        }
+    }
+
+    // One player's stream of (input >> shift) & 3, XOR the prediction if there is one
+    static void writeStream(const unsigned char* inputs, const unsigned char* prediction, int tickCount, int shift,
+                            vector<Run>& runs, vector<unsigned char>& out)
+    {
+        runs.clear();
+        int tick = 0;
+        while (tick < tickCount)
+        {
+            Run run;
+            run.input = 0;
+            run.length = 0;
+            while (tick + run.length < tickCount)
+            {
+                unsigned int input = inputs[tick + run.length];
+                if (prediction != nullptr)
+                {
+                    input = input ^ prediction[tick + run.length];
+                }
+                input = (input >> shift) & 3;
+                if (run.length > 0 && input != run.input)
+                {
+                    break;
+                }
+                run.input = input;
+                run.length = run.length + 1;
+            }
+            runs.push_back(run);
+            tick = tick + run.length;
+        }
+        writeRuns(runs, out);
+    }
+
+    // One player's stream: ORs (symbol << shift) into tickCount inputs
+    static int readStream(const unsigned char* p, const unsigned char* end, int tickCount, int shift, vector<Run>& runs,
+                          unsigned char* out)
+    {
+        const unsigned char* start = p;
+        int decoded = 0;
+        runs.clear();
+        while (decoded < tickCount)
+        {
+            uint32_t token;
+            int used = readVarint(p, end, token);
+            if (used == 0)
+            {
+                return -1;
+            }
+            p = p + used;
+
+            int count = 1;
+            int period = 0;
+            if ((token & 1) != 0)
+            {
+                count = (int)(token >> 5);
+                period = (int)((token >> 1) & 0xF) + MIN_PERIOD;
+                if (period > (int)runs.size())
+                {
+                    return -1;
+                }
+            }
+            for (int i = 0; i < count; i++)
+            {
+                Run run;
+                if (period == 0)
+                {
+                    run.input = (token >> 1) & 3;
+                    run.length = (int)(token >> 3);
+                }
+                else
+                {
+                    run = runs[runs.size() - period];
+                }
+                if (run.length == 0 || decoded + run.length > tickCount)
+                {
+                    return -1;
+                }
+                runs.push_back(run);
+                for (int t = 0; t < run.length; t++)
+                {
+                    out[decoded + t] = (unsigned char)(out[decoded + t] | (run.input << shift));
+                }
+                decoded = decoded + run.length;
+            }
+        }
+        return (int)(p - start);
+    }
+
+    // Each player's stream in the smaller of its two forms; prediction may be null
+    void writeBlockInputs(const unsigned char* inputs, const unsigned char* prediction, int tickCount)
+    {
+        size_t modesAt = buffer.size();
+        buffer.push_back(0);
+        for (int player = 0; player < 2; player++)
+        {
+            size_t rawAt = buffer.size();
+            writeStream(inputs, nullptr, tickCount, player * 2, runs, buffer);
+            if (prediction == nullptr)
+            {
+                continue;
+            }
+            scratch.clear();
+            writeStream(inputs, prediction, tickCount, player * 2, runs, scratch);
+            if (scratch.size() < buffer.size() - rawAt)
+            {
+                buffer.resize(rawAt);
+                buffer.insert(buffer.end(), scratch.begin(), scratch.end());
+                buffer[modesAt] = (unsigned char)(buffer[modesAt] | (1 << player));
+            }
+        }
+    }
+
+public:
+    // Inputs without prediction, for records that are checked by playing them again
+    static void encodeInputs(const unsigned char* inputs, int tickCount, vector<Run>& runs, vector<unsigned char>& out)
+    {
+        writeStream(inputs, nullptr, tickCount, 0, runs, out);
+        writeStream(inputs, nullptr, tickCount, 2, runs, out);
+    }
+
+    // Decode tickCount inputs written by encodeInputs onto out; returns the bytes used, or -1 if the tokens are invalid
+    static int decodeInputs(const unsigned char* p, const unsigned char* end, int tickCount, vector<Run>& runs,
+                            vector<unsigned char>& out)
+    {
+        return decodeStreams(p, end, tickCount, runs, out);
+    }
+
+    // Both players' streams onto out, as stored: predicted players still XOR their prediction
+    static int decodeStreams(const unsigned char* p, const unsigned char* end, int tickCount, vector<Run>& runs,
+                             vector<unsigned char>& out)
+    {
+        size_t first = out.size();
+        out.resize(first + tickCount, 0);
+        int used = 0;
+        for (int shift = 0; shift < 4; shift += 2)
+        {
+            int streamBytes = readStream(p + used, end, tickCount, shift, runs, out.data() + first);
+            if (streamBytes < 0)
+            {
+                return -1;
+            }
+            used = used + streamBytes;
+        }
+        return used;
+    }
+
+    // Undo the prediction of a block's inputs by playing it from its keyframe
+    template <class State>
+    static void resolvePredictions(State& state, unsigned int (*aiInput)(const State&, int),
+                                   unsigned int (*step)(State&, unsigned int), int modes, unsigned char* inputs,
+                                   int tickCount)
+    {
+        unsigned int mask = 0;
+        if ((modes & 1) != 0)
+        {
+            mask = mask | INPUT_P1_UP | INPUT_P1_DOWN;
+        }
+        if ((modes & 2) != 0)
+        {
+            mask = mask | INPUT_P2_UP | INPUT_P2_DOWN;
+        }
+        for (int t = 0; t < tickCount; t++)
+        {
+            unsigned int prediction = aiInput(state, 1) | aiInput(state, 2);
+            inputs[t] = (unsigned char)(inputs[t] ^ (prediction & mask));
+            step(state, inputs[t]);
+        }
+    }
+
+    static void writeKeyframe(vector<unsigned char>& out, const uint32_t* words, const uint32_t* reference, int firstTick)
+    {
+        for (int i = 0; i < STATE_WORDS; i++)
+        {
+            uint32_t base = i == TICK_WORD ? (uint32_t)firstTick : reference[i];
+            int32_t delta = (int32_t)(words[i] - base);
+            writeVarint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        }
+    }
+
+    // Returns the bytes used, or 0 if the keyframe runs past end
+    static int readKeyframe(const unsigned char* p, const unsigned char* end, const uint32_t* reference, int firstTick,
+                            uint32_t* words)
+    {
+        const unsigned char* start = p;
+        for (int i = 0; i < STATE_WORDS; i++)
+        {
+            uint32_t zigzag;
+            int used = readVarint(p, end, zigzag);
+            if (used == 0)
+            {
+                return 0;
+            }
+            p = p + used;
+            uint32_t base = i == TICK_WORD ? (uint32_t)firstTick : reference[i];
+            words[i] = base + ((zigzag >> 1) ^ (0u - (zigzag & 1)));
+        }
+        return (int)(p - start);
+    }
+
+    ReplayArchive()
+    {
+        fileBytes = 0;
+    }
+
+    ~ReplayArchive()
+    {
+        close();
+    }
+
+    bool create(const string& path)
+    {
+        file.open(path, ios::binary | ios::trunc);
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+        buffer.clear();
+        buffer.push_back('P');
+        buffer.push_back('R');
+        buffer.push_back('P');
+        buffer.push_back('L');
+        writeU32(buffer, VERSION);
+        writeU32(buffer, KEYFRAME_INTERVAL);
+        file.write((const char*)buffer.data(), buffer.size());
+        fileBytes = buffer.size();
+        directory.clear();
+        return file.good();
+    }
+
+    // Store one match from its seed and inputs; keyframes and predictions come from simulating it again
+    bool addReplay(uint64_t matchId, int ruleSetIndex, bool fixedPoint, unsigned int seed,
+                   const unsigned char* inputs, int tickCount)
+    {
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+
+        const RuleSet& ruleSet = RuleSetRegistry::all()[ruleSetIndex];
+        MatchState state;
+        FixedMatchState fixedState;
+        uint32_t startWords[STATE_WORDS];
+        if (fixedPoint == true)
+        {
+            ruleSet.resetFixed(fixedState, seed);
+            memcpy(startWords, &fixedState, KEYFRAME_BYTES);
+        }
+        else
+        {
+            ruleSet.reset(state, seed);
+            memcpy(startWords, &state, KEYFRAME_BYTES);
+        }
+
+        buffer.clear();
+        blockOffsets.clear();
+        int start = 0;
+        do
+        {
+            blockOffsets.push_back((uint32_t)buffer.size());
+            uint32_t words[STATE_WORDS];
+            if (fixedPoint == true)
+            {
+                memcpy(words, &fixedState, KEYFRAME_BYTES);
+            }
+            else
+            {
+                memcpy(words, &state, KEYFRAME_BYTES);
+            }
+            writeKeyframe(buffer, words, startWords, start);
+
+            // Runs and repeats never cross a block, so each block decodes on its own
+            int end = min(start + KEYFRAME_INTERVAL, tickCount);
+            predicted.clear();
+            for (int tick = start; tick < end; tick++)
+            {
+                if (fixedPoint == true)
+                {
+                    predicted.push_back((unsigned char)(ruleSet.aiInputFixed(fixedState, 1) | ruleSet.aiInputFixed(fixedState, 2)));
+                    ruleSet.stepFixed(fixedState, inputs[tick]);
+                }
+                else
+                {
+                    predicted.push_back((unsigned char)(ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2)));
+                    ruleSet.step(state, inputs[tick]);
+                }
+            }
+            writeBlockInputs(inputs + start, predicted.data(), end - start);
+            start = end;
+        }
+        while (start < tickCount);
+
+        Entry entry;
+        entry.matchId = matchId;
+        entry.offset = fileBytes;
+        entry.indexOffset = (uint32_t)buffer.size();
+        entry.ticks = (uint32_t)tickCount;
+        entry.ruleSet = ruleSetIndex;
+        entry.flags = fixedPoint == true ? FLAG_FIXED_POINT : 0;
+
+        writeU32(buffer, (uint32_t)tickCount);
+        writeU32(buffer, (uint32_t)blockOffsets.size());
+        for (int i = 0; i < STATE_WORDS; i++)
+        {
+            writeU32(buffer, startWords[i]);
+        }
+        for (size_t b = 0; b < blockOffsets.size(); b++)
+        {
+            writeU32(buffer, blockOffsets[b]);
+        }
+
+        file.write((const char*)buffer.data(), buffer.size());
+        fileBytes = fileBytes + buffer.size();
+        directory.push_back(entry);
+        return file.good();
+    }
+
+    // Write the directory and trailer; the file is unreadable until this runs
+    bool close()
+    {
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+
+        sort(directory.begin(), directory.end(), [](const Entry& a, const Entry& b) { return a.matchId < b.matchId; });
+        buffer.clear();
+        for (size_t i = 0; i < directory.size(); i++)
+        {
+            const Entry& entry = directory[i];
+            writeU64(buffer, entry.matchId);
+            writeU64(buffer, entry.offset);
+            writeU32(buffer, entry.indexOffset);
+            writeU32(buffer, entry.ticks);
+            buffer.push_back((unsigned char)entry.ruleSet);
+            buffer.push_back((unsigned char)entry.flags);
+            buffer.push_back(0);
+            buffer.push_back(0);
+        }
+        writeU64(buffer, fileBytes);
+        writeU32(buffer, (uint32_t)directory.size());
+        buffer.push_back('P');
+        buffer.push_back('R');
+        buffer.push_back('P');
+        buffer.push_back('E');
+
+        file.write((const char*)buffer.data(), buffer.size());
+        fileBytes = fileBytes + buffer.size();
+        bool written = file.good();
+        file.close();
+        return written;
+    }
+
+    uint64_t getBytesWritten() const
+    {
+        return fileBytes;
+    }
+};
+
+// Random access into a replay archive. Opening reads only the header, the
+// trailer and the directory; a seek then reads one replay index and one block.
+class ReplayReader
+{
+public:
+    // One block, decoded: the state at firstTick and one input per tick
+    struct Block
+    {
+        int firstTick;
+        int ruleSet;
+        int flags;
+        uint32_t keyframe[ReplayArchive::STATE_WORDS];
+        vector<unsigned char> inputs;
+    };
+
+private:
+    ifstream file;
+    int interval;
+    vector<ReplayArchive::Run> runs;
+    vector<ReplayArchive::Entry> directory;
+    vector<unsigned char> bytes;
+    long long bytesRead;
+
+    bool readAt(uint64_t offset, size_t count)
+    {
+        bytes.resize(count);
+        file.clear();
+        file.seekg((streamoff)offset);
+        file.read((char*)bytes.data(), count);
+        bytesRead = bytesRead + count;
+        return (size_t)file.gcount() == count;
+    }
+
+public:
+    ReplayReader()
+    {
+        interval = ReplayArchive::KEYFRAME_INTERVAL;
+        bytesRead = 0;
+    }
+
+    bool open(const string& path)
+    {
+        directory.clear();
+        file.open(path, ios::binary);
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+
+        file.seekg(0, ios::end);
+        uint64_t size = (uint64_t)file.tellg();
+        if (size < (uint64_t)(ReplayArchive::HEADER_BYTES + ReplayArchive::TRAILER_BYTES) ||
+            readAt(0, ReplayArchive::HEADER_BYTES) == false || memcmp(bytes.data(), "PRPL", 4) != 0 ||
+            ReplayArchive::readU32(&bytes[4]) != ReplayArchive::VERSION)
+        {
+            Logger::error("Replay archive has a bad header", LogField("path", path));
+            return false;
+        }
+        // Blocks are found from the interval the archive was written with
+        interval = (int)ReplayArchive::readU32(&bytes[8]);
+        if (interval <= 0)
+        {
+            Logger::error("Replay archive has a bad keyframe interval", LogField("path", path));
+            return false;
+        }
+
+        if (readAt(size - ReplayArchive::TRAILER_BYTES, ReplayArchive::TRAILER_BYTES) == false ||
+            memcmp(&bytes[12], "PRPE", 4) != 0)
+        {
+            Logger::error("Replay archive has no directory; it was not closed", LogField("path", path));
+            return false;
+        }
+        uint64_t directoryOffset = ReplayArchive::readU64(&bytes[0]);
+        uint32_t count = ReplayArchive::readU32(&bytes[8]);
+        if (directoryOffset + (uint64_t)count * ReplayArchive::ENTRY_BYTES + ReplayArchive::TRAILER_BYTES != size ||
+            readAt(directoryOffset, (size_t)count * ReplayArchive::ENTRY_BYTES) == false)
+        {
+            Logger::error("Replay archive directory is damaged", LogField("path", path));
+            return false;
+        }
+
+        directory.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const unsigned char* p = &bytes[i * ReplayArchive::ENTRY_BYTES];
+            ReplayArchive::Entry& entry = directory[i];
+            entry.matchId = ReplayArchive::readU64(p);
+            entry.offset = ReplayArchive::readU64(p + 8);
+            entry.indexOffset = ReplayArchive::readU32(p + 16);
+            entry.ticks = ReplayArchive::readU32(p + 20);
+            entry.ruleSet = p[24];
+            entry.flags = p[25];
+            if (entry.ruleSet >= (int)RuleSetRegistry::all().size() || entry.offset + entry.indexOffset > directoryOffset)
+            {
+                Logger::error("Replay archive entry is damaged", LogField("path", path), LogField("entry", (long long)i));
+                directory.clear();
+                return false;
+            }
+        }
+        bytesRead = 0;
+        return true;
+    }
+
+    int getReplayCount() const
+    {
+        return (int)directory.size();
+    }
+
+    const ReplayArchive::Entry& getReplay(int replay) const
+    {
+        return directory[replay];
+    }
+
+    int getInterval() const
+    {
+        return interval;
+    }
+
+    // Index of a match id, or -1
+    int findReplay(uint64_t matchId) const
+    {
+        size_t low = 0;
+        size_t high = directory.size();
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            if (directory[middle].matchId < matchId)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        if (low < directory.size() && directory[low].matchId == matchId)
+        {
+            return (int)low;
+        }
+        return -1;
+    }
+
+    int getBlockCount(int replay) const
+    {
+        const ReplayArchive::Entry& entry = directory[replay];
+        return max(1, (int)((entry.ticks + interval - 1) / interval));
+    }
+
+    // Read and decode one block of a replay
+    bool readBlock(int replay, int block, Block& out)
+    {
+        const ReplayArchive::Entry& entry = directory[replay];
+        if (readAt(entry.offset + entry.indexOffset, ReplayArchive::INDEX_BYTES) == false)
+        {
+            return false;
+        }
+        uint32_t ticks = ReplayArchive::readU32(&bytes[0]);
+        int blockCount = (int)ReplayArchive::readU32(&bytes[4]);
+        uint32_t startWords[ReplayArchive::STATE_WORDS];
+        for (int i = 0; i < ReplayArchive::STATE_WORDS; i++)
+        {
+            startWords[i] = ReplayArchive::readU32(&bytes[8 + i * 4]);
+        }
+        if (ticks != entry.ticks || blockCount != getBlockCount(replay) || block < 0 || block >= blockCount ||
+            readAt(entry.offset + entry.indexOffset + ReplayArchive::INDEX_BYTES + block * 4,
+                   block + 1 < blockCount ? 8 : 4) == false)
+        {
+            return false;
+        }
+        uint32_t start = ReplayArchive::readU32(&bytes[0]);
+        uint32_t end = block + 1 < blockCount ? ReplayArchive::readU32(&bytes[4]) : entry.indexOffset;
+        if (end <= start || end > entry.indexOffset || readAt(entry.offset + start, end - start) == false)
+        {
+            return false;
+        }
+
+        out.firstTick = block * interval;
+        out.ruleSet = entry.ruleSet;
+        out.flags = entry.flags;
+        const unsigned char* p = bytes.data();
+        const unsigned char* limit = bytes.data() + bytes.size();
+        int used = ReplayArchive::readKeyframe(p, limit, startWords, out.firstTick, out.keyframe);
+        if (used == 0 || p + used >= limit)
+        {
+            return false;
+        }
+        p = p + used;
+        int modes = *p;
+        p = p + 1;
+
+        int tickCount = min(interval, (int)ticks - out.firstTick);
+        out.inputs.clear();
+        if (ReplayArchive::decodeStreams(p, limit, tickCount, runs, out.inputs) < 0)
+        {
+            return false;
+        }
+        if (modes == 0)
+        {
+            return true;
+        }
+
+        const RuleSet& ruleSet = RuleSetRegistry::all()[entry.ruleSet];
+        if ((entry.flags & ReplayArchive::FLAG_FIXED_POINT) != 0)
+        {
+            FixedMatchState fixedState;
+            memcpy(&fixedState, out.keyframe, ReplayArchive::KEYFRAME_BYTES);
+            ReplayArchive::resolvePredictions(fixedState, ruleSet.aiInputFixed, ruleSet.stepFixed, modes,
+                                              out.inputs.data(), tickCount);
+        }
+        else
+        {
+            MatchState state;
+            memcpy(&state, out.keyframe, ReplayArchive::KEYFRAME_BYTES);
+            ReplayArchive::resolvePredictions(state, ruleSet.aiInput, ruleSet.step, modes, out.inputs.data(), tickCount);
+        }
+        return true;
+    }
+
+    // The match state just before the given tick runs, from the one block that holds it
+    bool seek(int replay, int tick, MatchState& state)
+    {
+        const ReplayArchive::Entry& entry = directory[replay];
+        if (tick < 0 || tick > (int)entry.ticks)
+        {
+            return false;
+        }
+
+        Block block;
+        int blockIndex = min(tick / interval, getBlockCount(replay) - 1);
+        if (readBlock(replay, blockIndex, block) == false)
+        {
+            return false;
+        }
+
+        const RuleSet& ruleSet = RuleSetRegistry::all()[block.ruleSet];
+        if ((block.flags & ReplayArchive::FLAG_FIXED_POINT) != 0)
+        {
+            FixedMatchState fixedState;
+            memcpy(&fixedState, block.keyframe, ReplayArchive::KEYFRAME_BYTES);
+            for (int t = block.firstTick; t < tick; t++)
+            {
+                ruleSet.stepFixed(fixedState, block.inputs[t - block.firstTick]);
+            }
+            state = toMatchState(fixedState);
+        }
+        else
+        {
+            memcpy(&state, block.keyframe, ReplayArchive::KEYFRAME_BYTES);
+            for (int t = block.firstTick; t < tick; t++)
+            {
+                ruleSet.step(state, block.inputs[t - block.firstTick]);
+            }
+        }
+        return true;
+    }
+
+    long long getBytesRead() const
+    {
+        return bytesRead;
+    }
+};
+
+
+// A high score claim with the replay of the match that earned it. The
+// keyframes are the live match state at the start of every block of
+// ReplayArchive::KEYFRAME_INTERVAL ticks, taken while the match was played;
+// checks hold one byte of the state after every tick, which names the exact
+// tick a replay stops reproducing.
+struct ScoreSubmission
+{
+    uint64_t matchId;
+    string name;
+    int score1;
+    int score2;
+    int ruleSet;
+    int flags;
+    unsigned int seed;
+    vector<uint32_t> keyframes;
+    vector<unsigned char> inputs;
+    vector<unsigned char> checks;
+
+    // FNV-1a over the raw state words of MatchState or FixedMatchState, folded to a byte
+    static unsigned char checkState(const void* state)
+    {
+        uint32_t words[ReplayArchive::STATE_WORDS];
+        memcpy(words, state, ReplayArchive::KEYFRAME_BYTES);
+        uint32_t hash = 2166136261u;
+        for (int i = 0; i < ReplayArchive::STATE_WORDS; i++)
+        {
+            hash = (hash ^ words[i]) * 16777619u;
+        }
+        return (unsigned char)(hash ^ (hash >> 8) ^ (hash >> 16) ^ (hash >> 24));
+    }
+};
+
+// Submissions waiting for verification. Records are appended one at a time,
+// so a crash loses at most the record being written, little-endian:
+//   "PSUB", u32 bytes in the rest of the record
+//   u64 match id, u32 seed, u32 score1, u32 score2, u8 rule set, u8 flags,
+//   u8 name length, name, u32 ticks
+//   per block: keyframe, then its input tokens as in ReplayArchive
+//   one check byte per tick
+class ScoreSubmissionLog
+{
+public:
+    static const int RECORD_HEADER_BYTES = 8;
+
+    static void encode(const ScoreSubmission& submission, vector<ReplayArchive::Run>& runs, vector<unsigned char>& out)
+    {
+        out.clear();
+        out.push_back('P');
+        out.push_back('S');
+        out.push_back('U');
+        out.push_back('B');
+        ReplayArchive::writeU32(out, 0);
+        ReplayArchive::writeU64(out, submission.matchId);
+        ReplayArchive::writeU32(out, submission.seed);
+        ReplayArchive::writeU32(out, (uint32_t)submission.score1);
+        ReplayArchive::writeU32(out, (uint32_t)submission.score2);
+        out.push_back((unsigned char)submission.ruleSet);
+        out.push_back((unsigned char)submission.flags);
+        size_t nameLength = min(submission.name.size(), (size_t)255);
+        out.push_back((unsigned char)nameLength);
+        out.insert(out.end(), submission.name.begin(), submission.name.begin() + nameLength);
+
+        int ticks = (int)submission.inputs.size();
+        ReplayArchive::writeU32(out, (uint32_t)ticks);
+        int start = 0;
+        for (size_t k = 0; k < submission.keyframes.size(); k += ReplayArchive::STATE_WORDS)
+        {
+            for (int i = 0; i < ReplayArchive::STATE_WORDS; i++)
+            {
+                ReplayArchive::writeU32(out, submission.keyframes[k + i]);
+            }
+            int end = min(start + ReplayArchive::KEYFRAME_INTERVAL, ticks);
+            ReplayArchive::encodeInputs(submission.inputs.data() + start, end - start, runs, out);
+            start = end;
+        }
+        out.insert(out.end(), submission.checks.begin(), submission.checks.end());
+
+        uint32_t recordBytes = (uint32_t)(out.size() - RECORD_HEADER_BYTES);
+        for (int i = 0; i < 4; i++)
+        {
+            out[4 + i] = (unsigned char)(recordBytes >> (8 * i));
+        }
+    }
+
+    static bool append(const string& path, const ScoreSubmission& submission)
+    {
+        vector<ReplayArchive::Run> runs;
+        vector<unsigned char> bytes;
+        encode(submission, runs, bytes);
+        ofstream file(path, ios::binary | ios::app);
+        file.write((const char*)bytes.data(), bytes.size());
+        return file.good();
+    }
+
+    // Decode the record starting at p; false if it is malformed
+    static bool decode(const unsigned char* p, size_t size, vector<ReplayArchive::Run>& runs, ScoreSubmission& out)
+    {
+        const unsigned char* end = p + size;
+        const int FIXED_BYTES = 8 + 4 + 4 + 4 + 3;
+        if (size < (size_t)(RECORD_HEADER_BYTES + FIXED_BYTES))
+        {
+            return false;
+        }
+        p = p + RECORD_HEADER_BYTES;
+        out.matchId = ReplayArchive::readU64(p);
+        out.seed = ReplayArchive::readU32(p + 8);
+        out.score1 = (int)ReplayArchive::readU32(p + 12);
+        out.score2 = (int)ReplayArchive::readU32(p + 16);
+        out.ruleSet = p[20];
+        out.flags = p[21];
+        int nameLength = p[22];
+        p = p + FIXED_BYTES;
+        if (end - p < nameLength + 4)
+        {
+            return false;
+        }
+        out.name.assign((const char*)p, nameLength);
+        p = p + nameLength;
+        int ticks = (int)ReplayArchive::readU32(p);
+        p = p + 4;
+
+        out.keyframes.clear();
+        out.inputs.clear();
+        out.checks.clear();
+        int start = 0;
+        do
+        {
+            if (ticks < 0 || end - p < ReplayArchive::KEYFRAME_BYTES)
+            {
+                return false;
+            }
+            for (int i = 0; i < ReplayArchive::STATE_WORDS; i++)
+            {
+                out.keyframes.push_back(ReplayArchive::readU32(p + i * 4));
+            }
+            p = p + ReplayArchive::KEYFRAME_BYTES;
+
+            int blockTicks = min(ReplayArchive::KEYFRAME_INTERVAL, ticks - start);
+            int used = ReplayArchive::decodeInputs(p, end, blockTicks, runs, out.inputs);
+            if (used < 0)
+            {
+                return false;
+            }
+            p = p + used;
+            start = start + blockTicks;
+        }
+        while (start < ticks);
+
+        if (end - p != ticks)
+        {
+            return false;
+        }
+        out.checks.assign(p, end);
+        return true;
+    }
+
+    // Read a whole log and find its records; a record cut short by a crash at the end is left out
+    static bool read(const string& path, vector<unsigned char>& bytes, vector<size_t>& recordOffsets)
+    {
+        ifstream file(path, ios::binary);
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+        bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+        recordOffsets.clear();
+        size_t offset = 0;
+        while (offset + RECORD_HEADER_BYTES <= bytes.size())
+        {
+            if (memcmp(&bytes[offset], "PSUB", 4) != 0)
+            {
+                return false;
+            }
+            size_t recordBytes = RECORD_HEADER_BYTES + ReplayArchive::readU32(&bytes[offset + 4]);
+            if (offset + recordBytes > bytes.size())
+            {
+                break;
+            }
+            recordOffsets.push_back(offset);
+            offset = offset + recordBytes;
+        }
+        recordOffsets.push_back(offset);
+        return true;
+    }
+};
+
+// Outcome of playing a submission again; tick is the first tick whose
+// recorded state or result the simulation does not reproduce
+struct SubmissionVerdict
+{
+    bool accepted;
+    int tick;
+    const char* reason;
+};
+
+inline SubmissionVerdict rejectSubmission(int tick, const char* reason)
+{
+    SubmissionVerdict verdict;
+    verdict.accepted = false;
+    verdict.tick = tick;
+    verdict.reason = reason;
+    return verdict;
+}
+
+// Play the inputs from a fresh serve of the seed, checking each keyframe and
+// each tick's check byte on the way and the claimed score at the end. A
+// rejection names the tick whose step first came out different. Only a
+// match that ends on its last tick is accepted.
+template <class State>
+SubmissionVerdict verifySubmissionTicks(const ScoreSubmission& submission, State& state,
+                                        void (*reset)(State&, unsigned int), unsigned int (*step)(State&, unsigned int),
+                                        int maxScore)
+{
+    reset(state, submission.seed);
+    int ticks = (int)submission.inputs.size();
+    for (int tick = 0; tick <= ticks; tick++)
+    {
+        if (tick % ReplayArchive::KEYFRAME_INTERVAL == 0 && tick < ticks)
+        {
+            const uint32_t* keyframe = &submission.keyframes[tick / ReplayArchive::KEYFRAME_INTERVAL * ReplayArchive::STATE_WORDS];
+            if (memcmp(&state, keyframe, ReplayArchive::KEYFRAME_BYTES) != 0)
+            {
+                return rejectSubmission(tick, tick == 0 ? "the match does not start from a fresh serve"
+                                                        : "the recorded state differs");
+            }
+        }
+        if (state.score1 >= maxScore || state.score2 >= maxScore)
+        {
+            if (tick < ticks)
+            {
+                return rejectSubmission(tick, "the match goes on after it was won");
+            }
+            if (state.score1 != submission.score1 || state.score2 != submission.score2)
+            {
+                return rejectSubmission(tick, "the claimed score differs");
+            }
+            SubmissionVerdict verdict;
+            verdict.accepted = true;
+            verdict.tick = ticks;
+            verdict.reason = "";
+            return verdict;
+        }
+        if (tick < ticks)
+        {
+            step(state, submission.inputs[tick]);
+            if (ScoreSubmission::checkState(&state) != submission.checks[tick])
+            {
+                return rejectSubmission(tick, "the recorded state differs");
+            }
+        }
+    }
+    return rejectSubmission(ticks, "the match is unfinished");
+}
+
+inline SubmissionVerdict verifySubmission(const ScoreSubmission& submission)
+{
+    const vector<RuleSet>& ruleSets = RuleSetRegistry::all();
+    if (submission.ruleSet >= (int)ruleSets.size())
+    {
+        return rejectSubmission(0, "unknown rule set");
+    }
+    size_t blocks = max((size_t)1, (submission.inputs.size() + ReplayArchive::KEYFRAME_INTERVAL - 1) /
+                                       ReplayArchive::KEYFRAME_INTERVAL);
+    if (submission.keyframes.size() != blocks * ReplayArchive::STATE_WORDS ||
+        submission.checks.size() != submission.inputs.size())
+    {
+        return rejectSubmission(0, "the replay has no keyframe for every block or no check for every tick");
+    }
+
+    // Float results depend on the compiler, optimisation level and FMA contraction, so a
+    // genuine float match can fail against a verifier built differently
+    if ((submission.flags & ReplayArchive::FLAG_FIXED_POINT) == 0)
+    {
+        return rejectSubmission(0, "the match was not played with fixed-point physics");
+    }
+
+    const RuleSet& ruleSet = ruleSets[submission.ruleSet];
+    FixedMatchState state;
+    return verifySubmissionTicks(submission, state, ruleSet.resetFixed, ruleSet.stepFixed, ruleSet.maxScore);
+}
+
+// Values are stored in 1/256 units. For a paddle hit value0 is the hit offset
+// (-1 top edge, 1 bottom edge) and value1/value2 the ball velocity after the hit;
+// a wall bounce stores the ball's x as a fraction of the court; a goal stores
+// the ball's y as a fraction of the court; a rally end stores its hits and ticks.
+struct TelemetryEvent
+{
+    int type;
+    int player;
+    unsigned int match;
+    int tick;
+    float value0;
+    float value1;
+    float value2;
+};
+
+// Append-only columnar event log. Events are buffered into columns and a full
+// block is handed to a background thread, which encodes and writes it; each
+// column is delta, zigzag and varint encoded.
+//
+// File: "PTEL" u32 version, then blocks of
+//   u32 eventCount, u32 byteCount, COLUMN_COUNT x (u32 columnBytes, varints)
+class TelemetryLog
+{
+public:
+    static const int COLUMN_COUNT = 7;
+    static const int BLOCK_EVENTS = 4096;
+    static const uint32_t VERSION = 1;
+
+private:
+    ofstream file;
+    // The game thread fills columns; a full block is swapped into pending for the writer
+    vector<int32_t> columns[COLUMN_COUNT];
+    vector<int32_t> pending[COLUMN_COUNT];
+    vector<unsigned char> encoded;
+    atomic<long long> eventsWritten;
+    atomic<long long> bytesWritten;
+
+    mutex blockMutex;
+    condition_variable wake;
+    condition_variable writerIdle;
+    bool pendingFull;
+    bool running;
+    thread writer;
+
+    static void writeU32(vector<unsigned char>& out, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            out.push_back((unsigned char)(value >> (i * 8)));
+        }
+    }
+
+    static void writeVarint(vector<unsigned char>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((unsigned char)(value | 0x80));
+            value = value >> 7;
+        }
+        out.push_back((unsigned char)value);
+    }
+
+    static int32_t quantize(float value)
+    {
+        return (int32_t)lround(value * 256.0f);
+    }
+
+    // Give the buffered events to the writer; waits only if it is still on the previous block
+    void handOff()
+    {
+        if (columns[0].empty() == true)
+        {
+            return;
+        }
+        {
+            unique_lock<mutex> lock(blockMutex);
+            writerIdle.wait(lock, [this]() { return pendingFull == false; });
+            for (int c = 0; c < COLUMN_COUNT; c++)
+            {
+                columns[c].swap(pending[c]);
+            }
+            pendingFull = true;
+        }
+        wake.notify_one();
+    }
+
+    void writeLoop()
+    {
+        unique_lock<mutex> lock(blockMutex);
+        while (true)
+        {
+            wake.wait(lock, [this]() { return pendingFull == true || running == false; });
+            if (pendingFull == true)
+            {
+                lock.unlock();
+                writeBlock();
+                lock.lock();
+                pendingFull = false;
+                writerIdle.notify_all();
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    // Encode and write the pending events as one block; runs on the writer thread
+    void writeBlock()
+    {
+        int count = (int)pending[0].size();
+        encoded.clear();
+        writeU32(encoded, count);
+        writeU32(encoded, 0);
+
+        for (int c = 0; c < COLUMN_COUNT; c++)
+        {
+            size_t lengthAt = encoded.size();
+            writeU32(encoded, 0);
+
+            int32_t previous = 0;
+            for (int i = 0; i < count; i++)
+            {
+                int32_t delta = (int32_t)((uint32_t)pending[c][i] - (uint32_t)previous);
+                writeVarint(encoded, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+                previous = pending[c][i];
+            }
+
+            uint32_t length = (uint32_t)(encoded.size() - lengthAt - 4);
+            memcpy(&encoded[lengthAt], &length, 4);
+            pending[c].clear();
+        }
+
+        uint32_t blockBytes = (uint32_t)(encoded.size() - 8);
+        memcpy(&encoded[4], &blockBytes, 4);
+        file.write((const char*)encoded.data(), encoded.size());
+        file.flush();
+
+        eventsWritten = eventsWritten + count;
+        bytesWritten = bytesWritten + (long long)encoded.size();
+    }
+
+public:
+    TelemetryLog()
+    {
+        eventsWritten = 0;
+        bytesWritten = 0;
+        pendingFull = false;
+        running = false;
+        for (int c = 0; c < COLUMN_COUNT; c++)
+        {
+            columns[c].reserve(BLOCK_EVENTS);
+            pending[c].reserve(BLOCK_EVENTS);
+        }
+        // Worst case is five bytes per value plus the block and column headers
+        encoded.reserve(8 + COLUMN_COUNT * (4 + BLOCK_EVENTS * 5));
+    }
+
+    ~TelemetryLog()
+    {
+        close();
+    }
+
+    // Open for appending, writing the header if the file is new
+    bool open(const string& path)
+    {
+        file.open(path, ios::binary | ios::app);
+        if (!file)
+        {
+            return false;
+        }
+
+        if (file.tellp() == 0)
+        {
+            file.write("PTEL", 4);
+            vector<unsigned char> version;
+            writeU32(version, VERSION);
+            file.write((const char*)version.data(), version.size());
+        }
+
+        running = true;
+        writer = thread(&TelemetryLog::writeLoop, this);
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return file.is_open();
+    }
+
+    void record(int type, int player, unsigned int match, int tick, float value0, float value1, float value2)
+    {
+        if (file.is_open() == false)
+        {
+            return;
+        }
+
+        columns[0].push_back(type);
+        columns[1].push_back(player);
+        columns[2].push_back((int32_t)match);
+        columns[3].push_back(tick);
+        columns[4].push_back(quantize(value0));
+        columns[5].push_back(quantize(value1));
+        columns[6].push_back(quantize(value2));
+
+        if ((int)columns[0].size() == BLOCK_EVENTS)
+        {
+            handOff();
+        }
+    }
+
+    // Write buffered events as one block and wait until it is on disk
+    void flush()
+    {
+        if (file.is_open() == false)
+        {
+            return;
+        }
+        handOff();
+        unique_lock<mutex> lock(blockMutex);
+        writerIdle.wait(lock, [this]() { return pendingFull == false; });
+    }
+
+    void close()
+    {
+        if (file.is_open() == true)
+        {
+            flush();
+            {
+                lock_guard<mutex> lock(blockMutex);
+                running = false;
+            }
+            wake.notify_one();
+            writer.join();
+            file.close();
+        }
+    }
+
+    long long getEventsWritten() const
+    {
+        return eventsWritten;
+    }
+
+    long long getBytesWritten() const
+    {
+        return bytesWritten;
+    }
+};
+
+// Streams a telemetry log one block at a time, so file size does not matter.
+// Header fields are little-endian, as the writer lays them out.
+class TelemetryReader
+{
+private:
+    ifstream file;
+    vector<unsigned char> block;
+    vector<int32_t> columns[TelemetryLog::COLUMN_COUNT];
+
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static bool decodeColumn(const unsigned char* p, const unsigned char* end, int count, vector<int32_t>& out)
+    {
+        out.resize(count);
+        int32_t previous = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t value = 0;
+            int shift = 0;
+            while (true)
+            {
+                if (p >= end || shift > 28)
+                {
+                    return false;
+                }
+                unsigned char byte = *p++;
+                value = value | ((uint32_t)(byte & 0x7F) << shift);
+                shift = shift + 7;
+                if ((byte & 0x80) == 0)
+                {
+                    break;
+                }
+            }
+
+            int32_t delta = (int32_t)((value >> 1) ^ (0u - (value & 1)));
+            previous = (int32_t)((uint32_t)previous + (uint32_t)delta);
+            out[i] = previous;
+        }
+        return p == end;
+    }
+
+public:
+    bool open(const string& path)
+    {
+        file.open(path, ios::binary);
+        char header[8];
+        if (!file || !file.read(header, 8) || memcmp(header, "PTEL", 4) != 0 ||
+            readU32((const unsigned char*)header + 4) != TelemetryLog::VERSION)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    // Decode the next block into events; false at the end of the file or on a damaged block
+    bool nextBlock(vector<TelemetryEvent>& events)
+    {
+        unsigned char header[8];
+        if (!file.read((char*)header, 8))
+        {
+            return false;
+        }
+
+        uint32_t count = readU32(header);
+        uint32_t byteCount = readU32(header + 4);
+        if (count == 0 || count > (uint32_t)TelemetryLog::BLOCK_EVENTS || byteCount > 64u * 1024 * 1024)
+        {
+            return false;
+        }
+
+        block.resize(byteCount);
+        if (!file.read((char*)block.data(), byteCount))
+        {
+            return false;
+        }
+
+        const unsigned char* p = block.data();
+        const unsigned char* end = p + byteCount;
+        for (int c = 0; c < TelemetryLog::COLUMN_COUNT; c++)
+        {
+            if (end - p < 4)
+            {
+                return false;
+            }
+            uint32_t length = readU32(p);
+            p = p + 4;
+            if (length > (uint32_t)(end - p) || decodeColumn(p, p + length, count, columns[c]) == false)
+            {
+                return false;
+            }
+            p = p + length;
+        }
+
+        events.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            events[i].type = columns[0][i];
+            events[i].player = columns[1][i];
+            events[i].match = (unsigned int)columns[2][i];
+            events[i].tick = columns[3][i];
+            events[i].value0 = columns[4][i] / 256.0f;
+            events[i].value1 = columns[5][i] / 256.0f;
+            events[i].value2 = columns[6][i] / 256.0f;
+        }
+        return true;
+    }
+};
+
+// Turns a classic match's per-tick MatchEvent bits into telemetry rows
+class MatchTelemetry
+{
+private:
+    TelemetryLog& log;
+    unsigned int matchId;
+    int rallyHits;
+    int rallyStartTick;
+
+    void recordHit(const RuleSet& ruleSet, const MatchState& state, int player, float paddleY)
+    {
+        float halfPaddle = ruleSet.paddleHeight / 2;
+        float offset = ((state.ballY + ruleSet.ballSize / 2) - (paddleY + halfPaddle)) / halfPaddle;
+        log.record(TELEMETRY_PADDLE_HIT, player, matchId, state.tick, offset, state.ballVelocityX, state.ballVelocityY);
+        rallyHits = rallyHits + 1;
+    }
+
+    void endRally(const MatchState& state, int scorer, float ballYBefore, const RuleSet& ruleSet)
+    {
+        log.record(TELEMETRY_GOAL, scorer, matchId, state.tick, ballYBefore / ruleSet.courtHeight, 0, 0);
+        log.record(TELEMETRY_RALLY_END, scorer, matchId, state.tick, (float)rallyHits, (float)(state.tick - rallyStartTick), 0);
+        // The match-ending goal serves no new rally
+        if (ruleSet.getWinner(state) == 0)
+        {
+            log.record(TELEMETRY_RALLY_START, 0, matchId, state.tick, 0, state.ballVelocityX, state.ballVelocityY);
+        }
+        rallyHits = 0;
+        rallyStartTick = state.tick;
+    }
+
+public:
+    MatchTelemetry(TelemetryLog& telemetryLog) : log(telemetryLog)
+    {
+        matchId = 0;
+        rallyHits = 0;
+        rallyStartTick = 0;
+    }
+
+    void beginMatch(unsigned int id, const MatchState& state)
+    {
+        matchId = id;
+        rallyHits = 0;
+        rallyStartTick = state.tick;
+        log.record(TELEMETRY_RALLY_START, 0, matchId, state.tick, 0, state.ballVelocityX, state.ballVelocityY);
+    }
+
+    // Call after every step with its events and the ball's y before the step
+    void recordTick(const RuleSet& ruleSet, const MatchState& state, unsigned int events, float ballYBefore)
+    {
+        if (events == 0)
+        {
+            return;
+        }
+
+        if ((events & EVENT_WALL_BOUNCE) != 0)
+        {
+            log.record(TELEMETRY_WALL_BOUNCE, 0, matchId, state.tick, state.ballX / ruleSet.courtWidth, 0, 0);
+        }
+        if ((events & EVENT_PADDLE1_HIT) != 0)
+        {
+            recordHit(ruleSet, state, 1, state.paddle1Y);
+        }
+        if ((events & EVENT_PADDLE2_HIT) != 0)
+        {
+            recordHit(ruleSet, state, 2, state.paddle2Y);
+        }
+        if ((events & EVENT_GOAL_P1) != 0)
+        {
+            endRally(state, 1, ballYBefore, ruleSet);
+        }
+        else if ((events & EVENT_GOAL_P2) != 0)
+        {
+            endRally(state, 2, ballYBefore, ruleSet);
+        }
+    }
+};
+
+
+// Per-tick invariants for long soak runs, and the process's memory use
+class SoakMonitor
+{
+public:
+    // Resident set size in bytes, or -1 where it cannot be read
+    static long long getResidentBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+        {
+            return -1;
+        }
+        return (long long)counters.WorkingSetSize;
+#else
+        ifstream statm("/proc/self/statm");
+        long long totalPages;
+        long long residentPages;
+        if (!(statm >> totalPages >> residentPages))
+        {
+            return -1;
+        }
+        return residentPages * sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    // Check one step from before to after; returns what went wrong, or nullptr
+    static const char* checkTick(const RuleSet& ruleSet, const MatchState& before, const MatchState& after, unsigned int events)
+    {
+        const DynamicRules& rules = ruleSet.values;
+        const float EPSILON = 0.001f;
+
+        if (isfinite(after.ballX) == false || isfinite(after.ballY) == false ||
+            isfinite(after.ballVelocityX) == false || isfinite(after.ballVelocityY) == false)
+        {
+            return "ball position or velocity is not finite";
+        }
+
+        if (after.ballY < -EPSILON || after.ballY + rules.BALL_SIZE > rules.COURT_HEIGHT + EPSILON)
+        {
+            return "ball is outside the court vertically";
+        }
+
+        // A serve can go up to 1.5x BALL_SPEED vertically; paddle hits clamp to BALL_SPEED
+        if (fabs(after.ballVelocityX) > rules.MAX_BALL_SPEED + EPSILON || fabs(after.ballVelocityY) > rules.BALL_SPEED * 1.5f + EPSILON)
+        {
+            return "ball is faster than the rule set allows";
+        }
+
+        if (after.score1 > rules.MAX_SCORE || after.score2 > rules.MAX_SCORE)
+        {
+            return "score is above MAX_SCORE";
+        }
+
+        if (after.paddle1Y < -EPSILON || after.paddle1Y + rules.PADDLE_HEIGHT > rules.COURT_HEIGHT + EPSILON ||
+            after.paddle2Y < -EPSILON || after.paddle2Y + rules.PADDLE_HEIGHT > rules.COURT_HEIGHT + EPSILON)
+        {
+            return "paddle is outside the court";
+        }
+
+        // Where the ball went this tick, before any paddle bounce
+        float movedX = before.ballX + before.ballVelocityX;
+        float movedY = min(max(before.ballY + before.ballVelocityY, 0.0f), rules.COURT_HEIGHT - rules.BALL_SIZE);
+        float paddle1X = MatchSimulation<DynamicRules>::getPaddleX(1, rules);
+        float paddle2X = MatchSimulation<DynamicRules>::getPaddleX(2, rules);
+        bool overlaps1 = movedY < after.paddle1Y + rules.PADDLE_HEIGHT && movedY + rules.BALL_SIZE > after.paddle1Y;
+        bool overlaps2 = movedY < after.paddle2Y + rules.PADDLE_HEIGHT && movedY + rules.BALL_SIZE > after.paddle2Y;
+
+        // A ball that crossed a paddle's face level with the paddle must have been hit
+        float face1 = paddle1X + rules.PADDLE_WIDTH;
+        if (before.ballVelocityX < 0 && before.ballX >= face1 && movedX < face1 && overlaps1 == true &&
+            (events & EVENT_PADDLE1_HIT) == 0)
+        {
+            return "ball crossed paddle 1 without a hit";
+        }
+
+        float face2 = paddle2X;
+        if (before.ballVelocityX > 0 && before.ballX + rules.BALL_SIZE <= face2 && movedX + rules.BALL_SIZE > face2 &&
+            overlaps2 == true && (events & EVENT_PADDLE2_HIT) == 0)
+        {
+            return "ball crossed paddle 2 without a hit";
+        }
+
+        // Nothing in front of a paddle may be left inside it
+        float centerX = after.ballX + rules.BALL_SIZE / 2;
+        if (MatchSimulation<DynamicRules>::overlapsPaddle(after, paddle1X, after.paddle1Y, rules) &&
+            centerX > paddle1X + rules.PADDLE_WIDTH / 2 && after.ballVelocityX < 0)
+        {
+            return "ball is stuck in paddle 1";
+        }
+        if (MatchSimulation<DynamicRules>::overlapsPaddle(after, paddle2X, after.paddle2Y, rules) &&
+            centerX < paddle2X + rules.PADDLE_WIDTH / 2 && after.ballVelocityX > 0)
+        {
+            return "ball is stuck in paddle 2";
+        }
+
+        return nullptr;
+    }
+};
+
+
+// Always-on record of the last few minutes of play in a fixed-size file mapped
+// into memory. Each tick is one 64-byte record written straight into the
+// mapping, so there are no system calls on the hot path and the kernel keeps the
+// pages if the process crashes. A record's sequence number is cleared before its
+// payload is written and set afterwards, so a half-written record is skipped.
+struct FlightRecord
+{
+    uint64_t sequence;
+    uint32_t state[10];
+    uint8_t inputs;
+    uint8_t events;
+    uint8_t ruleSet;
+    uint8_t flags;
+    uint32_t frameMicros;
+    uint32_t timeMs;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FlightRecord) == 64, "Flight records are one cache line");
+static_assert(sizeof(MatchState) == 40 && sizeof(FixedMatchState) == 40, "Flight records hold either state as is");
+
+class FlightRecorder
+{
+public:
+    static const int VERSION = 1;
+    static const int HEADER_BYTES = 4096;
+    // About nine minutes of play at 60 ticks per second, 2 MB on disk
+    static const int RECORD_COUNT = 32768;
+    static const size_t FILE_BYTES = HEADER_BYTES + (size_t)RECORD_COUNT * sizeof(FlightRecord);
+
+    enum Flags
+    {
+        FLAG_FIXED_POINT = 1,
+        FLAG_MULTI_BALL = 2,
+        FLAG_MATCH_START = 4,
+        FLAG_TWO_PLAYER = 8
+    };
+
+private:
+    unsigned char* data;
+    FlightRecord* records;
+    uint64_t sequence;
+    uint64_t elapsedMicros;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+
+public:
+    FlightRecorder()
+    {
+        data = nullptr;
+        records = nullptr;
+        sequence = 0;
+        elapsedMicros = 0;
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#endif
+    }
+
+    ~FlightRecorder()
+    {
+        close();
+    }
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // Map a fresh recording. The previous session's file is kept as <path>.prev,
+    // since after a crash that is the one worth decoding.
+    bool open(const string& path)
+    {
+        close();
+
+        string previous = path + ".prev";
+        remove(previous.c_str());
+        rename(path.c_str(), previous.c_str());
+
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                 CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, 0, (DWORD)FILE_BYTES, NULL);
+        if (mappingHandle == NULL)
+        {
+            close();
+            return false;
+        }
+
+        data = (unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, FILE_BYTES);
+#else
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        if (ftruncate(fd, (off_t)FILE_BYTES) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, FILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped != MAP_FAILED)
+        {
+            data = (unsigned char*)mapped;
+        }
+#endif
+
+        if (data == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        // Header: magic, version, record size, record count, start time
+        uint32_t fields[3] = { (uint32_t)VERSION, (uint32_t)sizeof(FlightRecord), (uint32_t)RECORD_COUNT };
+        int64_t startTime = (int64_t)time(nullptr);
+        memcpy(data, "PFLT", 4);
+        memcpy(data + 4, fields, sizeof(fields));
+        memcpy(data + 16, &startTime, sizeof(startTime));
+        records = (FlightRecord*)(data + HEADER_BYTES);
+        sequence = 0;
+        elapsedMicros = 0;
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+        {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != NULL)
+        {
+            CloseHandle(mappingHandle);
+            mappingHandle = NULL;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data != nullptr)
+        {
+            munmap(data, FILE_BYTES);
+        }
+#endif
+        data = nullptr;
+        records = nullptr;
+    }
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    // Record one tick: the state after it, the inputs and events of the tick and the frame time.
+    // state is a MatchState or, with FLAG_FIXED_POINT, a FixedMatchState.
+    void record(const void* state, unsigned int inputs, unsigned int events, int ruleSet, int flags, int frameMicros)
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        sequence = sequence + 1;
+        elapsedMicros = elapsedMicros + (uint64_t)max(frameMicros, 0);
+        FlightRecord& slot = records[sequence % RECORD_COUNT];
+
+        slot.sequence = 0;
+        atomic_thread_fence(memory_order_release);
+        memcpy(slot.state, state, sizeof(slot.state));
+        slot.inputs = (uint8_t)inputs;
+        slot.events = (uint8_t)events;
+        slot.ruleSet = (uint8_t)ruleSet;
+        slot.flags = (uint8_t)flags;
+        slot.frameMicros = (uint32_t)max(frameMicros, 0);
+        slot.timeMs = (uint32_t)(elapsedMicros / 1000);
+        slot.reserved = 0;
+        atomic_thread_fence(memory_order_release);
+        slot.sequence = sequence;
+    }
+
+    // Read every complete record of a recording, oldest first
+    static bool read(const string& path, vector<FlightRecord>& out, int64_t& startTime)
+    {
+        ifstream file(path, ios::binary);
+        vector<unsigned char> header(HEADER_BYTES);
+        if (!file || !file.read((char*)header.data(), HEADER_BYTES) || memcmp(header.data(), "PFLT", 4) != 0)
+        {
+            return false;
+        }
+
+        uint32_t fields[3];
+        memcpy(fields, &header[4], sizeof(fields));
+        memcpy(&startTime, &header[16], sizeof(startTime));
+        if (fields[0] != VERSION || fields[1] != sizeof(FlightRecord) || fields[2] != RECORD_COUNT)
+        {
+            return false;
+        }
+
+        vector<FlightRecord> slots(RECORD_COUNT);
+        if (!file.read((char*)slots.data(), slots.size() * sizeof(FlightRecord)))
+        {
+            return false;
+        }
+
+        out.clear();
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].sequence != 0 && slots[i].sequence % RECORD_COUNT == i)
+            {
+                out.push_back(slots[i]);
+            }
+        }
+        sort(out.begin(), out.end(), [](const FlightRecord& a, const FlightRecord& b)
+        {
+            return a.sequence < b.sequence;
+        });
+        return true;
+    }
+};
+
+
+// Entity components. Each kind lives in its own densely packed array in
+// ComponentStore, indexed by entity id, so systems walk memory linearly.
+struct TransformComponent
+{
+    float x;
+    float y;
+};
+
+struct VelocityComponent
+{
+    float x;
+    float y;
+};
+
+struct ColliderComponent
+{
+    float width;
+    float height;
+};
+
+struct RenderComponent
+{
+    Color fillColor;
+    Color outlineColor;
+    float outlineThickness;
+    int shape;
+    bool visible;
+};
+
+
+class ComponentStore
+{
+public:
+    enum ShapeType
+    {
+        SHAPE_RECTANGLE,
+        SHAPE_CIRCLE
+    };
+
+private:
+    vector<TransformComponent> transforms;
+    vector<VelocityComponent> velocities;
+    vector<ColliderComponent> colliders;
+    vector<RenderComponent> renders;
+
+    // Every visible entity goes into this one batch each frame
+    VertexArray batch;
+
+    static const int CIRCLE_SEGMENTS = 24;
+    float circleX[CIRCLE_SEGMENTS + 1];
+    float circleY[CIRCLE_SEGMENTS + 1];
+
+    void appendQuad(int& v, float left, float top, float width, float height, Color color)
+    {
+        Vector2f topLeft(left, top);
+        Vector2f topRight(left + width, top);
+        Vector2f bottomRight(left + width, top + height);
+        Vector2f bottomLeft(left, top + height);
+
+        batch[v] = Vertex(topLeft, color);
+        batch[v + 1] = Vertex(topRight, color);
+        batch[v + 2] = Vertex(bottomRight, color);
+        batch[v + 3] = Vertex(topLeft, color);
+        batch[v + 4] = Vertex(bottomRight, color);
+        batch[v + 5] = Vertex(bottomLeft, color);
+        v = v + 6;
+    }
+
+    void appendCircle(int& v, float centerX, float centerY, float radius, Color color)
+    {
+        for (int s = 0; s < CIRCLE_SEGMENTS; s++)
+        {
+            batch[v] = Vertex(Vector2f(centerX, centerY), color);
+            batch[v + 1] = Vertex(Vector2f(centerX + circleX[s] * radius, centerY + circleY[s] * radius), color);
+            batch[v + 2] = Vertex(Vector2f(centerX + circleX[s + 1] * radius, centerY + circleY[s + 1] * radius), color);
+            v = v + 3;
+        }
+    }
+
+public:
+    ComponentStore()
+    {
+        batch.setPrimitiveType(Triangles);
+
+        for (int s = 0; s <= CIRCLE_SEGMENTS; s++)
+        {
+            circleX[s] = cos(s * 6.2831853f / CIRCLE_SEGMENTS);
+            circleY[s] = sin(s * 6.2831853f / CIRCLE_SEGMENTS);
+        }
+    }
+
+    // Add an entity with every component; returns its id
+    int createEntity(float x, float y, float width, float height, Color fillColor, int shape)
+    {
+        TransformComponent transform = { x, y };
+        VelocityComponent velocity = { 0, 0 };
+        ColliderComponent collider = { width, height };
+        RenderComponent render = { fillColor, Color::White, 0, shape, true };
+
+        transforms.push_back(transform);
+        velocities.push_back(velocity);
+        colliders.push_back(collider);
+        renders.push_back(render);
+        return (int)transforms.size() - 1;
+    }
+
+    int getEntityCount() const
+    {
+        return (int)transforms.size();
+    }
+
+    TransformComponent& transform(int entity)
+    {
+        return transforms[entity];
+    }
+
+    const TransformComponent& transform(int entity) const
+    {
+        return transforms[entity];
+    }
+
+    VelocityComponent& velocity(int entity)
+    {
+        return velocities[entity];
+    }
+
+    const VelocityComponent& velocity(int entity) const
+    {
+        return velocities[entity];
+    }
+
+    ColliderComponent& collider(int entity)
+    {
+        return colliders[entity];
+    }
+
+    const ColliderComponent& collider(int entity) const
+    {
+        return colliders[entity];
+    }
+
+    RenderComponent& render(int entity)
+    {
+        return renders[entity];
+    }
+
+    // Movement system: advance every entity by its velocity
+    void integrate()
+    {
+        size_t count = transforms.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            transforms[i].x = transforms[i].x + velocities[i].x;
+            transforms[i].y = transforms[i].y + velocities[i].y;
+        }
+    }
+
+    // Render system: one vertex batch and one draw call for every visible entity
+    void draw(RenderWindow& window)
+    {
+        size_t count = transforms.size();
+        int vertexCount = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (renders[i].visible == true)
+            {
+                if (renders[i].shape == SHAPE_RECTANGLE)
+                {
+                    vertexCount = vertexCount + 12;
+                }
+                else
+                {
+                    vertexCount = vertexCount + CIRCLE_SEGMENTS * 6;
+                }
+            }
+        }
+        batch.resize(vertexCount);
+
+        int v = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (renders[i].visible == false)
+            {
+                continue;
+            }
+
+            // Outline first, then the fill on top of it
+            float x = transforms[i].x;
+            float y = transforms[i].y;
+            float w = colliders[i].width;
+            float h = colliders[i].height;
+            float border = renders[i].outlineThickness;
+
+            if (renders[i].shape == SHAPE_RECTANGLE)
+            {
+                appendQuad(v, x - border, y - border, w + border * 2, h + border * 2, renders[i].outlineColor);
+                appendQuad(v, x, y, w, h, renders[i].fillColor);
+            }
+            else
+            {
+                appendCircle(v, x + w / 2, y + h / 2, w / 2 + border, renders[i].outlineColor);
+                appendCircle(v, x + w / 2, y + h / 2, w / 2, renders[i].fillColor);
+            }
+        }
+
+        window.draw(batch);
+    }
+};
+
+
+// Paddles and balls are handles onto entities in a ComponentStore; they
+// own no data of their own beyond what is needed to identify the entity.
+class Paddle
+{
+private:
+    ComponentStore& store;
+    int entity;
+    float speed;
+    int playerNumber;
+    int score;
+    Color originalColor;
+
+public:
+    // Constructor
+    Paddle(ComponentStore& entityStore, int playerNum) : store(entityStore)
+    {
+        playerNumber = playerNum;
+        score = 0;
+        speed = GameConstants::PADDLE_SPEED;
+
+        if (playerNumber == 1)
+        {
+            originalColor = GameConstants::PLAYER1_COLOR;
+        }
+        else
+        {
+            originalColor = GameConstants::PLAYER2_COLOR;
+        }
+
+        entity = store.createEntity(0, 0, GameConstants::PADDLE_WIDTH, GameConstants::PADDLE_HEIGHT,
+                                    originalColor, ComponentStore::SHAPE_RECTANGLE);
+        store.render(entity).outlineThickness = 2;
+
+        resetPosition();
+    }
+
+
+    void resetPosition()
+    {
+        TransformComponent& transform = store.transform(entity);
+
+        if (playerNumber == 1)
+        {
+            transform.x = 50;
+        }
+        else
+        {
+            transform.x = GameConstants::WINDOW_WIDTH - 50 - getWidth();
+        }
+
+        transform.y = GameConstants::WINDOW_HEIGHT / 2 - getHeight() / 2;
+    }
+
+
+    void moveUp()
+    {
+        TransformComponent& transform = store.transform(entity);
+
+        if (transform.y > 0)
+        {
+            transform.y = transform.y - speed;
+            if (transform.y < 0)
+            {
+                transform.y = 0;
+            }
+        }
+    }
+
+
+    void moveDown()
+    {
+        TransformComponent& transform = store.transform(entity);
+
+        if (transform.y + getHeight() < GameConstants::WINDOW_HEIGHT)
+        {
+            transform.y = transform.y + speed;
+            if (transform.y + getHeight() > GameConstants::WINDOW_HEIGHT)
+            {
+                transform.y = GameConstants::WINDOW_HEIGHT - getHeight();
+            }
+        }
+    }
+
+    float getX() const
+    {
+        return store.transform(entity).x;
+    }
+
+    float getY() const
+    {
+        return store.transform(entity).y;
+    }
+
+    float getWidth() const
+    {
+        return store.collider(entity).width;
+    }
+
+    float getHeight() const
+    {
+        return store.collider(entity).height;
+    }
+
+    int getScore() const
+    {
+        return score;
+    }
+
+    int getPlayerNumber() const
+    {
+        return playerNumber;
+    }
+
+    float getCenterY() const
+    {
+        return getY() + getHeight() / 2;
+    }
+
+    void setY(float y)
+    {
+        store.transform(entity).y = y;
+    }
+
+    void setX(float x)
+    {
+        store.transform(entity).x = x;
+    }
+
+    void setHeight(float height)
+    {
+        store.collider(entity).height = height;
+    }
+
+    void setScore(int s)
+    {
+        score = s;
+    }
+
+    void incrementScore()
+    {
+        score = score + 1;
+    }
+
+    // Flash paddle when score is made
+    void flash()
+    {
+        store.render(entity).fillColor = Color::Yellow;
+    }
+
+    // Reset paddle color
+    void resetColor()
+    {
+        store.render(entity).fillColor = originalColor;
+    }
+};
+
+
+class Ball
+{
+private:
+    ComponentStore& store;
+    int entity;
+    bool isActive;
+
+public:
+
+    Ball(ComponentStore& entityStore) : store(entityStore)
+    {
+        isActive = true;
+        entity = store.createEntity(0, 0, GameConstants::BALL_RADIUS * 2, GameConstants::BALL_RADIUS * 2,
+                                    GameConstants::BALL_COLOR, ComponentStore::SHAPE_CIRCLE);
+        store.render(entity).outlineThickness = 2;
+    }
+
+    // The match simulation moves the ball; this just mirrors it for drawing
+    void setPosition(float x, float y)
+    {
+        store.transform(entity).x = x;
+        store.transform(entity).y = y;
+    }
+
+    void setSize(float size)
+    {
+        store.collider(entity).width = size;
+        store.collider(entity).height = size;
+    }
+
+    // Getters
+    float getX() const
+    {
+        return store.transform(entity).x;
+    }
+
+    float getY() const
+    {
+        return store.transform(entity).y;
+    }
+
+    float getWidth() const
+    {
+        return store.collider(entity).width;
+    }
+
+    float getHeight() const
+    {
+        return store.collider(entity).height;
+    }
+
+    bool getIsActive() const
+    {
+        return isActive;
+    }
+
+    // An inactive ball is hidden
+    void setIsActive(bool active)
+    {
+        isActive = active;
+        store.render(entity).visible = active;
+    }
+};
+
+
+// Many small balls sharing the court (multi-ball mode).
+//
+// Ball state is kept in flat arrays and a uniform grid is rebuilt every
+// tick with a counting sort, so each ball only tests the balls in its own
+// and neighbouring cells. Cost grows with the ball count, not its square.
+class MultiBallField
+{
+public:
+    // A wall bounce or paddle hit, for the particle bursts
+    struct Impact
+    {
+        float x;
+        float y;
+        int player;
+    };
+
+    // Impacts kept per tick; with hundreds of balls the rest are not worth a burst
+    static const int MAX_IMPACTS = 16;
+
+private:
+    int ballCount;
+    float radius;
+    vector<float> posX;
+    vector<float> posY;
+    vector<float> velX;
+    vector<float> velY;
+
+    // Uniform grid; cells are one ball diameter wide
+    bool useBroadphase;
+    int gridColumns;
+    int gridRows;
+    float cellSize;
+    vector<int> cellStart;
+    vector<int> cellOf;
+    vector<int> sortedBalls;
+
+    VertexArray batch;
+    int goals[2];
+    long long pairTests;
+    Impact impacts[MAX_IMPACTS];
+    int impactCount;
+
+    static const int CIRCLE_SEGMENTS = 8;
+    float circleX[CIRCLE_SEGMENTS + 1];
+    float circleY[CIRCLE_SEGMENTS + 1];
+
+    void respawn(int i)
+    {
+        posX[i] = GameConstants::WINDOW_WIDTH / 2.0f;
+        posY[i] = (float)(rand() % (GameConstants::WINDOW_HEIGHT - 40) + 20);
+
+        float directionX;
+        if (rand() % 2 == 0)
+        {
+            directionX = 1;
+        }
+        else
+        {
+            directionX = -1;
+        }
+
+        velX[i] = GameConstants::BALL_SPEED * directionX;
+        velY[i] = GameConstants::BALL_SPEED * ((rand() % 201) - 100) / 100.0f;
+    }
+
+    int cellIndex(float x, float y) const
+    {
+        int column = (int)(x / cellSize);
+        int row = (int)(y / cellSize);
+
+        if (column < 0)
+        {
+            column = 0;
+        }
+        if (column >= gridColumns)
+        {
+            column = gridColumns - 1;
+        }
+        if (row < 0)
+        {
+            row = 0;
+        }
+        if (row >= gridRows)
+        {
+            row = gridRows - 1;
+        }
+
+        return row * gridColumns + column;
+    }
+
+    // Counting sort of balls into cells: O(balls + cells)
+    void buildGrid()
+    {
+        int cellCount = gridColumns * gridRows;
+        for (int c = 0; c <= cellCount; c++)
+        {
+            cellStart[c] = 0;
+        }
+
+        for (int i = 0; i < ballCount; i++)
+        {
+            cellOf[i] = cellIndex(posX[i], posY[i]);
+            cellStart[cellOf[i] + 1] = cellStart[cellOf[i] + 1] + 1;
+        }
+
+        for (int c = 0; c < cellCount; c++)
+        {
+            cellStart[c + 1] = cellStart[c + 1] + cellStart[c];
+        }
+
+        // cellStart[c] is used as the insert cursor and ends up at the start of cell c + 1
+        for (int i = 0; i < ballCount; i++)
+        {
+            sortedBalls[cellStart[cellOf[i]]] = i;
+            cellStart[cellOf[i]] = cellStart[cellOf[i]] + 1;
+        }
+
+        for (int c = cellCount; c > 0; c--)
+        {
+            cellStart[c] = cellStart[c - 1];
+        }
+        cellStart[0] = 0;
+    }
+
+    // Equal-mass elastic collision between two overlapping balls
+    void resolvePair(int a, int b)
+    {
+        pairTests = pairTests + 1;
+
+        float dx = posX[b] - posX[a];
+        float dy = posY[b] - posY[a];
+        float distanceSquared = dx * dx + dy * dy;
+        float minDistance = radius * 2;
+
+        if (distanceSquared >= minDistance * minDistance || distanceSquared == 0)
+        {
+            return;
+        }
+
+        float distance = sqrt(distanceSquared);
+        float nx = dx / distance;
+        float ny = dy / distance;
+
+        // Push the balls apart so they do not stick together
+        float overlap = (minDistance - distance) / 2;
+        posX[a] = posX[a] - nx * overlap;
+        posY[a] = posY[a] - ny * overlap;
+        posX[b] = posX[b] + nx * overlap;
+        posY[b] = posY[b] + ny * overlap;
+
+        // Swap the velocity components along the normal if they are approaching
+        float approach = (velX[a] - velX[b]) * nx + (velY[a] - velY[b]) * ny;
+        if (approach > 0)
+        {
+            velX[a] = velX[a] - approach * nx;
+            velY[a] = velY[a] - approach * ny;
+            velX[b] = velX[b] + approach * nx;
+            velY[b] = velY[b] + approach * ny;
+        }
+    }
+
+    void collideBallsWithGrid()
+    {
+        buildGrid();
+
+        // Visit each cell against itself and four forward neighbours so every pair is seen once
+        const int neighbourColumn[4] = { 1, -1, 0, 1 };
+        const int neighbourRow[4] = { 0, 1, 1, 1 };
+
+        for (int row = 0; row < gridRows; row++)
+        {
+            for (int column = 0; column < gridColumns; column++)
+            {
+                int cell = row * gridColumns + column;
+
+                for (int p = cellStart[cell]; p < cellStart[cell + 1]; p++)
+                {
+                    for (int q = p + 1; q < cellStart[cell + 1]; q++)
+                    {
+                        resolvePair(sortedBalls[p], sortedBalls[q]);
+                    }
+
+                    for (int n = 0; n < 4; n++)
+                    {
+                        int otherColumn = column + neighbourColumn[n];
+                        int otherRow = row + neighbourRow[n];
+                        if (otherColumn < 0 || otherColumn >= gridColumns || otherRow >= gridRows)
+                        {
+                            continue;
+                        }
+
+                        int other = otherRow * gridColumns + otherColumn;
+                        for (int q = cellStart[other]; q < cellStart[other + 1]; q++)
+                        {
+                            resolvePair(sortedBalls[p], sortedBalls[q]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Reference all-pairs version, kept for the benchmark
+    void collideBallsBruteForce()
+    {
+        for (int a = 0; a < ballCount; a++)
+        {
+            for (int b = a + 1; b < ballCount; b++)
+            {
+                resolvePair(a, b);
+            }
+        }
+    }
+
+    // player is 0 for a wall
+    void addImpact(float x, float y, int player)
+    {
+        if (impactCount < MAX_IMPACTS)
+        {
+            impacts[impactCount].x = x;
+            impacts[impactCount].y = y;
+            impacts[impactCount].player = player;
+            impactCount = impactCount + 1;
+        }
+    }
+
+    void collideWithPaddle(int i, const Paddle& paddle)
+    {
+        float left = paddle.getX() - radius;
+        float right = paddle.getX() + paddle.getWidth() + radius;
+        float top = paddle.getY() - radius;
+        float bottom = paddle.getY() + paddle.getHeight() + radius;
+
+        if (posX[i] < left || posX[i] > right || posY[i] < top || posY[i] > bottom)
+        {
+            return;
+        }
+
+        // Only bounce balls heading towards the paddle, so a ball cannot get stuck inside it
+        bool movingTowards;
+        if (paddle.getPlayerNumber() == 1)
+        {
+            movingTowards = velX[i] < 0;
+        }
+        else
+        {
+            movingTowards = velX[i] > 0;
+        }
+
+        if (movingTowards == true)
+        {
+            float normalizedHit = (posY[i] - paddle.getCenterY()) / (paddle.getHeight() / 2);
+            velX[i] = -velX[i];
+            velY[i] = normalizedHit * GameConstants::BALL_SPEED;
+            addImpact(posX[i], posY[i], paddle.getPlayerNumber());
+        }
+    }
+
+public:
+    MultiBallField()
+    {
+        ballCount = 0;
+        radius = GameConstants::MULTI_BALL_RADIUS;
+        useBroadphase = true;
+        cellSize = radius * 2;
+        gridColumns = (int)(GameConstants::WINDOW_WIDTH / cellSize) + 1;
+        gridRows = (int)(GameConstants::WINDOW_HEIGHT / cellSize) + 1;
+        cellStart.resize(gridColumns * gridRows + 1);
+        batch.setPrimitiveType(Triangles);
+
+        for (int s = 0; s <= CIRCLE_SEGMENTS; s++)
+        {
+            circleX[s] = cos(s * 6.2831853f / CIRCLE_SEGMENTS) * radius;
+            circleY[s] = sin(s * 6.2831853f / CIRCLE_SEGMENTS) * radius;
+        }
+
+        goals[0] = 0;
+        goals[1] = 0;
+        pairTests = 0;
+        impactCount = 0;
+    }
+
+    // Replace the field with a fresh set of balls launched from the center line
+    void spawn(int count)
+    {
+        ballCount = count;
+        posX.resize(count);
+        posY.resize(count);
+        velX.resize(count);
+        velY.resize(count);
+        cellOf.resize(count);
+        sortedBalls.resize(count);
+        batch.resize(count * CIRCLE_SEGMENTS * 3);
+
+        // Spread the opening set over the middle of the court so they do not start piled up
+        for (int i = 0; i < count; i++)
+        {
+            respawn(i);
+            posX[i] = GameConstants::WINDOW_WIDTH / 4.0f + rand() % (GameConstants::WINDOW_WIDTH / 2);
+        }
+
+        goals[0] = 0;
+        goals[1] = 0;
+        impactCount = 0;
+    }
+
+    void setBroadphase(bool enabled)
+    {
+        useBroadphase = enabled;
+    }
+
+    // One simulation tick: move, bounce off walls, paddles and each other, then score
+    void update(const Paddle& leftPaddle, const Paddle& rightPaddle)
+    {
+        impactCount = 0;
+        for (int i = 0; i < ballCount; i++)
+        {
+            posX[i] = posX[i] + velX[i];
+            posY[i] = posY[i] + velY[i];
+
+            if (posY[i] < radius)
+            {
+                posY[i] = radius;
+                velY[i] = -velY[i];
+                addImpact(posX[i], 0, 0);
+            }
+            else if (posY[i] > GameConstants::WINDOW_HEIGHT - radius)
+            {
+                posY[i] = GameConstants::WINDOW_HEIGHT - radius;
+                velY[i] = -velY[i];
+                addImpact(posX[i], GameConstants::WINDOW_HEIGHT, 0);
+            }
+
+            collideWithPaddle(i, leftPaddle);
+            collideWithPaddle(i, rightPaddle);
+        }
+
+        if (useBroadphase == true)
+        {
+            collideBallsWithGrid();
+        }
+        else
+        {
+            collideBallsBruteForce();
+        }
+
+        for (int i = 0; i < ballCount; i++)
+        {
+            if (posX[i] < 0)
+            {
+                goals[1] = goals[1] + 1;
+                respawn(i);
+            }
+            else if (posX[i] > GameConstants::WINDOW_WIDTH)
+            {
+                goals[0] = goals[0] + 1;
+                respawn(i);
+            }
+        }
+    }
+
+    // Goals scored by a player (1 or 2) since the last call
+    int takeGoals(int player)
+    {
+        int scored = goals[player - 1];
+        goals[player - 1] = 0;
+        return scored;
+    }
+
+    // Wall bounces and paddle hits of the last tick, up to MAX_IMPACTS
+    int getImpactCount() const
+    {
+        return impactCount;
+    }
+
+    const Impact& getImpact(int index) const
+    {
+        return impacts[index];
+    }
+
+    // Y of the ball that will reach the right-hand paddle first, for the AI
+    float getThreatY() const
+    {
+        float bestY = GameConstants::WINDOW_HEIGHT / 2.0f;
+        float bestTime = 1e30f;
+
+        for (int i = 0; i < ballCount; i++)
+        {
+            if (velX[i] > 0)
+            {
+                float time = (GameConstants::WINDOW_WIDTH - posX[i]) / velX[i];
+                if (time < bestTime)
+                {
+                    bestTime = time;
+                    bestY = posY[i];
+                }
+            }
+        }
+
+        return bestY;
+    }
+
+    // All balls go out in one draw call as a triangle batch
+    void draw(RenderWindow& window)
+    {
+        int v = 0;
+
+        for (int i = 0; i < ballCount; i++)
+        {
+            for (int s = 0; s < CIRCLE_SEGMENTS; s++)
+            {
+                batch[v].position = Vector2f(posX[i], posY[i]);
+                batch[v + 1].position = Vector2f(posX[i] + circleX[s], posY[i] + circleY[s]);
+                batch[v + 2].position = Vector2f(posX[i] + circleX[s + 1], posY[i] + circleY[s + 1]);
+                batch[v].color = GameConstants::BALL_COLOR;
+                batch[v + 1].color = GameConstants::BALL_COLOR;
+                batch[v + 2].color = GameConstants::BALL_COLOR;
+                v = v + 3;
+            }
+        }
+
+        window.draw(batch);
+    }
+
+    int getBallCount() const
+    {
+        return ballCount;
+    }
+
+    long long getPairTests() const
+    {
+        return pairTests;
+    }
+};
+
+
+// Short-lived sparks for paddle hits, wall bounces and goals.
+//
+// Particles live in a fixed-capacity structure-of-arrays pool that is
+// allocated once. The update kernel advances four particles per step with
+// SSE where available, and everything alive is drawn as one vertex batch.
+// Two limits keep a huge burst from blowing the frame: emission is clamped
+// to the pool capacity, and the number drawn shrinks whenever building the
+// batch goes over its time budget.
+class ParticleSystem
+{
+public:
+    static const int CAPACITY = 16384;
+    static const int MIN_DRAWN = 1024;
+
+private:
+    int count;
+    vector<float> posX;
+    vector<float> posY;
+    vector<float> velX;
+    vector<float> velY;
+    vector<float> life;
+    vector<float> lifeStep;
+    vector<Color> colors;
+    vector<Vertex> vertices;
+
+    int drawLimit;
+    float drawBudgetMs;
+    int droppedParticles;
+    unsigned int randomState;
+
+    // Private generator so effects never disturb the game's rand() sequence
+    float nextRandom()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return (randomState & 0xFFFFFF) / 16777216.0f;
+    }
+
+    // Move every particle and age it; no branches so it vectorises
+    void integrate(float gravity)
+    {
+        int i = 0;
+
+#ifdef PINGPONG_SSE
+        __m128 gravityStep = _mm_set1_ps(gravity);
+        for (; i + 4 <= count; i = i + 4)
+        {
+            __m128 vx = _mm_loadu_ps(&velX[i]);
+            __m128 vy = _mm_add_ps(_mm_loadu_ps(&velY[i]), gravityStep);
+            _mm_storeu_ps(&posX[i], _mm_add_ps(_mm_loadu_ps(&posX[i]), vx));
+            _mm_storeu_ps(&posY[i], _mm_add_ps(_mm_loadu_ps(&posY[i]), vy));
+            _mm_storeu_ps(&velY[i], vy);
+            _mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), _mm_loadu_ps(&lifeStep[i])));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            velY[i] = velY[i] + gravity;
+            posX[i] = posX[i] + velX[i];
+            posY[i] = posY[i] + velY[i];
+            life[i] = life[i] - lifeStep[i];
+        }
+    }
+
+    // Remove dead particles by moving the last live one into their slot
+    void compact()
+    {
+        int i = 0;
+        while (i < count)
+        {
+            if (life[i] <= 0)
+            {
+                count = count - 1;
+                posX[i] = posX[count];
+                posY[i] = posY[count];
+                velX[i] = velX[count];
+                velY[i] = velY[count];
+                life[i] = life[count];
+                lifeStep[i] = lifeStep[count];
+                colors[i] = colors[count];
+            }
+            else
+            {
+                i = i + 1;
+            }
+        }
+    }
+
+public:
+    ParticleSystem()
+    {
+        count = 0;
+        posX.resize(CAPACITY);
+        posY.resize(CAPACITY);
+        velX.resize(CAPACITY);
+        velY.resize(CAPACITY);
+        life.resize(CAPACITY);
+        lifeStep.resize(CAPACITY);
+        colors.resize(CAPACITY);
+        vertices.resize(CAPACITY * 6);
+
+        drawLimit = CAPACITY;
+        drawBudgetMs = 2.0f;
+        droppedParticles = 0;
+        randomState = 2463534242u;
+    }
+
+    // Spray a burst from a point; particles that do not fit in the pool are dropped
+    void emit(float x, float y, int amount, float speed, float directionX, Color color, int lifetimeTicks)
+    {
+        int room = CAPACITY - count;
+        if (amount > room)
+        {
+            droppedParticles = droppedParticles + (amount - room);
+            amount = room;
+        }
+
+        for (int n = 0; n < amount; n++)
+        {
+            int i = count + n;
+            float angle = nextRandom() * 6.2831853f;
+            float magnitude = speed * (0.3f + 0.7f * nextRandom());
+
+            posX[i] = x;
+            posY[i] = y;
+            velX[i] = cos(angle) * magnitude + directionX * speed * 0.5f;
+            velY[i] = sin(angle) * magnitude;
+            life[i] = 1.0f;
+            lifeStep[i] = 1.0f / (lifetimeTicks * (0.5f + nextRandom()));
+            colors[i] = color;
+        }
+
+        count = count + amount;
+    }
+
+    // One simulation tick
+    void update()
+    {
+        integrate(0.15f);
+        compact();
+    }
+
+    // Fill the vertex batch with up to drawLimit particles; returns vertices written
+    int buildVertices()
+    {
+        int drawn = count;
+        if (drawn > drawLimit)
+        {
+            drawn = drawLimit;
+        }
+
+        for (int i = 0; i < drawn; i++)
+        {
+            Color color = colors[i];
+            color.a = (Uint8)(255 * life[i]);
+
+            float left = posX[i] - 1.5f;
+            float top = posY[i] - 1.5f;
+            Vertex* quad = &vertices[i * 6];
+            quad[0] = Vertex(Vector2f(left, top), color);
+            quad[1] = Vertex(Vector2f(left + 3, top), color);
+            quad[2] = Vertex(Vector2f(left + 3, top + 3), color);
+            quad[3] = quad[0];
+            quad[4] = quad[2];
+            quad[5] = Vertex(Vector2f(left, top + 3), color);
+        }
+
+        return drawn * 6;
+    }
+
+    // Draw the live particles in one call, adapting how many to draw to stay in budget
+    void draw(RenderWindow& window)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        Clock drawClock;
+        int vertexCount = buildVertices();
+        window.draw(&vertices[0], vertexCount, Triangles);
+
+        float elapsedMs = drawClock.getElapsedTime().asMicroseconds() / 1000.0f;
+        if (elapsedMs > drawBudgetMs)
+        {
+            drawLimit = drawLimit / 2;
+            if (drawLimit < MIN_DRAWN)
+            {
+                drawLimit = MIN_DRAWN;
+            }
+        }
+        else if (elapsedMs < drawBudgetMs / 2 && drawLimit < CAPACITY)
+        {
+            drawLimit = drawLimit + MIN_DRAWN;
+        }
+    }
+
+    void clear()
+    {
+        count = 0;
+    }
+
+    int getCount() const
+    {
+        return count;
+    }
+
+    int getDroppedParticles() const
+    {
+        return droppedParticles;
+    }
+};
+
+
+// Single file holding every game asset, mapped into memory once at startup.
+//
+// Layout (all integers little-endian):
+//   header : "PPAK", version, entry count, reserved          (16 bytes)
+//   toc    : entry count x { name[40], offset, size }         (48 bytes each)
+//   data   : asset bytes, each blob aligned to 16 bytes
+class AssetArchive
+{
+public:
+    static const unsigned int VERSION = 1;
+    static const int NAME_LENGTH = 40;
+    static const int HEADER_SIZE = 16;
+    static const int ENTRY_SIZE = NAME_LENGTH + 8;
+    static const int REQUIRED_COUNT = 4;
+    static const char* const REQUIRED_ASSETS[REQUIRED_COUNT];
+
+private:
+    const unsigned char* data;
+    size_t dataSize;
+    unsigned int entryCount;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+
+    static unsigned int readU32(const unsigned char* p)
+    {
+        return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+               ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+    }
+
+    static void writeU32(ofstream& file, unsigned int value)
+    {
+        char bytes[4];
+        bytes[0] = (char)(value & 0xFF);
+        bytes[1] = (char)((value >> 8) & 0xFF);
+        bytes[2] = (char)((value >> 16) & 0xFF);
+        bytes[3] = (char)((value >> 24) & 0xFF);
+        file.write(bytes, 4);
+    }
+
+    // Check the header and that every table entry lies inside the file
+    bool validate()
+    {
+        if (dataSize < (size_t)HEADER_SIZE || string((const char*)data, 4) != "PPAK")
+        {
+            Logger::error("Asset archive has a bad header");
+            return false;
+        }
+
+        if (readU32(data + 4) != VERSION)
+        {
+            Logger::error("Asset archive version is not supported", LogField("version", (long long)readU32(data + 4)),
+                          LogField("expected", (int)VERSION));
+            return false;
+        }
+
+        entryCount = readU32(data + 8);
+        if ((size_t)HEADER_SIZE + (size_t)entryCount * ENTRY_SIZE > dataSize)
+        {
+            Logger::error("Asset archive table of contents is truncated");
+            return false;
+        }
+
+        for (unsigned int i = 0; i < entryCount; i++)
+        {
+            const unsigned char* entry = data + HEADER_SIZE + i * ENTRY_SIZE;
+            size_t offset = readU32(entry + NAME_LENGTH);
+            size_t size = readU32(entry + NAME_LENGTH + 4);
+            if (offset + size > dataSize)
+            {
+                Logger::error("Asset archive entry points past the end of the file", LogField("entry", (int)i));
+                return false;
+            }
+        }
+
+        for (int i = 0; i < REQUIRED_COUNT; i++)
+        {
+            const void* asset;
+            size_t size;
+            if (find(REQUIRED_ASSETS[i], asset, size) == false)
+            {
+                Logger::error("Asset archive is missing an asset", LogField("asset", REQUIRED_ASSETS[i]));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+public:
+    AssetArchive()
+    {
+        data = nullptr;
+        dataSize = 0;
+        entryCount = 0;
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#endif
+    }
+
+    ~AssetArchive()
+    {
+        close();
+    }
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    // Map the archive read-only; this is the only file opened for assets
+    bool open(const string& path)
+    {
+        close();
+
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+        {
+            Logger::error("Could not open asset archive", LogField("path", path));
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(fileHandle, &fileSize);
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL)
+        {
+            close();
+            return false;
+        }
+
+        data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        dataSize = (size_t)fileSize.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            Logger::error("Could not open asset archive", LogField("path", path));
+            return false;
+        }
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            return false;
+        }
+
+        data = (const unsigned char*)mapped;
+        dataSize = (size_t)fileInfo.st_size;
+#endif
+
+        if (data == nullptr || validate() == false)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+        {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != NULL)
+        {
+            CloseHandle(mappingHandle);
+            mappingHandle = NULL;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data != nullptr)
+        {
+            munmap((void*)data, dataSize);
+        }
+#endif
+        data = nullptr;
+        dataSize = 0;
+        entryCount = 0;
+    }
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    // Look up an asset; the returned pointer stays valid while the archive is open
+    bool find(const string& name, const void*& asset, size_t& size) const
+    {
+        for (unsigned int i = 0; i < entryCount; i++)
+        {
+            const unsigned char* entry = data + HEADER_SIZE + i * ENTRY_SIZE;
+            if (strncmp((const char*)entry, name.c_str(), NAME_LENGTH) == 0)
+            {
+                asset = data + readU32(entry + NAME_LENGTH);
+                size = readU32(entry + NAME_LENGTH + 4);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Build an archive from loose files; refuses to write one missing a required asset
+    static bool pack(const string& path, const vector<string>& names, const vector<string>& files)
+    {
+        for (int i = 0; i < REQUIRED_COUNT; i++)
+        {
+            bool present = false;
+            for (size_t j = 0; j < names.size(); j++)
+            {
+                if (names[j] == REQUIRED_ASSETS[i])
+                {
+                    present = true;
+                }
+            }
+
+            if (present == false)
+            {
+                cout << "Error: " << REQUIRED_ASSETS[i] << " must be packed." << endl;
+                return false;
+            }
+        }
+
+        vector<string> contents;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            ifstream input(files[i].c_str(), ios::binary);
+            if (input.is_open() == false || names[i].length() >= (size_t)NAME_LENGTH)
+            {
+                cout << "Error: Could not pack " << files[i] << endl;
+                return false;
+            }
+
+            string bytes((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+            contents.push_back(bytes);
+        }
+
+        ofstream output(path.c_str(), ios::binary);
+        if (output.is_open() == false)
+        {
+            cout << "Error: Could not write " << path << endl;
+            return false;
+        }
+
+        output.write("PPAK", 4);
+        writeU32(output, VERSION);
+        writeU32(output, (unsigned int)names.size());
+        writeU32(output, 0);
+
+        size_t offset = HEADER_SIZE + names.size() * ENTRY_SIZE;
+        vector<size_t> offsets;
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            offset = (offset + 15) & ~(size_t)15;
+            offsets.push_back(offset);
+
+            char name[NAME_LENGTH] = {};
+            memcpy(name, names[i].c_str(), names[i].length());
+            output.write(name, NAME_LENGTH);
+            writeU32(output, (unsigned int)offset);
+            writeU32(output, (unsigned int)contents[i].size());
+            offset = offset + contents[i].size();
+        }
+
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            while ((size_t)output.tellp() < offsets[i])
+            {
+                output.put(0);
+            }
+            output.write(contents[i].data(), contents[i].size());
+        }
+
+        output.close();
+        cout << "Packed " << names.size() << " assets into " << path << endl;
+        return true;
+    }
+};
+
+const char* const AssetArchive::REQUIRED_ASSETS[AssetArchive::REQUIRED_COUNT] =
+{
+    "font.ttf",
+    "paddle_hit.wav",
+    "wall_hit.wav",
+    "score.wav"
+};
+
+
+class GameText
+{
+private:
+    // A laid-out Text for one string at one size. Reusing these means a
+    // frame that draws the same strings as the last one never allocates.
+    struct CachedText
+    {
+        string source;
+        unsigned int size;
+        Text text;
+        FloatRect bounds;
+        unsigned long lastUsed;
+    };
+
+    // Room for every score up to the multi-ball maximum on top of the interface text
+    static const int CACHE_CAPACITY = 96 + GameConstants::MULTI_BALL_MAX_SCORE + 1;
+
+    Font font;
+    vector<CachedText> cache;
+    unsigned long useCounter;
+    atomic<bool> fontLoaded;
+
+    // Find the cached Text for a string, laying out a new one on a miss
+    CachedText& lookup(const char* str, unsigned int size)
+    {
+        size_t length = strlen(str);
+        size_t oldest = 0;
+        useCounter = useCounter + 1;
+
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            if (cache[i].size == size && cache[i].source.length() == length &&
+                memcmp(cache[i].source.data(), str, length) == 0)
+            {
+                cache[i].lastUsed = useCounter;
+                return cache[i];
+            }
+
+            if (cache[i].lastUsed < cache[oldest].lastUsed)
+            {
+                oldest = i;
+            }
+        }
+
+        CachedText* entry;
+        if (cache.size() < (size_t)CACHE_CAPACITY)
+        {
+            cache.push_back(CachedText());
+            entry = &cache.back();
+        }
+        else
+        {
+            entry = &cache[oldest];
+        }
+
+        entry->source.assign(str, length);
+        entry->size = size;
+        entry->text.setFont(font);
+        entry->text.setString(entry->source);
+        entry->text.setCharacterSize(size);
+        entry->bounds = entry->text.getLocalBounds();
+        entry->lastUsed = useCounter;
+        return *entry;
+    }
+
+public:
+    GameText()
+    {
+        fontLoaded = false;
+        useCounter = 0;
+        cache.reserve(CACHE_CAPACITY);
+    }
+
+    // Load the font straight from the mapped archive (SFML reads it in place)
+    void loadFont(const AssetArchive& archive)
+    {
+        const void* fontData;
+        size_t fontSize;
+
+        if (archive.find("font.ttf", fontData, fontSize) == false)
+        {
+            Logger::warning("Could not load font, text will not display properly");
+            return;
+        }
+
+        bool loadSuccess = font.loadFromMemory(fontData, fontSize);
+
+        if (loadSuccess == false)
+        {
+            Logger::warning("Could not load font, text will not display properly");
+            return;
+        }
+
+        fontLoaded = true;
+    }
+
+    // Lay out a string ahead of time so the first frame that shows it does not allocate
+    void prepare(const char* str, int size)
+    {
+        if (fontLoaded == true)
+        {
+            lookup(str, size);
+        }
+    }
+
+    // Draw text at position
+    void draw(RenderTarget& window, const char* str, int size, float x, float y, Color color = GameConstants::TEXT_COLOR)
+    {
+        if (fontLoaded == false)
+        {
+            return;
+        }
+
+        CachedText& entry = lookup(str, size);
+        entry.text.setFillColor(color);
+        entry.text.setOrigin(0, 0);
+        entry.text.setPosition(x, y);
+        window.draw(entry.text);
+    }
+
+    void draw(RenderTarget& window, const string& str, int size, float x, float y, Color color = GameConstants::TEXT_COLOR)
+    {
+        draw(window, str.c_str(), size, x, y, color);
+    }
+
+    // Draw text centered on a point
+    void drawCenteredAt(RenderTarget& window, const char* str, int size, float x, float y, Color color = GameConstants::TEXT_COLOR)
+    {
+        PROFILE_ZONE("GameText::drawCenteredAt");
+
+        if (fontLoaded == false)
+        {
+            return;
+        }
+
+        CachedText& entry = lookup(str, size);
+        entry.text.setFillColor(color);
+
+        float centerX = entry.bounds.left + entry.bounds.width / 2.0f;
+        float centerY = entry.bounds.top + entry.bounds.height / 2.0f;
+        entry.text.setOrigin(centerX, centerY);
+        entry.text.setPosition(x, y);
+
+        window.draw(entry.text);
+    }
+
+    // Draw centered text
+    void drawCentered(RenderTarget& window, const char* str, int size, float y, Color color = GameConstants::TEXT_COLOR)
+    {
+        drawCenteredAt(window, str, size, GameConstants::WINDOW_WIDTH / 2.0f, y, color);
+    }
+
+    void drawCentered(RenderTarget& window, const string& str, int size, float y, Color color = GameConstants::TEXT_COLOR)
+    {
+        drawCenteredAt(window, str.c_str(), size, GameConstants::WINDOW_WIDTH / 2.0f, y, color);
+    }
+
+    bool isFontLoaded() const
+    {
+        return fontLoaded;
+    }
+
+    const Font& getFont() const
+    {
+        return font;
+    }
+};
+
+// Drawing operations shared by the window and the headless frame exporter
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend()
+    {
+    }
+
+    virtual void clear(Color color) = 0;
+    virtual void fillRect(float x, float y, float width, float height, Color color) = 0;
+    virtual void fillCircle(float centerX, float centerY, float radius, Color color) = 0;
+
+    // Text is positioned like sf::Text: y is the top of the line
+    virtual void drawText(const char* str, int size, float x, float y, Color color) = 0;
+    virtual void drawTextCenteredAt(const char* str, int size, float x, float y, Color color) = 0;
+};
+
+// The existing SFML path: shapes and cached text drawn into a render target
+class SfmlRenderBackend : public RenderBackend
+{
+private:
+    RenderTarget& target;
+    GameText& text;
+    RectangleShape rect;
+    CircleShape circle;
+
+public:
+    SfmlRenderBackend(RenderTarget& renderTarget, GameText& textRenderer) : target(renderTarget), text(textRenderer)
+    {
+    }
+
+    void clear(Color color) override
+    {
+        target.clear(color);
+    }
+
+    void fillRect(float x, float y, float width, float height, Color color) override
+    {
+        rect.setPosition(x, y);
+        rect.setSize(Vector2f(width, height));
+        rect.setFillColor(color);
+        target.draw(rect);
+    }
+
+    void fillCircle(float centerX, float centerY, float radius, Color color) override
+    {
+        circle.setRadius(radius);
+        circle.setPosition(centerX - radius, centerY - radius);
+        circle.setFillColor(color);
+        target.draw(circle);
+    }
+
+    void drawText(const char* str, int size, float x, float y, Color color) override
+    {
+        text.draw(target, str, size, x, y, color);
+    }
+
+    void drawTextCenteredAt(const char* str, int size, float x, float y, Color color) override
+    {
+        text.drawCenteredAt(target, str, size, x, y, color);
+    }
+};
+
+// Printable ASCII glyphs of the game font laid out once at one size, so text of
+// any size can be drawn as textured quads from the font's single glyph texture
+class GlyphCache
+{
+public:
+    static const int GLYPH_SIZE = 80;
+
+    struct CachedGlyph
+    {
+        FloatRect bounds;
+        FloatRect textureRect;
+        float advance;
+    };
+
+private:
+    const Font* font;
+    CachedGlyph glyphs[128];
+
+public:
+    GlyphCache()
+    {
+        font = nullptr;
+    }
+
+    // Rasterise every glyph up front; the texture then never grows mid-frame
+    void load(const Font& gameFont)
+    {
+        font = &gameFont;
+        for (int c = 32; c < 127; c++)
+        {
+            const Glyph& glyph = font->getGlyph(c, GLYPH_SIZE, false);
+            glyphs[c].bounds = glyph.bounds;
+            glyphs[c].textureRect = FloatRect((float)glyph.textureRect.left, (float)glyph.textureRect.top,
+                                              (float)glyph.textureRect.width, (float)glyph.textureRect.height);
+            glyphs[c].advance = glyph.advance;
+        }
+    }
+
+    bool isLoaded() const
+    {
+        return font != nullptr;
+    }
+
+    const Texture& getTexture() const
+    {
+        return font->getTexture(GLYPH_SIZE);
+    }
+
+    // Characters outside printable ASCII are drawn as spaces
+    const CachedGlyph& get(char c) const
+    {
+        if (c < 32 || c > 126)
+        {
+            c = ' ';
+        }
+        return glyphs[(int)c];
+    }
+};
+
+// Collects everything drawn into two vertex batches, shapes and text, placed
+// on one board of a grid by an offset and a scale. However many boards are
+// drawn, flushing the batches is two draw calls.
+class BatchRenderBackend : public RenderBackend
+{
+private:
+    const GlyphCache& glyphs;
+    VertexArray shapes;
+    VertexArray text;
+    float offsetX;
+    float offsetY;
+    float scale;
+
+    static const int CIRCLE_SEGMENTS = 24;
+    float circleX[CIRCLE_SEGMENTS + 1];
+    float circleY[CIRCLE_SEGMENTS + 1];
+
+    Vector2f place(float x, float y) const
+    {
+        return Vector2f(offsetX + x * scale, offsetY + y * scale);
+    }
+
+    void appendQuad(VertexArray& batch, FloatRect area, FloatRect texture, Color color)
+    {
+        Vector2f topLeft = place(area.left, area.top);
+        Vector2f bottomRight = place(area.left + area.width, area.top + area.height);
+        Vector2f topRight(bottomRight.x, topLeft.y);
+        Vector2f bottomLeft(topLeft.x, bottomRight.y);
+        float right = texture.left + texture.width;
+        float bottom = texture.top + texture.height;
+
+        batch.append(Vertex(topLeft, color, Vector2f(texture.left, texture.top)));
+        batch.append(Vertex(topRight, color, Vector2f(right, texture.top)));
+        batch.append(Vertex(bottomRight, color, Vector2f(right, bottom)));
+        batch.append(Vertex(topLeft, color, Vector2f(texture.left, texture.top)));
+        batch.append(Vertex(bottomRight, color, Vector2f(right, bottom)));
+        batch.append(Vertex(bottomLeft, color, Vector2f(texture.left, bottom)));
+    }
+
+    // Bounds of a string laid out like sf::Text at the given size, relative to its origin
+    FloatRect measure(const char* str, float size) const
+    {
+        float factor = size / GlyphCache::GLYPH_SIZE;
+        float x = 0;
+        float left = 0;
+        float top = 0;
+        float right = 0;
+        float bottom = 0;
+        bool first = true;
+        for (const char* c = str; *c != 0; c++)
+        {
+            const GlyphCache::CachedGlyph& glyph = glyphs.get(*c);
+            if (glyph.bounds.width > 0)
+            {
+                float glyphLeft = x + glyph.bounds.left * factor;
+                float glyphTop = size + glyph.bounds.top * factor;
+                float glyphRight = glyphLeft + glyph.bounds.width * factor;
+                float glyphBottom = glyphTop + glyph.bounds.height * factor;
+                if (first == true)
+                {
+                    left = glyphLeft;
+                    top = glyphTop;
+                    right = glyphRight;
+                    bottom = glyphBottom;
+                    first = false;
+                }
+                left = min(left, glyphLeft);
+                top = min(top, glyphTop);
+                right = max(right, glyphRight);
+                bottom = max(bottom, glyphBottom);
+            }
+            x = x + glyph.advance * factor;
+        }
+        return FloatRect(left, top, right - left, bottom - top);
+    }
+
+public:
+    BatchRenderBackend(const GlyphCache& glyphCache) : glyphs(glyphCache)
+    {
+        shapes.setPrimitiveType(Triangles);
+        text.setPrimitiveType(Triangles);
+        offsetX = 0;
+        offsetY = 0;
+        scale = 1;
+
+        for (int s = 0; s <= CIRCLE_SEGMENTS; s++)
+        {
+            circleX[s] = cos(s * 6.2831853f / CIRCLE_SEGMENTS);
+            circleY[s] = sin(s * 6.2831853f / CIRCLE_SEGMENTS);
+        }
+    }
+
+    // Start a new frame; the batches keep their capacity
+    void begin()
+    {
+        shapes.clear();
+        text.clear();
+    }
+
+    // Where the next board goes, in window pixels; the board itself is window-sized
+    void setBoard(float x, float y, float boardScale)
+    {
+        offsetX = x;
+        offsetY = y;
+        scale = boardScale;
+    }
+
+    void flush(RenderTarget& target)
+    {
+        target.draw(shapes);
+        if (glyphs.isLoaded() == true && text.getVertexCount() > 0)
+        {
+            RenderStates states;
+            states.texture = &glyphs.getTexture();
+            target.draw(text, states);
+        }
+    }
+
+    int getVertexCount() const
+    {
+        return (int)(shapes.getVertexCount() + text.getVertexCount());
+    }
+
+    // Clears only the current board
+    void clear(Color color) override
+    {
+        fillRect(0, 0, GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT, color);
+    }
+
+    void fillRect(float x, float y, float width, float height, Color color) override
+    {
+        appendQuad(shapes, FloatRect(x, y, width, height), FloatRect(0, 0, 0, 0), color);
+    }
+
+    void fillCircle(float centerX, float centerY, float radius, Color color) override
+    {
+        Vector2f center = place(centerX, centerY);
+        float r = radius * scale;
+        for (int s = 0; s < CIRCLE_SEGMENTS; s++)
+        {
+            shapes.append(Vertex(center, color));
+            shapes.append(Vertex(Vector2f(center.x + circleX[s] * r, center.y + circleY[s] * r), color));
+            shapes.append(Vertex(Vector2f(center.x + circleX[s + 1] * r, center.y + circleY[s + 1] * r), color));
+        }
+    }
+
+    void drawText(const char* str, int size, float x, float y, Color color) override
+    {
+        if (glyphs.isLoaded() == false)
+        {
+            return;
+        }
+
+        float factor = (float)size / GlyphCache::GLYPH_SIZE;
+        float penX = x;
+        for (const char* c = str; *c != 0; c++)
+        {
+            const GlyphCache::CachedGlyph& glyph = glyphs.get(*c);
+            if (glyph.bounds.width > 0)
+            {
+                FloatRect area(penX + glyph.bounds.left * factor, y + size + glyph.bounds.top * factor,
+                               glyph.bounds.width * factor, glyph.bounds.height * factor);
+                appendQuad(text, area, glyph.textureRect, color);
+            }
+            penX = penX + glyph.advance * factor;
+        }
+    }
+
+    void drawTextCenteredAt(const char* str, int size, float x, float y, Color color) override
+    {
+        if (glyphs.isLoaded() == false)
+        {
+            return;
+        }
+
+        FloatRect bounds = measure(str, (float)size);
+        drawText(str, size, x - (bounds.left + bounds.width / 2), y - (bounds.top + bounds.height / 2), color);
+    }
+};
+
+// Reads TrueType outlines straight from the font file and rasterises them
+// into coverage masks, so text can be drawn without an OpenGL context.
+// Only printable ASCII is rasterised; each size is built once, on first use.
+class SoftwareFont
+{
+public:
+    struct Glyph
+    {
+        int left;
+        int top;
+        int width;
+        int height;
+        float advance;
+        vector<unsigned char> coverage;
+    };
+
+    static const int FIRST_CHAR = 32;
+    static const int CHAR_COUNT = 95;
+
+    struct GlyphSet
+    {
+        int size;
+        Glyph glyphs[CHAR_COUNT];
+
+        const Glyph& get(char c) const
+        {
+            int index = (unsigned char)c - FIRST_CHAR;
+            if (index < 0 || index >= CHAR_COUNT)
+            {
+                index = '?' - FIRST_CHAR;
+            }
+            return glyphs[index];
+        }
+    };
+
+private:
+    struct Edge
+    {
+        float x0;
+        float y0;
+        float x1;
+        float y1;
+    };
+
+    struct Crossing
+    {
+        float x;
+        int winding;
+    };
+
+    static const int SUBSAMPLES = 4;
+    static const int CURVE_SEGMENTS = 8;
+
+    const unsigned char* data;
+    size_t dataSize;
+    uint32_t glyfOffset;
+    uint32_t locaOffset;
+    uint32_t hmtxOffset;
+    uint32_t cmapOffset;
+    int unitsPerEm;
+    int indexToLocFormat;
+    int numberOfHMetrics;
+
+    list<GlyphSet> sets;
+    mutex setsMutex;
+
+    static uint16_t readU16(const unsigned char* p)
+    {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    static int16_t readS16(const unsigned char* p)
+    {
+        return (int16_t)readU16(p);
+    }
+
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    // Offset of a table, or 0 if the font does not have it
+    uint32_t findTable(const char* tag) const
+    {
+        int numTables = readU16(data + 4);
+        for (int i = 0; i < numTables; i++)
+        {
+            const unsigned char* record = data + 12 + i * 16;
+            if (12 + (size_t)(i + 1) * 16 > dataSize)
+            {
+                return 0;
+            }
+
+            if (memcmp(record, tag, 4) == 0)
+            {
+                uint32_t offset = readU32(record + 8);
+                uint32_t length = readU32(record + 12);
+                if ((size_t)offset + length > dataSize)
+                {
+                    return 0;
+                }
+                return offset;
+            }
+        }
+        return 0;
+    }
+
+    // Character to glyph index through a format 4 cmap subtable
+    int findGlyphIndex(int codepoint) const
+    {
+        const unsigned char* table = data + cmapOffset;
+        int segCountX2 = readU16(table + 6);
+        const unsigned char* endCodes = table + 14;
+        const unsigned char* startCodes = endCodes + segCountX2 + 2;
+        const unsigned char* idDeltas = startCodes + segCountX2;
+        const unsigned char* idRangeOffsets = idDeltas + segCountX2;
+
+        for (int i = 0; i < segCountX2 / 2; i++)
+        {
+            if (codepoint > readU16(endCodes + i * 2))
+            {
+                continue;
+            }
+
+            int start = readU16(startCodes + i * 2);
+            if (codepoint < start)
+            {
+                return 0;
+            }
+
+            int delta = readU16(idDeltas + i * 2);
+            int rangeOffset = readU16(idRangeOffsets + i * 2);
+            if (rangeOffset == 0)
+            {
+                return (codepoint + delta) & 0xFFFF;
+            }
+
+            int glyph = readU16(idRangeOffsets + i * 2 + rangeOffset + (codepoint - start) * 2);
+            if (glyph == 0)
+            {
+                return 0;
+            }
+            return (glyph + delta) & 0xFFFF;
+        }
+        return 0;
+    }
+
+    float getAdvance(int glyphIndex) const
+    {
+        if (glyphIndex >= numberOfHMetrics)
+        {
+            glyphIndex = numberOfHMetrics - 1;
+        }
+        return readU16(data + hmtxOffset + glyphIndex * 4);
+    }
+
+    static void addLine(vector<Edge>& edges, float x0, float y0, float x1, float y1)
+    {
+        Edge edge = { x0, y0, x1, y1 };
+        edges.push_back(edge);
+    }
+
+    static void addCurve(vector<Edge>& edges, float x0, float y0, float cx, float cy, float x1, float y1)
+    {
+        float lastX = x0;
+        float lastY = y0;
+        for (int i = 1; i <= CURVE_SEGMENTS; i++)
+        {
+            float t = i / (float)CURVE_SEGMENTS;
+            float u = 1 - t;
+            float x = u * u * x0 + 2 * u * t * cx + t * t * x1;
+            float y = u * u * y0 + 2 * u * t * cy + t * t * y1;
+            addLine(edges, lastX, lastY, x, y);
+            lastX = x;
+            lastY = y;
+        }
+    }
+
+    // Append a glyph's outline as line segments in pixel space (y down)
+    void appendOutline(int glyphIndex, float scale, float offsetX, float offsetY, vector<Edge>& edges, int depth) const
+    {
+        uint32_t start;
+        uint32_t end;
+        if (indexToLocFormat == 0)
+        {
+            start = readU16(data + locaOffset + glyphIndex * 2) * 2;
+            end = readU16(data + locaOffset + glyphIndex * 2 + 2) * 2;
+        }
+        else
+        {
+            start = readU32(data + locaOffset + glyphIndex * 4);
+            end = readU32(data + locaOffset + glyphIndex * 4 + 4);
+        }
+
+        if (end <= start || glyfOffset + (size_t)end > dataSize)
+        {
+            return;
+        }
+
+        const unsigned char* glyph = data + glyfOffset + start;
+        int contourCount = readS16(glyph);
+
+        if (contourCount < 0)
+        {
+            // Composite glyph: place each component at its offset (scaled components are drawn unscaled)
+            if (depth > 4)
+            {
+                return;
+            }
+
+            const unsigned char* p = glyph + 10;
+            int flags;
+            do
+            {
+                flags = readU16(p);
+                int component = readU16(p + 2);
+                p = p + 4;
+
+                int argument1;
+                int argument2;
+                if ((flags & 1) != 0)
+                {
+                    argument1 = readS16(p);
+                    argument2 = readS16(p + 2);
+                    p = p + 4;
+                }
+                else
+                {
+                    argument1 = (signed char)p[0];
+                    argument2 = (signed char)p[1];
+                    p = p + 2;
+                }
+
+                if ((flags & 8) != 0)
+                {
+                    p = p + 2;
+                }
+                else if ((flags & 0x40) != 0)
+                {
+                    p = p + 4;
+                }
+                else if ((flags & 0x80) != 0)
+                {
+                    p = p + 8;
+                }
+
+                if ((flags & 2) != 0)
+                {
+                    appendOutline(component, scale, offsetX + argument1 * scale, offsetY - argument2 * scale, edges, depth + 1);
+                }
+            } while ((flags & 0x20) != 0);
+            return;
+        }
+
+        if (contourCount == 0)
+        {
+            return;
+        }
+
+        const unsigned char* endPoints = glyph + 10;
+        int pointCount = readU16(endPoints + (contourCount - 1) * 2) + 1;
+
+        int instructionLength = readU16(endPoints + contourCount * 2);
+        const unsigned char* p = endPoints + contourCount * 2 + 2 + instructionLength;
+
+        vector<unsigned char> flags(pointCount);
+        for (int i = 0; i < pointCount; i++)
+        {
+            unsigned char flag = *p++;
+            flags[i] = flag;
+            if ((flag & 8) != 0)
+            {
+                int repeat = *p++;
+                for (int r = 0; r < repeat && i + 1 < pointCount; r++)
+                {
+                    i = i + 1;
+                    flags[i] = flag;
+                }
+            }
+        }
+
+        vector<float> xs(pointCount);
+        vector<float> ys(pointCount);
+        int value = 0;
+        for (int i = 0; i < pointCount; i++)
+        {
+            if ((flags[i] & 2) != 0)
+            {
+                value = value + (((flags[i] & 16) != 0) ? *p : -*p);
+                p = p + 1;
+            }
+            else if ((flags[i] & 16) == 0)
+            {
+                value = value + readS16(p);
+                p = p + 2;
+            }
+            xs[i] = offsetX + value * scale;
+        }
+
+        value = 0;
+        for (int i = 0; i < pointCount; i++)
+        {
+            if ((flags[i] & 4) != 0)
+            {
+                value = value + (((flags[i] & 32) != 0) ? *p : -*p);
+                p = p + 1;
+            }
+            else if ((flags[i] & 32) == 0)
+            {
+                value = value + readS16(p);
+                p = p + 2;
+            }
+            ys[i] = offsetY - value * scale;
+        }
+
+        // Walk each contour; consecutive off-curve points imply an on-curve midpoint
+        int first = 0;
+        for (int c = 0; c < contourCount; c++)
+        {
+            int last = readU16(endPoints + c * 2);
+            if (last >= pointCount || last < first)
+            {
+                return;
+            }
+
+            float startX;
+            float startY;
+            int from = first;
+            int to = last;
+            if ((flags[first] & 1) != 0)
+            {
+                startX = xs[first];
+                startY = ys[first];
+                from = first + 1;
+            }
+            else if ((flags[last] & 1) != 0)
+            {
+                startX = xs[last];
+                startY = ys[last];
+                to = last - 1;
+            }
+            else
+            {
+                startX = (xs[first] + xs[last]) / 2;
+                startY = (ys[first] + ys[last]) / 2;
+            }
+
+            float currentX = startX;
+            float currentY = startY;
+            float controlX = 0;
+            float controlY = 0;
+            bool hasControl = false;
+
+            for (int i = from; i <= to; i++)
+            {
+                if ((flags[i] & 1) != 0)
+                {
+                    if (hasControl == true)
+                    {
+                        addCurve(edges, currentX, currentY, controlX, controlY, xs[i], ys[i]);
+                        hasControl = false;
+                    }
+                    else
+                    {
+                        addLine(edges, currentX, currentY, xs[i], ys[i]);
+                    }
+                    currentX = xs[i];
+                    currentY = ys[i];
+                }
+                else
+                {
+                    if (hasControl == true)
+                    {
+                        float middleX = (controlX + xs[i]) / 2;
+                        float middleY = (controlY + ys[i]) / 2;
+                        addCurve(edges, currentX, currentY, controlX, controlY, middleX, middleY);
+                        currentX = middleX;
+                        currentY = middleY;
+                    }
+                    controlX = xs[i];
+                    controlY = ys[i];
+                    hasControl = true;
+                }
+            }
+
+            if (hasControl == true)
+            {
+                addCurve(edges, currentX, currentY, controlX, controlY, startX, startY);
+            }
+            else
+            {
+                addLine(edges, currentX, currentY, startX, startY);
+            }
+
+            first = last + 1;
+        }
+    }
+
+    // Non-zero winding fill with SUBSAMPLES scanlines per pixel row and exact horizontal coverage
+    static void rasterize(const vector<Edge>& edges, Glyph& glyph)
+    {
+        glyph.left = 0;
+        glyph.top = 0;
+        glyph.width = 0;
+        glyph.height = 0;
+        if (edges.empty() == true)
+        {
+            return;
+        }
+
+        float minX = edges[0].x0;
+        float maxX = edges[0].x0;
+        float minY = edges[0].y0;
+        float maxY = edges[0].y0;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            minX = min(minX, min(edges[i].x0, edges[i].x1));
+            maxX = max(maxX, max(edges[i].x0, edges[i].x1));
+            minY = min(minY, min(edges[i].y0, edges[i].y1));
+            maxY = max(maxY, max(edges[i].y0, edges[i].y1));
+        }
+
+        glyph.left = (int)floor(minX);
+        glyph.top = (int)floor(minY);
+        glyph.width = (int)ceil(maxX) - glyph.left + 1;
+        glyph.height = (int)ceil(maxY) - glyph.top + 1;
+        glyph.coverage.assign(glyph.width * glyph.height, 0);
+
+        vector<float> row(glyph.width + 1);
+        vector<Crossing> crossings;
+        const float weight = 1.0f / SUBSAMPLES;
+
+        for (int y = 0; y < glyph.height; y++)
+        {
+            fill(row.begin(), row.end(), 0.0f);
+
+            for (int s = 0; s < SUBSAMPLES; s++)
+            {
+                float scanY = glyph.top + y + (s + 0.5f) * weight;
+
+                crossings.clear();
+                for (size_t i = 0; i < edges.size(); i++)
+                {
+                    const Edge& edge = edges[i];
+                    if (edge.y0 == edge.y1)
+                    {
+                        continue;
+                    }
+
+                    float low = min(edge.y0, edge.y1);
+                    float high = max(edge.y0, edge.y1);
+                    if (scanY < low || scanY >= high)
+                    {
+                        continue;
+                    }
+
+                    Crossing crossing;
+                    crossing.x = edge.x0 + (scanY - edge.y0) * (edge.x1 - edge.x0) / (edge.y1 - edge.y0) - glyph.left;
+                    crossing.winding = (edge.y1 > edge.y0) ? 1 : -1;
+                    crossings.push_back(crossing);
+                }
+
+                // A handful of crossings per scanline, so insertion sort
+                for (size_t i = 1; i < crossings.size(); i++)
+                {
+                    Crossing current = crossings[i];
+                    size_t j = i;
+                    while (j > 0 && crossings[j - 1].x > current.x)
+                    {
+                        crossings[j] = crossings[j - 1];
+                        j = j - 1;
+                    }
+                    crossings[j] = current;
+                }
+
+                int winding = 0;
+                for (size_t i = 0; i + 1 < crossings.size(); i++)
+                {
+                    winding = winding + crossings[i].winding;
+                    if (winding == 0)
+                    {
+                        continue;
+                    }
+
+                    float spanStart = max(0.0f, crossings[i].x);
+                    float spanEnd = min((float)glyph.width, crossings[i + 1].x);
+                    if (spanEnd <= spanStart)
+                    {
+                        continue;
+                    }
+
+                    int startPixel = (int)spanStart;
+                    int endPixel = (int)spanEnd;
+                    if (startPixel == endPixel)
+                    {
+                        row[startPixel] += (spanEnd - spanStart) * weight;
+                        continue;
+                    }
+
+                    row[startPixel] += (startPixel + 1 - spanStart) * weight;
+                    for (int x = startPixel + 1; x < endPixel; x++)
+                    {
+                        row[x] += weight;
+                    }
+                    row[endPixel] += (spanEnd - endPixel) * weight;
+                }
+            }
+
+            for (int x = 0; x < glyph.width; x++)
+            {
+                float coverage = min(1.0f, row[x]);
+                glyph.coverage[y * glyph.width + x] = (unsigned char)(coverage * 255 + 0.5f);
+            }
+        }
+    }
+
+public:
+    SoftwareFont()
+    {
+        data = nullptr;
+        dataSize = 0;
+    }
+
+    // The font data must stay valid (mapped) for as long as the font is used
+    bool load(const void* fontData, size_t size)
+    {
+        data = (const unsigned char*)fontData;
+        dataSize = size;
+        if (size < 12)
+        {
+            return false;
+        }
+
+        uint32_t head = findTable("head");
+        uint32_t hhea = findTable("hhea");
+        uint32_t cmap = findTable("cmap");
+        glyfOffset = findTable("glyf");
+        locaOffset = findTable("loca");
+        hmtxOffset = findTable("hmtx");
+        if (head == 0 || hhea == 0 || cmap == 0 || glyfOffset == 0 || locaOffset == 0 || hmtxOffset == 0)
+        {
+            return false;
+        }
+
+        unitsPerEm = readU16(data + head + 18);
+        indexToLocFormat = readS16(data + head + 50);
+        numberOfHMetrics = readU16(data + hhea + 34);
+
+        // Prefer the Windows Unicode BMP subtable, then any Unicode one
+        cmapOffset = 0;
+        int subtableCount = readU16(data + cmap + 2);
+        for (int i = 0; i < subtableCount; i++)
+        {
+            const unsigned char* record = data + cmap + 4 + i * 8;
+            int platform = readU16(record);
+            int encoding = readU16(record + 2);
+            uint32_t offset = cmap + readU32(record + 4);
+            if (offset + 14 > dataSize || readU16(data + offset) != 4)
+            {
+                continue;
+            }
+
+            if ((platform == 3 && encoding == 1) || (platform == 0 && cmapOffset == 0))
+            {
+                cmapOffset = offset;
+            }
+        }
+
+        return cmapOffset != 0 && unitsPerEm > 0 && numberOfHMetrics > 0;
+    }
+
+    // Glyphs for one pixel size; size is the em height, as with sf::Text
+    const GlyphSet& getGlyphSet(int size)
+    {
+        lock_guard<mutex> lock(setsMutex);
+
+        for (list<GlyphSet>::iterator it = sets.begin(); it != sets.end(); ++it)
+        {
+            if (it->size == size)
+            {
+                return *it;
+            }
+        }
+
+        sets.push_back(GlyphSet());
+        GlyphSet& set = sets.back();
+        set.size = size;
+
+        float scale = size / (float)unitsPerEm;
+        vector<Edge> edges;
+        for (int i = 0; i < CHAR_COUNT; i++)
+        {
+            int glyphIndex = findGlyphIndex(FIRST_CHAR + i);
+            edges.clear();
+            appendOutline(glyphIndex, scale, 0, 0, edges, 0);
+            rasterize(edges, set.glyphs[i]);
+            set.glyphs[i].advance = getAdvance(glyphIndex) * scale;
+        }
+
+        return set;
+    }
+};
+
+// Renders into an RGBA framebuffer in memory. Fills use SSE2 four pixels at
+// a time; one backend per thread lets frames be rendered in parallel.
+class SoftwareRenderBackend : public RenderBackend
+{
+private:
+    int width;
+    int height;
+    vector<uint32_t> pixels;
+    SoftwareFont& font;
+
+    // sf::Color is laid out r, g, b, a, which is also sf::Image's byte order
+    static uint32_t toPixel(Color color)
+    {
+        uint32_t pixel;
+        memcpy(&pixel, &color, sizeof(pixel));
+        return pixel;
+    }
+
+    static void blendPixel(uint32_t& destination, Color color, int alpha)
+    {
+        unsigned char* d = (unsigned char*)&destination;
+        int weight = alpha + (alpha >> 7);
+        d[0] = (unsigned char)((color.r * weight + d[0] * (256 - weight)) >> 8);
+        d[1] = (unsigned char)((color.g * weight + d[1] * (256 - weight)) >> 8);
+        d[2] = (unsigned char)((color.b * weight + d[2] * (256 - weight)) >> 8);
+        d[3] = 255;
+    }
+
+    void fillSpan(uint32_t* row, int x0, int x1, Color color)
+    {
+        if (color.a == 0)
+        {
+            return;
+        }
+
+        int x = x0;
+        if (color.a == 255)
+        {
+            uint32_t pixel = toPixel(color);
+#ifdef PINGPONG_SSE
+            __m128i packed = _mm_set1_epi32((int)pixel);
+            for (; x + 4 <= x1; x = x + 4)
+            {
+                _mm_storeu_si128((__m128i*)(row + x), packed);
+            }
+#endif
+            for (; x < x1; x++)
+            {
+                row[x] = pixel;
+            }
+            return;
+        }
+
+#ifdef PINGPONG_SSE
+        // (source * w + destination * (256 - w)) >> 8 on 16-bit lanes, two pixels per half
+        int weight = color.a + (color.a >> 7);
+        __m128i zero = _mm_setzero_si128();
+        __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)toPixel(color)), zero);
+        __m128i sourceWeighted = _mm_mullo_epi16(source, _mm_set1_epi16((short)weight));
+        __m128i inverse = _mm_set1_epi16((short)(256 - weight));
+        __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+        for (; x + 4 <= x1; x = x + 4)
+        {
+            __m128i destination = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i low = _mm_unpacklo_epi8(destination, zero);
+            __m128i high = _mm_unpackhi_epi8(destination, zero);
+            low = _mm_srli_epi16(_mm_add_epi16(sourceWeighted, _mm_mullo_epi16(low, inverse)), 8);
+            high = _mm_srli_epi16(_mm_add_epi16(sourceWeighted, _mm_mullo_epi16(high, inverse)), 8);
+            _mm_storeu_si128((__m128i*)(row + x), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+        }
+#endif
+        for (; x < x1; x++)
+        {
+            blendPixel(row[x], color, color.a);
+        }
+    }
+
+    // Measure like sf::Text::getLocalBounds, relative to the text's position
+    void measure(const char* str, const SoftwareFont::GlyphSet& set, float& left, float& top, float& right, float& bottom)
+    {
+        float penX = 0;
+        float baseline = (float)set.size;
+        bool any = false;
+        left = 0;
+        top = 0;
+        right = 0;
+        bottom = 0;
+
+        for (const char* c = str; *c != '\0'; c++)
+        {
+            const SoftwareFont::Glyph& glyph = set.get(*c);
+            if (glyph.width > 0)
+            {
+                float glyphLeft = penX + glyph.left;
+                float glyphTop = baseline + glyph.top;
+                if (any == false)
+                {
+                    left = glyphLeft;
+                    top = glyphTop;
+                    right = glyphLeft + glyph.width;
+                    bottom = glyphTop + glyph.height;
+                    any = true;
+                }
+                left = min(left, glyphLeft);
+                top = min(top, glyphTop);
+                right = max(right, glyphLeft + glyph.width);
+                bottom = max(bottom, glyphTop + glyph.height);
+            }
+            penX = penX + glyph.advance;
+        }
+    }
+
+public:
+    SoftwareRenderBackend(int frameWidth, int frameHeight, SoftwareFont& softwareFont) : font(softwareFont)
+    {
+        width = frameWidth;
+        height = frameHeight;
+        pixels.resize(width * height);
+    }
+
+    void clear(Color color) override
+    {
+        fillSpan(pixels.data(), 0, width * height, Color(color.r, color.g, color.b, 255));
+    }
+
+    void fillRect(float x, float y, float rectWidth, float rectHeight, Color color) override
+    {
+        int x0 = max(0, (int)floor(x + 0.5f));
+        int x1 = min(width, (int)floor(x + rectWidth + 0.5f));
+        int y0 = max(0, (int)floor(y + 0.5f));
+        int y1 = min(height, (int)floor(y + rectHeight + 0.5f));
+
+        for (int row = y0; row < y1; row++)
+        {
+            fillSpan(pixels.data() + row * width, x0, x1, color);
+        }
+    }
+
+    void fillCircle(float centerX, float centerY, float radius, Color color) override
+    {
+        int y0 = max(0, (int)floor(centerY - radius));
+        int y1 = min(height, (int)ceil(centerY + radius));
+
+        for (int row = y0; row < y1; row++)
+        {
+            float dy = row + 0.5f - centerY;
+            if (dy * dy >= radius * radius)
+            {
+                continue;
+            }
+
+            float halfWidth = sqrt(radius * radius - dy * dy);
+            int x0 = max(0, (int)floor(centerX - halfWidth + 0.5f));
+            int x1 = min(width, (int)floor(centerX + halfWidth + 0.5f));
+            fillSpan(pixels.data() + row * width, x0, x1, color);
+        }
+    }
+
+    void drawText(const char* str, int size, float x, float y, Color color) override
+    {
+        const SoftwareFont::GlyphSet& set = font.getGlyphSet(size);
+        float penX = x;
+        int baseline = (int)floor(y + size + 0.5f);
+
+        for (const char* c = str; *c != '\0'; c++)
+        {
+            const SoftwareFont::Glyph& glyph = set.get(*c);
+            int originX = (int)floor(penX + 0.5f) + glyph.left;
+            int originY = baseline + glyph.top;
+
+            for (int gy = 0; gy < glyph.height; gy++)
+            {
+                int row = originY + gy;
+                if (row < 0 || row >= height)
+                {
+                    continue;
+                }
+
+                uint32_t* destination = pixels.data() + row * width;
+                const unsigned char* coverage = glyph.coverage.data() + gy * glyph.width;
+                for (int gx = 0; gx < glyph.width; gx++)
+                {
+                    int column = originX + gx;
+                    if (coverage[gx] == 0 || column < 0 || column >= width)
+                    {
+                        continue;
+                    }
+                    blendPixel(destination[column], color, coverage[gx] * color.a / 255);
+                }
+            }
+
+            penX = penX + glyph.advance;
+        }
+    }
+
+    void drawTextCenteredAt(const char* str, int size, float x, float y, Color color) override
+    {
+        float left;
+        float top;
+        float right;
+        float bottom;
+        measure(str, font.getGlyphSet(size), left, top, right, bottom);
+        drawText(str, size, x - (left + right) / 2.0f, y - (top + bottom) / 2.0f, color);
+    }
+
+    const Uint8* getPixels() const
+    {
+        return (const Uint8*)pixels.data();
+    }
+
+    int getWidth() const
+    {
+        return width;
+    }
+
+    int getHeight() const
+    {
+        return height;
+    }
+};
+
+// The parts of the match screen both backends draw
+class MatchFrame
+{
+public:
+    static void drawCenterLine(RenderBackend& backend)
+    {
+        float centerX = GameConstants::WINDOW_WIDTH / 2;
+        backend.fillRect(centerX, 0, 2, GameConstants::WINDOW_HEIGHT, GameConstants::LINE_COLOR);
+
+        for (int i = 0; i < GameConstants::WINDOW_HEIGHT; i = i + 40)
+        {
+            backend.fillRect(centerX, i, 2, 20, Color::White);
+        }
+    }
+
+    // Paddles and ball of a classic match, scaled from court to window coordinates.
+    // The window draws these through the component store instead.
+    static void drawCourt(RenderBackend& backend, const RuleSet& ruleSet, const MatchState& state)
+    {
+        float scaleX = GameConstants::WINDOW_WIDTH / ruleSet.courtWidth;
+        float scaleY = GameConstants::WINDOW_HEIGHT / ruleSet.courtHeight;
+        float outline = 2;
+
+        float paddleY[2] = { state.paddle1Y, state.paddle2Y };
+        Color paddleColor[2] = { GameConstants::PLAYER1_COLOR, GameConstants::PLAYER2_COLOR };
+        for (int p = 0; p < 2; p++)
+        {
+            float x = MatchSimulation<DynamicRules>::getPaddleX(p + 1, ruleSet.values) * scaleX;
+            float y = paddleY[p] * scaleY;
+            float w = ruleSet.paddleWidth * scaleX;
+            float h = ruleSet.paddleHeight * scaleY;
+            backend.fillRect(x - outline, y - outline, w + outline * 2, h + outline * 2, Color::White);
+            backend.fillRect(x, y, w, h, paddleColor[p]);
+        }
+
+        float radius = ruleSet.ballSize / 2 * scaleX;
+        float ballX = (state.ballX + ruleSet.ballSize / 2) * scaleX;
+        float ballY = (state.ballY + ruleSet.ballSize / 2) * scaleY;
+        backend.fillCircle(ballX, ballY, radius + outline, Color::White);
+        backend.fillCircle(ballX, ballY, radius, GameConstants::BALL_COLOR);
+    }
+
+    // Each side of the score is its own string, so a goal only swaps digits
+    static void drawScoreboard(RenderBackend& backend, int score1, int score2, const string& leftName, const string& rightName)
+    {
+        char scoreText[16];
+        float centerX = GameConstants::WINDOW_WIDTH / 2.0f;
+
+        backend.drawTextCenteredAt(":", 80, centerX, 30, GameConstants::TEXT_COLOR);
+        snprintf(scoreText, sizeof(scoreText), "%d", score1);
+        backend.drawTextCenteredAt(scoreText, 80, centerX - 90, 30, GameConstants::TEXT_COLOR);
+        snprintf(scoreText, sizeof(scoreText), "%d", score2);
+        backend.drawTextCenteredAt(scoreText, 80, centerX + 90, 30, GameConstants::TEXT_COLOR);
+
+        backend.drawText(leftName.c_str(), 24, 150, 100, GameConstants::PLAYER1_COLOR);
+
+        // Right-aligned by an approximate width, kept on screen
+        int rightNameWidth = rightName.length() * 15;
+        int rightNameX = GameConstants::WINDOW_WIDTH - 50 - rightNameWidth;
+        if (rightNameX < GameConstants::WINDOW_WIDTH - 200)
+        {
+            rightNameX = GameConstants::WINDOW_WIDTH - 200;
+        }
+        backend.drawText(rightName.c_str(), 24, rightNameX, 100, GameConstants::PLAYER2_COLOR);
+    }
+};
+
+// Background music streamed from disk. A decode thread keeps a small ring of
+// samples filled for each of two decks, looping tracks without a gap; the audio
+// thread mixes the decks, crossfading between them and ducking under effects.
+class MusicPlayer : public SoundStream
+{
+public:
+    enum Track
+    {
+        TRACK_NONE = -1,
+        TRACK_MENU = 0,
+        TRACK_GAME = 1,
+        TRACK_COUNT = 2
+    };
+
+    static const int SAMPLE_RATE = 44100;
+    static const int CHANNELS = 2;
+    static const int RING_FRAMES = 16384;
+    static const int CHUNK_FRAMES = 2048;
+    static const int FADE_MS = 1500;
+
+    // Effects pull the music down to this level, hold it, then let it back up
+    static constexpr float DUCK_LEVEL = 0.35f;
+    static const int DUCK_ATTACK_MS = 30;
+    static const int DUCK_HOLD_MS = 250;
+    static const int DUCK_RELEASE_MS = 400;
+
+private:
+    struct Deck
+    {
+        unique_ptr<InputSoundFile> file;
+        int track;
+        bool mono;
+        vector<Int16> ring;
+        atomic<uint64_t> writeFrame;
+        atomic<uint64_t> readFrame;
+    };
+
+    const char* trackPaths[TRACK_COUNT];
+    bool trackMissing[TRACK_COUNT];
+    Deck decks[2];
+    vector<Int16> monoBuffer;
+    vector<Int16> mixBuffer;
+
+    // Guards which deck is playing and the fade; held by the audio thread while it mixes
+    mutex mixMutex;
+    int currentDeck;
+    int fadingDeck;
+    int fadePosition;
+
+    // Audio thread only
+    float duckGain;
+    int duckHoldFrames;
+    atomic<int> duckRequests;
+
+    atomic<int> requestedTrack;
+    atomic<bool> running;
+    mutex wakeMutex;
+    condition_variable wake;
+    thread decodeThread;
+
+    // Open a track on an idle deck; the deck stays silent if the file is missing or unusable
+    void loadDeck(Deck& deck, int track)
+    {
+        deck.file.reset();
+        deck.track = track;
+        deck.writeFrame = 0;
+        deck.readFrame = 0;
+
+        if (track == TRACK_NONE || trackMissing[track] == true)
+        {
+            return;
+        }
+
+        unique_ptr<InputSoundFile> file(new InputSoundFile());
+        if (file->openFromFile(trackPaths[track]) == false)
+        {
+            Logger::warning("Could not open music track, playing without it", LogField("path", trackPaths[track]));
+            trackMissing[track] = true;
+            return;
+        }
+        if (file->getSampleRate() != SAMPLE_RATE || file->getChannelCount() < 1 || file->getChannelCount() > 2)
+        {
+            Logger::warning("Music track must be mono or stereo at 44100 Hz", LogField("path", trackPaths[track]),
+                            LogField("channels", (int)file->getChannelCount()), LogField("rate", (int)file->getSampleRate()));
+            trackMissing[track] = true;
+            return;
+        }
+
+        deck.mono = file->getChannelCount() == 1;
+        deck.file = move(file);
+    }
+
+    // Decode into the free part of a deck's ring, wrapping to the start of the track at its end
+    void fillDeck(Deck& deck)
+    {
+        if (deck.file == nullptr)
+        {
+            return;
+        }
+
+        uint64_t write = deck.writeFrame.load(memory_order_relaxed);
+        uint64_t read = deck.readFrame.load(memory_order_acquire);
+        bool wrapped = false;
+
+        while (write - read < (uint64_t)RING_FRAMES)
+        {
+            size_t offset = (size_t)(write % RING_FRAMES);
+            size_t frames = min((size_t)(RING_FRAMES - (write - read)), (size_t)RING_FRAMES - offset);
+            frames = min(frames, (size_t)CHUNK_FRAMES);
+
+            Int16* out = &deck.ring[offset * CHANNELS];
+            uint64_t decoded;
+            if (deck.mono == true)
+            {
+                decoded = deck.file->read(monoBuffer.data(), frames);
+                for (uint64_t i = 0; i < decoded; i++)
+                {
+                    out[i * 2] = monoBuffer[i];
+                    out[i * 2 + 1] = monoBuffer[i];
+                }
+            }
+            else
+            {
+                decoded = deck.file->read(out, frames * CHANNELS) / CHANNELS;
+            }
+
+            if (decoded == 0)
+            {
+                // End of the track: carry straight on from the start so the loop has no gap
+                if (wrapped == true)
+                {
+                    // An empty track would spin here forever
+                    deck.file.reset();
+                    return;
+                }
+                deck.file->seek(0);
+                wrapped = true;
+                continue;
+            }
+            wrapped = false;
+
+            write = write + decoded;
+            deck.writeFrame.store(write, memory_order_release);
+        }
+    }
+
+    void decodeLoop()
+    {
+        while (running == true)
+        {
+            int playing;
+            int fading;
+            {
+                lock_guard<mutex> lock(mixMutex);
+                playing = currentDeck;
+                fading = fadingDeck;
+            }
+
+            // Start a crossfade once the previous one has finished with the idle deck
+            int track = requestedTrack;
+            if (track != decks[playing].track && fading == -1)
+            {
+                int idle = 1 - playing;
+                loadDeck(decks[idle], track);
+                fillDeck(decks[idle]);
+
+                lock_guard<mutex> lock(mixMutex);
+                fadingDeck = playing;
+                currentDeck = idle;
+                fadePosition = 0;
+                playing = idle;
+                fading = fadingDeck;
+            }
+
+            fillDeck(decks[playing]);
+            if (fading != -1)
+            {
+                fillDeck(decks[fading]);
+            }
+
+            // A quarter of the ring plays in about 90 ms
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait_for(lock, chrono::milliseconds(RING_FRAMES * 1000 / SAMPLE_RATE / 4));
+        }
+    }
+
+    // Next frame of a deck, or silence if the decoder has fallen behind
+    static void mixFrame(Deck& deck, float gain, float& left, float& right)
+    {
+        uint64_t read = deck.readFrame.load(memory_order_relaxed);
+        if (read == deck.writeFrame.load(memory_order_acquire))
+        {
+            return;
+        }
+        const Int16* frame = &deck.ring[(size_t)(read % RING_FRAMES) * CHANNELS];
+        left = left + frame[0] * gain;
+        right = right + frame[1] * gain;
+        deck.readFrame.store(read + 1, memory_order_release);
+    }
+
+protected:
+    bool onGetData(Chunk& data) override
+    {
+        const int fadeFrames = SAMPLE_RATE * FADE_MS / 1000;
+        const float attackStep = (1.0f - DUCK_LEVEL) / (SAMPLE_RATE * DUCK_ATTACK_MS / 1000);
+        const float releaseStep = (1.0f - DUCK_LEVEL) / (SAMPLE_RATE * DUCK_RELEASE_MS / 1000);
+
+        if (duckRequests.exchange(0) > 0)
+        {
+            duckHoldFrames = SAMPLE_RATE * DUCK_HOLD_MS / 1000;
+        }
+
+        {
+            lock_guard<mutex> lock(mixMutex);
+            for (int i = 0; i < CHUNK_FRAMES; i++)
+            {
+                if (duckHoldFrames > 0)
+                {
+                    duckHoldFrames = duckHoldFrames - 1;
+                    duckGain = max(DUCK_LEVEL, duckGain - attackStep);
+                }
+                else
+                {
+                    duckGain = min(1.0f, duckGain + releaseStep);
+                }
+
+                float left = 0;
+                float right = 0;
+                if (fadingDeck == -1)
+                {
+                    mixFrame(decks[currentDeck], duckGain, left, right);
+                }
+                else
+                {
+                    // Equal-power crossfade keeps the loudness steady through the overlap
+                    float t = (float)fadePosition / fadeFrames;
+                    mixFrame(decks[currentDeck], duckGain * sin(t * 1.5707963f), left, right);
+                    mixFrame(decks[fadingDeck], duckGain * cos(t * 1.5707963f), left, right);
+                    fadePosition = fadePosition + 1;
+                    if (fadePosition >= fadeFrames)
+                    {
+                        fadingDeck = -1;
+                    }
+                }
+
+                mixBuffer[i * 2] = (Int16)max(-32768.0f, min(32767.0f, left));
+                mixBuffer[i * 2 + 1] = (Int16)max(-32768.0f, min(32767.0f, right));
+            }
+        }
+        wake.notify_one();
+
+        data.samples = mixBuffer.data();
+        data.sampleCount = mixBuffer.size();
+        return true;
+    }
+
+    // Music is never seeked; the stream just keeps playing whatever the decks hold
+    void onSeek(Time) override
+    {
+    }
+
+public:
+    MusicPlayer()
+    {
+        trackPaths[TRACK_MENU] = "music/menu.ogg";
+        trackPaths[TRACK_GAME] = "music/game.ogg";
+        for (int t = 0; t < TRACK_COUNT; t++)
+        {
+            trackMissing[t] = false;
+        }
+
+        for (int d = 0; d < 2; d++)
+        {
+            decks[d].track = TRACK_NONE;
+            decks[d].mono = false;
+            decks[d].ring.resize(RING_FRAMES * CHANNELS);
+            decks[d].writeFrame = 0;
+            decks[d].readFrame = 0;
+        }
+        monoBuffer.resize(CHUNK_FRAMES);
+        mixBuffer.resize(CHUNK_FRAMES * CHANNELS);
+
+        currentDeck = 0;
+        fadingDeck = -1;
+        fadePosition = 0;
+        duckGain = 1.0f;
+        duckHoldFrames = 0;
+        duckRequests = 0;
+        requestedTrack = TRACK_NONE;
+        running = false;
+
+        initialize(CHANNELS, SAMPLE_RATE);
+        setVolume(40);
+    }
+
+    ~MusicPlayer()
+    {
+        // The audio thread must stop calling onGetData before anything here is destroyed
+        stop();
+        if (decodeThread.joinable())
+        {
+            running = false;
+            wake.notify_one();
+            decodeThread.join();
+        }
+    }
+
+    void start()
+    {
+        running = true;
+        decodeThread = thread(&MusicPlayer::decodeLoop, this);
+        play();
+    }
+
+    // Crossfade to a track; asking for the track already playing does nothing
+    void select(int track)
+    {
+        if (requestedTrack.exchange(track) != track)
+        {
+            wake.notify_one();
+        }
+    }
+
+    // Called when an effect plays, from any thread
+    void duck()
+    {
+        duckRequests.fetch_add(1, memory_order_relaxed);
+    }
+};
+
+class GameSounds
+{
+private:
+    SoundBuffer paddleHitBuffer;
+    SoundBuffer wallHitBuffer;
+    SoundBuffer scoreBuffer;
+    Sound paddleHitSound;
+    Sound wallHitSound;
+    Sound scoreSound;
+    atomic<bool> soundsLoaded;
+    MusicPlayer* music;
+
+public:
+    GameSounds()
+    {
+        soundsLoaded = false;
+        music = nullptr;
+    }
+
+    // Music to duck whenever an effect plays
+    void attachMusic(MusicPlayer* player)
+    {
+        music = player;
+    }
+
+    // Decode the three effects in parallel from the mapped archive
+    void loadSounds(const AssetArchive& archive)
+    {
+        bool paddleOk = false;
+        bool wallOk = false;
+        bool scoreOk = false;
+
+        thread paddleThread(&GameSounds::decode, cref(archive), "paddle_hit.wav", ref(paddleHitBuffer), ref(paddleOk));
+        thread wallThread(&GameSounds::decode, cref(archive), "wall_hit.wav", ref(wallHitBuffer), ref(wallOk));
+        decode(archive, "score.wav", scoreBuffer, scoreOk);
+        paddleThread.join();
+        wallThread.join();
+
+        if (paddleOk == false || wallOk == false || scoreOk == false)
+        {
+            Logger::warning("Could not load sounds, game will be silent");
+            return;
+        }
+
+        paddleHitSound.setBuffer(paddleHitBuffer);
+        wallHitSound.setBuffer(wallHitBuffer);
+        scoreSound.setBuffer(scoreBuffer);
+        soundsLoaded = true;
+    }
+
+    static void decode(const AssetArchive& archive, const char* name, SoundBuffer& buffer, bool& success)
+    {
+        const void* soundData;
+        size_t soundSize;
+
+        success = false;
+        if (archive.find(name, soundData, soundSize) == true)
+        {
+            success = buffer.loadFromMemory(soundData, soundSize);
+        }
+    }
+
+    void playPaddleHit()
+    {
+        if (soundsLoaded == true)
+        {
+            paddleHitSound.play();
+            if (music != nullptr)
+            {
+                music->duck();
+            }
+        }
+    }
+
+    void playWallHit()
+    {
+        if (soundsLoaded == true)
+        {
+            wallHitSound.play();
+            if (music != nullptr)
+            {
+                music->duck();
+            }
+        }
+    }
+
+    void playScore()
+    {
+        if (soundsLoaded == true)
+        {
+            scoreSound.play();
+            if (music != nullptr)
+            {
+                music->duck();
+            }
+        }
+    }
+
+    bool areSoundsLoaded() const
+    {
+        return soundsLoaded;
+    }
+};
+
+
+class HighScoreEntry
+{
+private:
+    string playerName;
+    int score;
+
+public:
+    HighScoreEntry()
+    {
+        playerName = "";
+        score = 0;
+    }
+
+    HighScoreEntry(string name, int s)
+    {
+        playerName = name;
+        score = s;
+    }
+
+    const string& getName() const
+    {
+        return playerName;
+    }
+
+    int getScore() const
+    {
+        return score;
+    }
+
+    void setName(string name)
+    {
+        playerName = name;
+    }
+
+    void setScore(int s)
+    {
+        score = s;
+    }
+};
+
+
+class HighScoreManager
+{
+private:
+    string filename;
+    vector<HighScoreEntry> highScores;
+    const int MAX_HIGH_SCORES = 10;
+    atomic<bool> loaded;
+
+    // Function to compare two high score entries
+    static bool compareEntries(const HighScoreEntry& a, const HighScoreEntry& b)
+    {
+        if (a.getScore() > b.getScore())
+        {
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+public:
+    HighScoreManager()
+    {
+        filename = "highscores.txt";
+        loaded = false;
+    }
+
+    // Tools keep separate tables, such as the verified scores of submissions
+    void setFilename(const string& path)
+    {
+        filename = path;
+    }
+
+    // Loading happens on a startup worker; nothing else may touch the list until this is true
+    bool isLoaded() const
+    {
+        return loaded;
+    }
+
+    // Load high scores from file
+    void loadHighScores()
+    {
+        MetricsTimer timer(Metrics::IO_LOAD_HIGH_SCORES);
+        ifstream file(filename.c_str());
+
+        if (file.is_open() == false)
+        {
+            Logger::info("No existing high score file found, creating a new one", LogField("path", filename));
+            loaded = true;
+            return;
+        }
+
+        highScores.clear();
+        string name;
+        int score;
+
+        while (file >> name >> score)
+        {
+            if (highScores.size() < MAX_HIGH_SCORES)
+            {
+                HighScoreEntry entry(name, score);
+                highScores.push_back(entry);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        file.close();
+        sortHighScores();
+        loaded = true;
+    }
+
+    // Save high scores to file
+    void saveHighScores()
+    {
+        PROFILE_ZONE("HighScoreManager::saveHighScores");
+        MetricsTimer timer(Metrics::IO_SAVE_HIGH_SCORES);
+
+        ofstream file(filename.c_str());
+
+        if (file.is_open() == false)
+        {
+            Logger::error("Could not save high scores", LogField("path", filename));
+            return;
+        }
+
+        for (size_t i = 0; i < highScores.size(); i++)
+        {
+            file << highScores[i].getName() << " " << highScores[i].getScore() << endl;
+        }
+
+        file.close();
+    }
+
+    // Check if score qualifies for high score
+    bool isHighScore(int score)
+    {
+        if (highScores.size() < MAX_HIGH_SCORES)
+        {
+            return true;
+        }
+
+        if (score > highScores.back().getScore())
+        {
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Add a new high score
+    void addHighScore(const string& name, int score)
+    {
+        HighScoreEntry newEntry(name, score);
+        highScores.push_back(newEntry);
+        sortHighScores();
+
+        // Keep only top scores
+        if (highScores.size() > MAX_HIGH_SCORES)
+        {
+            highScores.resize(MAX_HIGH_SCORES);
+        }
+
+        saveHighScores();
+    }
+
+    // Sort high scores in descending order
+    void sortHighScores()
+    {
+        for (size_t i = 0; i < highScores.size(); i++)
+        {
+            for (size_t j = i + 1; j < highScores.size(); j++)
+            {
+                if (highScores[j].getScore() > highScores[i].getScore())
+                {
+                    HighScoreEntry temp = highScores[i];
+                    highScores[i] = highScores[j];
+                    highScores[j] = temp;
+                }
+            }
+        }
+    }
+
+    // Get high scores for display
+    const vector<HighScoreEntry>& getHighScores() const
+    {
+        return highScores;
+    }
+
+    // Display high scores
+    void displayHighScores(RenderWindow& window, GameText& textRenderer)
+    {
+        textRenderer.drawCentered(window, "HIGH SCORES", 50, 100, Color::Yellow);
+
+        if (loaded == false)
+        {
+            textRenderer.drawCentered(window, "Loading...", 30, 180);
+            textRenderer.drawCentered(window, "Press SPACE to return to menu", 24, 600);
+            return;
+        }
+
+        float startY = 180;
+        char entry[64];
         for (size_t i = 0; i < highScores.size(); i++)
         {
-            for (size_t j = i + 1; j < highScores.size(); j++)
+            snprintf(entry, sizeof(entry), "%d. %s - %d", (int)i + 1,
+                     highScores[i].getName().c_str(), highScores[i].getScore());
+            textRenderer.drawCentered(window, entry, 30, startY + i * 40);
+        }
+
+        textRenderer.drawCentered(window, "Press SPACE to return to menu", 24, 600);
+    }
+};
+
+
+// Every finished match, with each player's Elo rating updated as matches are added.
+// The file is append-only: a player record the first time a name is seen, then one
+// fixed-size match record per match. Ratings are rebuilt by replaying the matches on load.
+class MatchHistory
+{
+public:
+    static const int VERSION = 1;
+    static const int MATCH_RECORD_BYTES = 24;
+    static const int MAX_NAME_LENGTH = 255;
+    static const int FLAG_MULTI_BALL = 0x80;
+
+    struct PlayerProfile
+    {
+        string name;
+        uint32_t nameHash;
+        float rating;
+        int matches;
+        int wins;
+        long long pointsFor;
+        long long pointsAgainst;
+        long long ticksPlayed;
+        int lastMatch;
+    };
+
+    // previous1/previous2 chain each player's matches, newest first
+    struct MatchRecord
+    {
+        int32_t player1;
+        int32_t player2;
+        uint8_t score1;
+        uint8_t score2;
+        uint8_t flags;
+        int32_t ticks;
+        int64_t time;
+        float rating1After;
+        float rating2After;
+        int32_t previous1;
+        int32_t previous2;
+    };
+
+private:
+    ofstream file;
+    vector<PlayerProfile> players;
+    vector<MatchRecord> matches;
+
+    // Open-addressing name index: player ids, -1 for empty slots, kept at most half full
+    vector<int32_t> slots;
+
+    static const int INITIAL_RATING = 1500;
+    static const int K_FACTOR = 32;
+
+    static uint32_t hashName(const string& name)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static void writeU32(unsigned char* p, uint32_t value)
+    {
+        p[0] = (unsigned char)value;
+        p[1] = (unsigned char)(value >> 8);
+        p[2] = (unsigned char)(value >> 16);
+        p[3] = (unsigned char)(value >> 24);
+    }
+
+    static uint32_t readU32(const unsigned char* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    void growIndex()
+    {
+        size_t capacity = max((size_t)1024, slots.size() * 2);
+        slots.assign(capacity, -1);
+        for (size_t i = 0; i < players.size(); i++)
+        {
+            size_t slot = players[i].nameHash & (capacity - 1);
+            while (slots[slot] != -1)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = (int32_t)i;
+        }
+    }
+
+    int insertPlayer(const string& name, uint32_t hash)
+    {
+        PlayerProfile profile;
+        profile.name = name;
+        profile.nameHash = hash;
+        profile.rating = (float)INITIAL_RATING;
+        profile.matches = 0;
+        profile.wins = 0;
+        profile.pointsFor = 0;
+        profile.pointsAgainst = 0;
+        profile.ticksPlayed = 0;
+        profile.lastMatch = -1;
+        players.push_back(profile);
+
+        if (players.size() * 2 > slots.size())
+        {
+            growIndex();
+        }
+        else
+        {
+            size_t slot = hash & (slots.size() - 1);
+            while (slots[slot] != -1)
+            {
+                slot = (slot + 1) & (slots.size() - 1);
+            }
+            slots[slot] = (int32_t)players.size() - 1;
+        }
+        return (int)players.size() - 1;
+    }
+
+    // Find a player, adding them (and their file record) the first time the name is seen
+    int findOrAddPlayer(const string& fullName)
+    {
+        string name = fullName.substr(0, MAX_NAME_LENGTH);
+        int id = findPlayer(name);
+        if (id != -1)
+        {
+            return id;
+        }
+
+        if (file.is_open() == true)
+        {
+            unsigned char header[2] = { 'P', (unsigned char)name.size() };
+            file.write((const char*)header, 2);
+            file.write(name.data(), name.size());
+        }
+        return insertPlayer(name, hashName(name));
+    }
+
+    // Elo update for one match, shared by inserts and by replay on load
+    void applyMatch(MatchRecord& record)
+    {
+        PlayerProfile& a = players[record.player1];
+        PlayerProfile& b = players[record.player2];
+
+        float expectedA = 1.0f / (1.0f + pow(10.0f, (b.rating - a.rating) / 400.0f));
+        float actualA;
+        if (record.score1 > record.score2)
+        {
+            actualA = 1.0f;
+            a.wins = a.wins + 1;
+        }
+        else if (record.score1 < record.score2)
+        {
+            actualA = 0.0f;
+            b.wins = b.wins + 1;
+        }
+        else
+        {
+            actualA = 0.5f;
+        }
+
+        float change = K_FACTOR * (actualA - expectedA);
+        a.rating = a.rating + change;
+        b.rating = b.rating - change;
+
+        a.matches = a.matches + 1;
+        b.matches = b.matches + 1;
+        a.pointsFor = a.pointsFor + record.score1;
+        a.pointsAgainst = a.pointsAgainst + record.score2;
+        b.pointsFor = b.pointsFor + record.score2;
+        b.pointsAgainst = b.pointsAgainst + record.score1;
+        a.ticksPlayed = a.ticksPlayed + record.ticks;
+        b.ticksPlayed = b.ticksPlayed + record.ticks;
+
+        record.rating1After = a.rating;
+        record.rating2After = b.rating;
+        record.previous1 = a.lastMatch;
+        record.previous2 = b.lastMatch;
+        a.lastMatch = (int32_t)matches.size();
+        b.lastMatch = (int32_t)matches.size();
+        matches.push_back(record);
+    }
+
+public:
+    ~MatchHistory()
+    {
+        close();
+    }
+
+    // Read the whole history. A record cut short by a crash ends the history there,
+    // and is dropped from the file when it is next opened for appending.
+    // Returns the number of valid bytes, or -1 if the file is missing or not a history.
+    long long load(const string& path)
+    {
+        players.clear();
+        matches.clear();
+        slots.assign(1024, -1);
+
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in)
+        {
+            return -1;
+        }
+        vector<unsigned char> data((size_t)in.tellg());
+        in.seekg(0);
+        in.read((char*)data.data(), data.size());
+        matches.reserve(data.size() / MATCH_RECORD_BYTES);
+        if (data.size() < 8 || memcmp(data.data(), "PMHS", 4) != 0 || readU32(&data[4]) != VERSION)
+        {
+            return -1;
+        }
+
+        size_t offset = 8;
+        while (offset < data.size())
+        {
+            const unsigned char* p = &data[offset];
+            size_t remaining = data.size() - offset;
+
+            if (p[0] == 'P' && remaining >= 2 && remaining >= 2 + (size_t)p[1])
+            {
+                string name((const char*)p + 2, p[1]);
+                insertPlayer(name, hashName(name));
+                offset = offset + 2 + p[1];
+            }
+            else if (p[0] == 'M' && remaining >= MATCH_RECORD_BYTES)
+            {
+                MatchRecord record;
+                record.player1 = (int32_t)readU32(p + 1);
+                record.player2 = (int32_t)readU32(p + 5);
+                record.score1 = p[9];
+                record.score2 = p[10];
+                record.flags = p[11];
+                record.ticks = (int32_t)readU32(p + 12);
+                record.time = (int64_t)((uint64_t)readU32(p + 16) | ((uint64_t)readU32(p + 20) << 32));
+                if (record.player1 < 0 || record.player1 >= (int32_t)players.size() ||
+                    record.player2 < 0 || record.player2 >= (int32_t)players.size())
+                {
+                    break;
+                }
+                applyMatch(record);
+                offset = offset + MATCH_RECORD_BYTES;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return (long long)offset;
+    }
+
+    // Load the history and keep the file open for appending, creating it if needed
+    bool open(const string& path)
+    {
+        close();
+        long long validBytes = load(path);
+
+        if (validBytes == -1)
+        {
+            ifstream existing(path, ios::binary);
+            if (existing && existing.peek() != EOF)
+            {
+                Logger::error("Not a match history file", LogField("path", path));
+                return false;
+            }
+            file.open(path, ios::binary | ios::trunc);
+            if (!file)
+            {
+                return false;
+            }
+            unsigned char header[8] = { 'P', 'M', 'H', 'S' };
+            writeU32(header + 4, VERSION);
+            file.write((const char*)header, 8);
+            file.flush();
+            return true;
+        }
+
+        ifstream existing(path, ios::binary | ios::ate);
+        long long fileBytes = (long long)existing.tellg();
+        if (validBytes < fileBytes)
+        {
+            // Rewrite the intact prefix so new records do not follow the damaged tail
+            Logger::warning("Match history ends with a damaged record", LogField("path", path),
+                            LogField("dropped_bytes", fileBytes - validBytes));
+            existing.seekg(0);
+            vector<char> prefix((size_t)validBytes);
+            existing.read(prefix.data(), validBytes);
+            existing.close();
+            ofstream rewrite(path, ios::binary | ios::trunc);
+            rewrite.write(prefix.data(), validBytes);
+        }
+
+        file.open(path, ios::binary | ios::app);
+        return (bool)file;
+    }
+
+    void close()
+    {
+        if (file.is_open() == true)
+        {
+            file.close();
+        }
+    }
+
+    // Record a finished match and update both ratings; returns the match index
+    int addMatch(const string& name1, const string& name2, int score1, int score2, int ticks, int flags)
+    {
+        MatchRecord record;
+        record.player1 = findOrAddPlayer(name1);
+        record.player2 = findOrAddPlayer(name2);
+        record.score1 = (uint8_t)min(max(score1, 0), 255);
+        record.score2 = (uint8_t)min(max(score2, 0), 255);
+        record.flags = (uint8_t)flags;
+        record.ticks = ticks;
+        record.time = (int64_t)time(nullptr);
+
+        if (file.is_open() == true)
+        {
+            unsigned char bytes[MATCH_RECORD_BYTES];
+            bytes[0] = 'M';
+            writeU32(bytes + 1, (uint32_t)record.player1);
+            writeU32(bytes + 5, (uint32_t)record.player2);
+            bytes[9] = record.score1;
+            bytes[10] = record.score2;
+            bytes[11] = record.flags;
+            writeU32(bytes + 12, (uint32_t)record.ticks);
+            writeU32(bytes + 16, (uint32_t)(uint64_t)record.time);
+            writeU32(bytes + 20, (uint32_t)((uint64_t)record.time >> 32));
+            file.write((const char*)bytes, MATCH_RECORD_BYTES);
+        }
+
+        applyMatch(record);
+        return (int)matches.size() - 1;
+    }
+
+    // Push buffered records to disk; the game calls this after every match
+    void flush()
+    {
+        MetricsTimer timer(Metrics::IO_SAVE_HISTORY);
+        if (file.is_open() == true)
+        {
+            file.flush();
+        }
+    }
+
+    // Player id for a name, or -1
+    int findPlayer(const string& name) const
+    {
+        if (slots.empty() == true)
+        {
+            return -1;
+        }
+
+        uint32_t hash = hashName(name);
+        size_t slot = hash & (slots.size() - 1);
+        while (slots[slot] != -1)
+        {
+            const PlayerProfile& profile = players[slots[slot]];
+            if (profile.nameHash == hash && profile.name == name)
+            {
+                return slots[slot];
+            }
+            slot = (slot + 1) & (slots.size() - 1);
+        }
+        return -1;
+    }
+
+    const PlayerProfile& getPlayer(int id) const
+    {
+        return players[id];
+    }
+
+    const MatchRecord& getMatch(int index) const
+    {
+        return matches[index];
+    }
+
+    int getPlayerCount() const
+    {
+        return (int)players.size();
+    }
+
+    int getMatchCount() const
+    {
+        return (int)matches.size();
+    }
+
+    // Rating a player had before the given match, for showing rating changes
+    float getRatingBefore(int matchIndex, int player) const
+    {
+        const MatchRecord& record = matches[matchIndex];
+        int previous;
+        if (record.player1 == player)
+        {
+            previous = record.previous1;
+        }
+        else
+        {
+            previous = record.previous2;
+        }
+
+        if (previous == -1)
+        {
+            return (float)INITIAL_RATING;
+        }
+        if (matches[previous].player1 == player)
+        {
+            return matches[previous].rating1After;
+        }
+        return matches[previous].rating2After;
+    }
+};
+
+
+// Hierarchical timer wheel driven by simulation ticks. Four levels of 64 slots
+// cover 2^24 ticks; a timer waits in the coarsest level that still tells it
+// apart from now and drops a level each time its slot comes round, so
+// scheduling, cancelling and firing are O(1) and a tick never scans timers.
+// Timers live in one pooled array linked by index, so steady use never allocates.
+class TimerWheel
+{
+public:
+    typedef void (*Callback)(void* owner, int value);
+
+    static const int TICKS_PER_SECOND = 60;
+    static const int TICK_MICROS = 1000000 / TICKS_PER_SECOND;
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const long long RANGE = 1LL << (LEVELS * SLOT_BITS);
+
+    struct Timer
+    {
+        long long expires;
+        Callback callback;
+        void* owner;
+        int value;
+        int previous;
+        int next;
+        int slot;
+        unsigned int generation;
+    };
+
+    vector<Timer> timers;
+    int freeList;
+    int heads[LEVELS * SLOTS];
+    long long now;
+    int pending;
+
+    // Put a timer in the slot of the coarsest level its distance from now needs
+    void link(int index)
+    {
+        Timer& timer = timers[index];
+        long long delta = timer.expires - now;
+        if (delta >= RANGE)
+        {
+            delta = RANGE - 1;
+        }
+
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1LL << ((level + 1) * SLOT_BITS)))
+        {
+            level = level + 1;
+        }
+        long long target = now + delta;
+        int slot = level * SLOTS + (int)((target >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+        timer.slot = slot;
+        timer.previous = -1;
+        timer.next = heads[slot];
+        if (heads[slot] != -1)
+        {
+            timers[heads[slot]].previous = index;
+        }
+        heads[slot] = index;
+    }
+
+    void unlink(int index)
+    {
+        Timer& timer = timers[index];
+        if (timer.previous != -1)
+        {
+            timers[timer.previous].next = timer.next;
+        }
+        else
+        {
+            heads[timer.slot] = timer.next;
+        }
+        if (timer.next != -1)
+        {
+            timers[timer.next].previous = timer.previous;
+        }
+    }
+
+    // Return a timer to the pool; the new generation makes old ids stale
+    void release(int index)
+    {
+        Timer& timer = timers[index];
+        timer.slot = -1;
+        timer.generation = timer.generation + 1;
+        timer.next = freeList;
+        freeList = index;
+        pending = pending - 1;
+    }
+
+    // Re-file every timer of a coarse slot whose span has just started
+    void cascade(int slot)
+    {
+        int index = heads[slot];
+        heads[slot] = -1;
+        while (index != -1)
+        {
+            int next = timers[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    void tick()
+    {
+        now = now + 1;
+
+        // Coarse slots are brought down from the top, so a timer can fall through several levels at once
+        int top = 0;
+        while (top < LEVELS - 1 && (now & ((1LL << ((top + 1) * SLOT_BITS)) - 1)) == 0)
+        {
+            top = top + 1;
+        }
+        for (int level = top; level >= 1; level--)
+        {
+            cascade(level * SLOTS + (int)((now >> (level * SLOT_BITS)) & (SLOTS - 1)));
+        }
+
+        // A callback may schedule again, but never into the slot being fired
+        int slot = (int)(now & (SLOTS - 1));
+        while (heads[slot] != -1)
+        {
+            int index = heads[slot];
+            unlink(index);
+            Callback callback = timers[index].callback;
+            void* owner = timers[index].owner;
+            int value = timers[index].value;
+            release(index);
+            callback(owner, value);
+        }
+    }
+
+public:
+    explicit TimerWheel(int capacity = 64)
+    {
+        timers.reserve(capacity);
+        freeList = -1;
+        now = 0;
+        pending = 0;
+        for (int i = 0; i < LEVELS * SLOTS; i++)
+        {
+            heads[i] = -1;
+        }
+    }
+
+    // Call back after the given number of ticks (at least one); returns an id for cancel()
+    uint64_t schedule(int delay, Callback callback, void* owner, int value = 0)
+    {
+        int index = freeList;
+        if (index != -1)
+        {
+            freeList = timers[index].next;
+        }
+        else
+        {
+            Timer timer;
+            timer.generation = 1;
+            timers.push_back(timer);
+            index = (int)timers.size() - 1;
+        }
+
+        Timer& timer = timers[index];
+        timer.expires = now + max(delay, 1);
+        timer.callback = callback;
+        timer.owner = owner;
+        timer.value = value;
+        link(index);
+        pending = pending + 1;
+        return ((uint64_t)timer.generation << 32) | (unsigned int)index;
+    }
+
+    // Stop a timer before it fires; ids that already fired or were cancelled are ignored
+    bool cancel(uint64_t id)
+    {
+        if (isPending(id) == false)
+        {
+            return false;
+        }
+        int index = (int)(id & 0xFFFFFFFF);
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    bool isPending(uint64_t id) const
+    {
+        unsigned int index = (unsigned int)(id & 0xFFFFFFFF);
+        if (index >= timers.size())
+        {
+            return false;
+        }
+        return timers[index].slot != -1 && timers[index].generation == (unsigned int)(id >> 32);
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < LEVELS * SLOTS; i++)
+        {
+            while (heads[i] != -1)
+            {
+                int index = heads[i];
+                unlink(index);
+                release(index);
+            }
+        }
+    }
+
+    // Run the given number of ticks; an empty wheel just moves its clock on
+    void advance(int ticks)
+    {
+        for (int i = 0; i < ticks; i++)
+        {
+            if (pending == 0)
+            {
+                now = now + (ticks - i);
+                return;
+            }
+            tick();
+        }
+    }
+
+    // Ticks until the next timer may fire, or -1 if none is pending. Timers in
+    // the coarse levels only count from their next cascade, so this can be early.
+    int getTicksUntilNext() const
+    {
+        if (pending == 0)
+        {
+            return -1;
+        }
+
+        int next = -1;
+        for (int delta = 1; delta < SLOTS; delta++)
+        {
+            if (heads[(now + delta) & (SLOTS - 1)] != -1)
+            {
+                next = delta;
+                break;
+            }
+        }
+
+        int untilCascade = SLOTS - (int)(now & (SLOTS - 1));
+        for (int i = SLOTS; i < LEVELS * SLOTS; i++)
+        {
+            if (heads[i] != -1)
+            {
+                if (next == -1 || untilCascade < next)
+                {
+                    next = untilCascade;
+                }
+                break;
+            }
+        }
+        return next;
+    }
+
+    long long getNow() const
+    {
+        return now;
+    }
+
+    int getPending() const
+    {
+        return pending;
+    }
+};
+
+
+// Records when each startup stage ran so slow subsystems can be spotted
+class StartupTimeline
+{
+private:
+    struct Stage
+    {
+        string name;
+        float startMs;
+        float endMs;
+    };
+
+    Clock clock;
+    mutex stagesMutex;
+    vector<Stage> stages;
+
+public:
+    // Mark the start of a stage; returns the index to pass to end()
+    int begin(const string& name)
+    {
+        lock_guard<mutex> lock(stagesMutex);
+        Stage stage;
+        stage.name = name;
+        stage.startMs = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        stage.endMs = -1;
+        stages.push_back(stage);
+        return (int)stages.size() - 1;
+    }
+
+    void end(int index)
+    {
+        lock_guard<mutex> lock(stagesMutex);
+        stages[index].endMs = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+    }
+
+    void report()
+    {
+        lock_guard<mutex> lock(stagesMutex);
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            Logger::info("Startup stage", LogField("stage", stages[i].name), LogField("start_ms", (double)stages[i].startMs),
+                         LogField("end_ms", (double)stages[i].endMs),
+                         LogField("duration_ms", (double)(stages[i].endMs - stages[i].startMs)));
+        }
+    }
+};
+
+
+// Decides whether the main loop may sleep on the current screen and keeps
+// wall-clock and CPU time per screen, so idle power use can be checked.
+// SFML's waitEvent has no timeout, so timed waits poll in short slices.
+class FrameScheduler
+{
+public:
+    enum Screen
+    {
+        SCREEN_LOADING,
+        SCREEN_MENU,
+        SCREEN_NAME_INPUT,
+        SCREEN_PLAYING,
+        SCREEN_PAUSED,
+        SCREEN_GAME_OVER,
+        SCREEN_HIGH_SCORES,
+        SCREEN_COUNT
+    };
+
+    // Longest a timed wait sleeps before checking for input again
+    static const int POLL_SLICE_MS = 10;
+
+private:
+    Clock wallClock;
+    float lastWallSeconds;
+    double lastCpuSeconds;
+    float wallSeconds[SCREEN_COUNT];
+    double cpuSeconds[SCREEN_COUNT];
+    long long frames[SCREEN_COUNT];
+
+    // CPU time of the whole process, background threads included
+    static double processCpuSeconds()
+    {
+#ifdef _WIN32
+        FILETIME creation;
+        FILETIME exit;
+        FILETIME kernel;
+        FILETIME user;
+        if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == 0)
+        {
+            return 0;
+        }
+        unsigned long long kernelTicks = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        unsigned long long userTicks = ((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        return (kernelTicks + userTicks) / 1e7;
+#else
+        return clock() / (double)CLOCKS_PER_SEC;
+#endif
+    }
+
+public:
+    FrameScheduler()
+    {
+        lastWallSeconds = 0;
+        lastCpuSeconds = processCpuSeconds();
+        for (int i = 0; i < SCREEN_COUNT; i++)
+        {
+            wallSeconds[i] = 0;
+            cpuSeconds[i] = 0;
+            frames[i] = 0;
+        }
+    }
+
+    static const char* getScreenName(int screen)
+    {
+        static const char* names[SCREEN_COUNT] =
+        {
+            "loading", "menu", "name input", "playing", "paused", "game over", "high scores"
+        };
+        return names[screen];
+    }
+
+    // Only gameplay and the loading bar animate every frame; everything else waits for input or a timer
+    static bool needsContinuousFrames(int screen)
+    {
+        return screen == SCREEN_PLAYING || screen == SCREEN_LOADING;
+    }
+
+    // Charge the time since the last call to the screen that was just shown
+    void account(int screen)
+    {
+        float now = wallClock.getElapsedTime().asSeconds();
+        double cpu = processCpuSeconds();
+        wallSeconds[screen] += now - lastWallSeconds;
+        cpuSeconds[screen] += cpu - lastCpuSeconds;
+        frames[screen] = frames[screen] + 1;
+        lastWallSeconds = now;
+        lastCpuSeconds = cpu;
+    }
+
+    void report() const
+    {
+        for (int i = 0; i < SCREEN_COUNT; i++)
+        {
+            if (frames[i] == 0)
+            {
+                continue;
+            }
+
+            double percent = 0;
+            if (wallSeconds[i] > 0)
+            {
+                percent = 100.0 * cpuSeconds[i] / wallSeconds[i];
+            }
+            Logger::info("CPU use per screen", LogField("screen", getScreenName(i)),
+                         LogField("seconds", (double)wallSeconds[i]), LogField("frames", frames[i]),
+                         LogField("cpu_percent", percent));
+        }
+    }
+};
+
+
+class GameManager
+{
+private:
+    StartupTimeline startupTimeline;
+    FrameScheduler frameScheduler;
+    RenderWindow gameWindow;
+    AssetArchive assetArchive;
+    ComponentStore entities;
+    Paddle player1;
+    Paddle player2;
+    Ball gameBall;
+    MultiBallField multiBalls;
+    ParticleSystem particles;
+    GameText textRenderer;
+    SfmlRenderBackend windowBackend;
+    GameSounds gameSounds;
+    MusicPlayer music;
+    HighScoreManager highScoreManager;
+    MatchHistory matchHistory;
+    int lastHistoryMatch;
+    int matchTicks;
+    TelemetryLog telemetryLog;
+    MatchTelemetry matchTelemetry;
+    unsigned int nextTelemetryMatch;
+    FlightRecorder flightRecorder;
+    bool flightMatchStart;
+
+    // The current classic match as a score submission would replay it
+    unsigned int replaySeed;
+    vector<unsigned char> replayInputs;
+    vector<uint32_t> replayKeyframes;
+    vector<unsigned char> replayChecks;
+    bool replayFromServe;
+
+    int gameState;
+    int winner;
+    bool isTwoPlayer;
+    bool isMultiBall;
+    Clock gameClock;
+    Time deltaTime;
+
+    // Match timers only advance on gameplay ticks, so pausing freezes them;
+    // interface timers advance at the same rate from the frame clock
+    TimerWheel matchTimers;
+    TimerWheel interfaceTimers;
+    int interfaceMicros;
+    uint64_t flashTimer;
+    uint64_t cursorBlinkTimer;
+
+    // Classic matches run on the selected rule set's compiled kernel
+    const RuleSet* ruleSet;
+    int ruleSetIndex;
+
+    // Single-player opponent: the rule set's own tracker, or the learned policy if one was loaded
+    PaddlePolicy paddlePolicy;
+    bool useLearnedPolicy;
+    MatchState match;
+    View courtView;
+
+    // Optional bit-exact backend; match then only mirrors fixedMatch for drawing
+    bool useFixedPoint;
+    FixedMatchState fixedMatch;
+
+    // Player names
+    string player1Name;
+    string player2Name;
+    string computerName;
+
+    // Name input variables
+    int nameInputState;
+    string currentInput;
+    bool cursorVisible;
+    bool nameEntered;
+
+    // Background startup loading
+    thread assetThread;
+    thread highScoreThread;
+    atomic<int> loadingTasks;
+    bool timelineReported;
+
+    // Shapes and text buffer reused by every frame so rendering never allocates
+    RectangleShape inputBox;
+    RectangleShape inputCursor;
+    RectangleShape pauseOverlay;
+    RectangleShape loadingBarOutline;
+    RectangleShape loadingBar;
+    char frameText[128];
+
+public:
+    GameManager() : player1(entities, 1), player2(entities, 2), gameBall(entities),
+                    windowBackend(gameWindow, textRenderer), matchTelemetry(telemetryLog)
+    {
+        // Create window and show a first frame before anything is loaded
+        int windowStage = startupTimeline.begin("window");
+        gameWindow.create(VideoMode(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT),
+                         "A Ping Pong Game ");
+        gameWindow.clear(GameConstants::BACKGROUND_COLOR);
+        gameWindow.display();
+        startupTimeline.end(windowStage);
+
+        // The learned computer player is a few kilobytes, so it loads before the workers start
+        int policyStage = startupTimeline.begin("paddle policy");
+        if (paddlePolicy.load("paddle_policy.mlp") == true)
+        {
+            Logger::info("Loaded paddle policy", LogField("path", "paddle_policy.mlp"),
+                         LogField("layers", paddlePolicy.getLayerCount()));
+        }
+        startupTimeline.end(policyStage);
+
+        // Assets and high scores load on worker threads while the menu is up
+        loadingTasks = 2;
+        timelineReported = false;
+        assetThread = thread(&GameManager::preloadAssets, this);
+        highScoreThread = thread(&GameManager::preloadHighScores, this);
+
+        // Game state
+        gameState = 0;
+        winner = 0;
+        isTwoPlayer = true;
+        isMultiBall = false;
+        useFixedPoint = false;
+        useLearnedPolicy = false;
+        lastHistoryMatch = -1;
+        matchTicks = 0;
+        replaySeed = 0;
+        // Room for a fifteen-minute match, so recording a tick does not allocate
+        replayFromServe = false;
+        replayInputs.reserve(15 * 60 * 60);
+        replayChecks.reserve(15 * 60 * 60);
+        replayKeyframes.reserve(15 * 60 * 60 / ReplayArchive::KEYFRAME_INTERVAL * ReplayArchive::STATE_WORDS +
+                                ReplayArchive::STATE_WORDS);
+        interfaceMicros = 0;
+        flashTimer = 0;
+        cursorBlinkTimer = 0;
+
+        // Initialize player names with default values
+        player1Name = "Player 1";
+        player2Name = "Player 2";
+        computerName = "Computer";
+
+        // Name input initialization
+        nameInputState = 0;
+        currentInput = "";
+        cursorVisible = true;
+        nameEntered = false;
+
+        setupShapes();
+
+        // Music streams on its own threads and ducks under the effects
+        gameSounds.attachMusic(&music);
+        music.start();
+
+        // Window settings
+        gameWindow.setFramerateLimit(60);
+        gameWindow.setKeyRepeatEnabled(false);
+
+        // Seed random number generator
+        srand(static_cast<unsigned int>(time(0)));
+
+        // The last few minutes of play are always in flight.rec, even after a crash
+        flightMatchStart = true;
+        if (flightRecorder.open("flight.rec") == false)
+        {
+            Logger::warning("Could not open flight.rec, play will not be recorded");
+        }
+
+        // Every classic match is appended to the telemetry log
+        nextTelemetryMatch = (unsigned int)time(0);
+        if (telemetryLog.open("telemetry.ptl") == false)
+        {
+            Logger::warning("Could not open telemetry.ptl, matches will not be logged");
+        }
+
+        ruleSetIndex = 0;
+        ruleSet = &RuleSetRegistry::all()[ruleSetIndex];
+        resetMatch();
+
+        Logger::info("Game initialized", LogField("width", GameConstants::WINDOW_WIDTH),
+                     LogField("height", GameConstants::WINDOW_HEIGHT));
+    }
+
+    ~GameManager()
+    {
+        if (assetThread.joinable())
+        {
+            assetThread.join();
+        }
+        if (highScoreThread.joinable())
+        {
+            highScoreThread.join();
+        }
+
+        Logger::info("Game cleaned up");
+    }
+
+    // Build the static shapes the render functions reuse every frame
+    void setupShapes()
+    {
+        inputBox.setSize(Vector2f(400, 50));
+        inputBox.setFillColor(Color(30, 30, 60, 200));
+        inputBox.setOutlineThickness(2);
+        inputBox.setOutlineColor(Color::White);
+
+        inputCursor.setSize(Vector2f(2, 30));
+        inputCursor.setFillColor(Color::White);
+
+        pauseOverlay.setSize(Vector2f(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT));
+        pauseOverlay.setFillColor(Color(0, 0, 0, 150));
+
+        loadingBarOutline.setSize(Vector2f(400, 20));
+        loadingBarOutline.setPosition(GameConstants::WINDOW_WIDTH / 2 - 200, GameConstants::WINDOW_HEIGHT / 2 - 10);
+        loadingBarOutline.setFillColor(Color::Transparent);
+        loadingBarOutline.setOutlineThickness(2);
+        loadingBarOutline.setOutlineColor(Color::White);
+
+        loadingBar.setPosition(GameConstants::WINDOW_WIDTH / 2 - 200, GameConstants::WINDOW_HEIGHT / 2 - 10);
+        loadingBar.setFillColor(Color::Cyan);
+    }
+
+    // Lay out every score digit up front so a goal never allocates mid-match
+    void warmTextCache()
+    {
+        // Any rule set or multi-ball can be picked later, so cover the highest score of them all
+        int highestScore = GameConstants::MULTI_BALL_MAX_SCORE;
+        const vector<RuleSet>& ruleSets = RuleSetRegistry::all();
+        for (size_t r = 0; r < ruleSets.size(); r++)
+        {
+            highestScore = max(highestScore, ruleSets[r].maxScore);
+        }
+
+        for (int i = 0; i <= highestScore; i++)
+        {
+            snprintf(frameText, sizeof(frameText), "%d", i);
+            textRenderer.prepare(frameText, 80);
+        }
+    }
+
+    // Font and sounds are independent, so they are decoded at the same time
+    void preloadAssets()
+    {
+        int archiveStage = startupTimeline.begin("asset archive");
+        bool archiveOpened = assetArchive.open("assets.pak");
+        startupTimeline.end(archiveStage);
+
+        if (archiveOpened == false)
+        {
+            Logger::warning("Running without assets");
+        }
+        else
+        {
+            thread fontThread(&GameManager::preloadFont, this);
+
+            int soundStage = startupTimeline.begin("sounds");
+            gameSounds.loadSounds(assetArchive);
+            startupTimeline.end(soundStage);
+
+            fontThread.join();
+        }
+
+        loadingTasks = loadingTasks - 1;
+    }
+
+    void preloadFont()
+    {
+        int fontStage = startupTimeline.begin("font");
+        textRenderer.loadFont(assetArchive);
+        startupTimeline.end(fontStage);
+    }
+
+    void preloadHighScores()
+    {
+        int highScoreStage = startupTimeline.begin("high scores");
+        highScoreManager.loadHighScores();
+        startupTimeline.end(highScoreStage);
+
+        int historyStage = startupTimeline.begin("match history");
+        if (matchHistory.open("match_history.dat") == false)
+        {
+            Logger::warning("Could not open match_history.dat, matches will not be recorded");
+        }
+        startupTimeline.end(historyStage);
+
+        loadingTasks = loadingTasks - 1;
+    }
+
+#ifdef PINGPONG_COUNT_ALLOCS
+    // Run one screen for a number of frames and count the frames after warm-up that allocated
+    int measureFrames(const char* screen, int frames, int warmup)
+    {
+        int allocatingFrames = 0;
+        unsigned long long worstFrame = 0;
+
+        for (int i = 0; i < frames; i++)
+        {
+            unsigned long long before = AllocationCounter::get();
+            handleEvents();
+            update();
+            render();
+            unsigned long long allocations = AllocationCounter::get() - before;
+
+            if (i >= warmup && allocations > 0)
+            {
+                allocatingFrames = allocatingFrames + 1;
+                if (allocations > worstFrame)
+                {
+                    worstFrame = allocations;
+                }
+            }
+        }
+
+        cout << screen << ": " << allocatingFrames << " of " << frames - warmup
+             << " frames allocated (worst " << worstFrame << ")" << endl;
+        return allocatingFrames;
+    }
+
+    // Steady-state frames on every screen must not touch the heap; returns the failure count
+    int runAllocationTest()
+    {
+        assetThread.join();
+        highScoreThread.join();
+        gameWindow.setFramerateLimit(0);
+        update();
+
+        int failures = 0;
+
+        gameState = 0;
+        failures = failures + measureFrames("menu", 240, 30);
+
+        nameInputState = 1;
+        currentInput = "TESTER";
+        startCursorBlink();
+        failures = failures + measureFrames("name input", 240, 30);
+        nameInputState = 0;
+
+        // Player 1 stays idle, so the computer scores a few goals without winning
+        isTwoPlayer = false;
+        startNewGame();
+        failures = failures + measureFrames("gameplay", 480, 30);
+
+        gameState = 2;
+        failures = failures + measureFrames("paused", 120, 30);
+
+        gameState = 4;
+        failures = failures + measureFrames("high scores", 120, 30);
+
+        winner = 2;
+        gameState = 3;
+        failures = failures + measureFrames("game over", 120, 30);
+
+        if (failures == 0)
+        {
+            cout << "Allocation test passed." << endl;
+        }
+        else
+        {
+            cout << "Allocation test FAILED." << endl;
+        }
+        return failures;
+    }
+#endif
+
+    // Main game loop
+    void run()
+    {
+        Clock frameClock;
+        while (gameWindow.isOpen())
+        {
+            int screen = getScreen();
+            if (screen == FrameScheduler::SCREEN_PLAYING || screen == FrameScheduler::SCREEN_PAUSED)
+            {
+                music.select(MusicPlayer::TRACK_GAME);
+            }
+            else
+            {
+                music.select(MusicPlayer::TRACK_MENU);
+            }
+
+            if (FrameScheduler::needsContinuousFrames(screen) == true)
+            {
+                handleEvents();
+                update();
+                render();
+            }
+            else
+            {
+                // A static screen is drawn once, then the loop sleeps until input or the next timer
+                update();
+                render();
+                waitForEvents();
+            }
+            frameScheduler.account(screen);
+            Metrics::recordFrame(frameClock.restart().asMicroseconds() / 1e6, FrameScheduler::getScreenName(screen),
+                                 FrameScheduler::needsContinuousFrames(screen), gameState);
+        }
+
+        frameScheduler.report();
+    }
+
+    // Which screen is showing, for the frame scheduler
+    int getScreen() const
+    {
+        if (timelineReported == false)
+        {
+            return FrameScheduler::SCREEN_LOADING;
+        }
+        if (nameInputState > 0)
+        {
+            return FrameScheduler::SCREEN_NAME_INPUT;
+        }
+        if (gameState == 1)
+        {
+            return FrameScheduler::SCREEN_PLAYING;
+        }
+        if (gameState == 2)
+        {
+            return FrameScheduler::SCREEN_PAUSED;
+        }
+        if (gameState == 3)
+        {
+            return FrameScheduler::SCREEN_GAME_OVER;
+        }
+        if (gameState == 4)
+        {
+            return FrameScheduler::SCREEN_HIGH_SCORES;
+        }
+        return FrameScheduler::SCREEN_MENU;
+    }
+
+    // Time until the next timer on a static screen needs a redraw; zero means none is pending
+    int getIdleTimeoutMs()
+    {
+        int ticks = interfaceTimers.getTicksUntilNext();
+        if (ticks < 0)
+        {
+            return 0;
+        }
+        int remaining = (ticks * TimerWheel::TICK_MICROS - interfaceMicros) / 1000 + 1;
+        return max(1, remaining);
+    }
+
+    // Block until input arrives, or until the idle timeout if a timer is pending
+    void waitForEvents()
+    {
+        PROFILE_ZONE("waitForEvents");
+
+        Event event;
+        int timeoutMs = getIdleTimeoutMs();
+
+        if (timeoutMs == 0)
+        {
+            if (gameWindow.waitEvent(event))
+            {
+                handleEvent(event);
+            }
+        }
+        else
+        {
+            Clock waitClock;
+            while (gameWindow.pollEvent(event) == false)
+            {
+                int remaining = timeoutMs - waitClock.getElapsedTime().asMilliseconds();
+                if (remaining <= 0)
+                {
+                    return;
+                }
+                sleep(milliseconds(min(remaining, (int)FrameScheduler::POLL_SLICE_MS)));
+            }
+            handleEvent(event);
+        }
+
+        handleEvents();
+    }
+
+    // Handle input events
+    void handleEvents()
+    {
+        PROFILE_ZONE("handleEvents");
+
+        Event event;
+        while (gameWindow.pollEvent(event))
+        {
+            handleEvent(event);
+        }
+    }
+
+    void handleEvent(const Event& event)
+    {
+        if (event.type == Event::Closed)
+        {
+            gameWindow.close();
+        }
+
+        // Keyboard presses
+        if (event.type == Event::KeyPressed)
+        {
+#ifdef PINGPONG_PROFILE
+            // F12 dumps the recorded zones from any screen
+            if (event.key.code == Keyboard::F12)
+            {
+                long long zones = Profiler::exportTrace("profile.json");
+                Logger::info("Wrote profile zones", LogField("path", "profile.json"), LogField("zones", zones));
+                return;
+            }
+#endif
+            handleKeyPress(event.key.code);
+        }
+    }
+
+    // Handle keyboard input
+    void handleKeyPress(Keyboard::Key key)
+    {
+        // If we're getting player names
+        if (nameInputState > 0)
+        {
+            handleNameInputKey(key);
+            return;
+        }
+
+        if (gameState == 0)
+        {
+            handleMenuInput(key);
+        }
+        else if (gameState == 1)
+        {
+            handleGameInput(key);
+        }
+        else if (gameState == 2)
+        {
+            if (key == Keyboard::P || key == Keyboard::Escape)
+            {
+                gameState = 1;
+            }
+        }
+        else if (gameState == 3)
+        {
+            handleGameOverInput(key);
+        }
+        else if (gameState == 4)
+        {
+            if (key == Keyboard::Space || key == Keyboard::Escape)
+            {
+                gameState = 0;
+            }
+        }
+    }
+
+    // Handle name input keys
+    void handleNameInputKey(Keyboard::Key key)
+    {
+        if (key == Keyboard::Enter)
+        {
+            // Save the entered name
+            if (nameInputState == 1)
+            {
+                // Player 1 name
+                if (currentInput.empty() == false)
+                {
+                    player1Name = currentInput;
+                }
+
+                if (isTwoPlayer == true)
+                {
+
+                    nameInputState = 2;
+                    currentInput = "";
+                    nameEntered = false;
+                }
+                else
+                {
+                    // Single player mode, start game
+                    nameInputState = 0;
+                    startNewGame();
+                }
+            }
+            else if (nameInputState == 2)
+            {
+                // Player 2 name
+                if (currentInput.empty() == false)
+                {
+                    player2Name = currentInput;
+                }
+
+                // Start the game
+                nameInputState = 0;
+                startNewGame();
+            }
+        }
+        else if (key == Keyboard::Escape)
+        {
+            // Cancel name input
+            nameInputState = 0;
+            currentInput = "";
+        }
+        else if (key == Keyboard::BackSpace)
+        {
+            // Remove last character
+            if (currentInput.empty() == false)
+            {
+                currentInput = currentInput.substr(0, currentInput.length() - 1);
+            }
+        }
+        else
+        {
+            // Check for letter keys
+            if (key >= Keyboard::A && key <= Keyboard::Z)
+            {
+                char c = 'A' + (key - Keyboard::A);
+                if (currentInput.length() < 10)
+                {
+                    currentInput = currentInput + c;
+                }
+            }
+            else if (key >= Keyboard::Num0 && key <= Keyboard::Num9)
+            {
+                char c = '0' + (key - Keyboard::Num0);
+                if (currentInput.length() < 10)
+                {
+                    currentInput = currentInput + c;
+                }
+            }
+            else if (key == Keyboard::Space)
+            {
+                if (currentInput.length() < 10 && currentInput.empty() == false)
+                {
+                    currentInput = currentInput + " ";
+                }
+            }
+        }
+    }
+
+    // Handle menu input
+    void handleMenuInput(Keyboard::Key key)
+    {
+        if (key == Keyboard::Num1 || key == Keyboard::Enter)
+        {
+            isTwoPlayer = true;
+            isMultiBall = false;
+            // Start getting player names
+            nameInputState = 1;
+            currentInput = "";
+            nameEntered = false;
+            startCursorBlink();
+        }
+        else if (key == Keyboard::Num2)
+        {
+            isTwoPlayer = false;
+            isMultiBall = false;
+            // Start getting player 1 name only
+            nameInputState = 1;
+            currentInput = "";
+            nameEntered = false;
+            startCursorBlink();
+        }
+        else if (key == Keyboard::Num3)
+        {
+            gameState = 4;
+        }
+        else if (key == Keyboard::Num4)
+        {
+            loadGame();
+        }
+        else if (key == Keyboard::Num5)
+        {
+            isTwoPlayer = true;
+            isMultiBall = true;
+            // Multi-ball is a two player mode
+            nameInputState = 1;
+            currentInput = "";
+            nameEntered = false;
+            startCursorBlink();
+        }
+        else if (key == Keyboard::Num6)
+        {
+            // Cycle through the compiled rule sets
+            ruleSetIndex = (ruleSetIndex + 1) % (int)RuleSetRegistry::all().size();
+            ruleSet = &RuleSetRegistry::all()[ruleSetIndex];
+        }
+        else if (key == Keyboard::Num7)
+        {
+            useLearnedPolicy = useLearnedPolicy == false && paddlePolicy.isLoaded() == true;
+        }
+        else if (key == Keyboard::Escape)
+        {
+            gameWindow.close();
+        }
+    }
+
+    // Handle in game input
+    void handleGameInput(Keyboard::Key key)
+    {
+        if (key == Keyboard::Escape || key == Keyboard::P)
+        {
+            gameState = 2;
+        }
+        else if (key == Keyboard::R)
+        {
+            resetGame();
+        }
+        else if (key == Keyboard::S)
+        {
+            saveGame();
+        }
+    }
+
+    // Handle game over input
+    void handleGameOverInput(Keyboard::Key key)
+    {
+        if (key == Keyboard::Enter || key == Keyboard::Space)
+        {
+            gameState = 0;
+        }
+        else if (key == Keyboard::R)
+        {
+            startNewGame();
+        }
+    }
+
+    // Update game logic
+    void update()
+    {
+        PROFILE_ZONE("update");
+
+        int frameMicros = (int)gameClock.restart().asMicroseconds();
+
+        // Print the startup timeline once every worker has finished
+        if (timelineReported == false && loadingTasks == 0)
+        {
+            startupTimeline.report();
+            warmTextCache();
+            timelineReported = true;
+        }
+
+        // Interface timers run in whole ticks of elapsed time; a long wait counts as one second
+        interfaceMicros = interfaceMicros + min(max(frameMicros, 0), 1000000);
+        int interfaceTicks = interfaceMicros / TimerWheel::TICK_MICROS;
+        interfaceMicros = interfaceMicros - interfaceTicks * TimerWheel::TICK_MICROS;
+        interfaceTimers.advance(interfaceTicks);
+
+        if (gameState != 1)
+        {
+            return;
+        }
+        matchTicks = matchTicks + 1;
+        Clock tickClock;
+
+        unsigned int inputs = readPlayerInputs();
+        if (isTwoPlayer == false)
+        {
+            inputs = inputs | controlAI();
+        }
+
+        if (isMultiBall == true)
+        {
+            // Paddles move directly; the field moves and collides every ball, then reports goals
+            PROFILE_ZONE("multiBallCollisions");
+            applyPaddleInputs(inputs);
+            multiBalls.update(player1, player2);
+            handleMultiBallImpacts();
+            handleMultiBallGoals();
+
+            // Only the paddles and scores of a multi-ball match fit in a flight record
+            MatchState snapshot = match;
+            snapshot.paddle1Y = player1.getY();
+            snapshot.paddle2Y = player2.getY();
+            snapshot.score1 = player1.getScore();
+            snapshot.score2 = player2.getScore();
+            snapshot.tick = matchTicks;
+            recordFlight(&snapshot, inputs, 0, FlightRecorder::FLAG_MULTI_BALL, frameMicros);
+        }
+        else
+        {
+            // One tick of the selected rule set's kernel, collisions included
+            PROFILE_ZONE("matchStep");
+            float ballYBefore = match.ballY;
+            recordReplayTick(inputs);
+            unsigned int events;
+            if (useFixedPoint == true)
+            {
+                events = ruleSet->stepFixed(fixedMatch, inputs);
+                match = toMatchState(fixedMatch);
+            }
+            else
+            {
+                events = ruleSet->step(match, inputs);
+            }
+            if (useFixedPoint == true)
+            {
+                replayChecks.push_back(ScoreSubmission::checkState(&fixedMatch));
+                recordFlight(&fixedMatch, inputs, events, FlightRecorder::FLAG_FIXED_POINT, frameMicros);
+            }
+            else
+            {
+                replayChecks.push_back(ScoreSubmission::checkState(&match));
+                recordFlight(&match, inputs, events, 0, frameMicros);
+            }
+            matchTelemetry.recordTick(*ruleSet, match, events, ballYBefore);
+            handleMatchEvents(events, ballYBefore);
+            syncEntities();
+        }
+
+        // Check for winner
+        if (player1.getScore() >= getWinningScore())
+        {
+            winner = 1;
+            gameState = 3;
+            checkHighScore(player1.getScore());
+        }
+        else if (player2.getScore() >= getWinningScore())
+        {
+            winner = 2;
+            gameState = 3;
+            checkHighScore(player2.getScore());
+        }
+
+        particles.update();
+        matchTimers.advance(1);
+        Metrics::recordTick(tickClock.getElapsedTime().asMicroseconds() / 1e6);
+    }
+
+    void recordFlight(const void* state, unsigned int inputs, unsigned int events, int flags, int frameMicros)
+    {
+        if (isTwoPlayer == true)
+        {
+            flags = flags | FlightRecorder::FLAG_TWO_PLAYER;
+        }
+        if (flightMatchStart == true)
+        {
+            flags = flags | FlightRecorder::FLAG_MATCH_START;
+            flightMatchStart = false;
+        }
+        flightRecorder.record(state, inputs, events, ruleSetIndex, flags, frameMicros);
+    }
+
+    // Keep the inputs, and the state at the start of every block, before the tick is played
+    void recordReplayTick(unsigned int inputs)
+    {
+        if (replayInputs.size() % ReplayArchive::KEYFRAME_INTERVAL == 0)
+        {
+            uint32_t words[ReplayArchive::STATE_WORDS];
+            if (useFixedPoint == true)
+            {
+                memcpy(words, &fixedMatch, ReplayArchive::KEYFRAME_BYTES);
+            }
+            else
+            {
+                memcpy(words, &match, ReplayArchive::KEYFRAME_BYTES);
+            }
+            replayKeyframes.insert(replayKeyframes.end(), words, words + ReplayArchive::STATE_WORDS);
+        }
+        replayInputs.push_back((unsigned char)(inputs & 0xF));
+    }
+
+    // Queue the winner's high score with the replay that proves it
+    void submitHighScore(const string& name)
+    {
+        if (replayFromServe == false)
+        {
+            Logger::info("High score not submitted, the match was continued from a saved game", LogField("name", name));
+            return;
+        }
+        // Only fixed-point matches replay the same on the verifier's build
+        if (useFixedPoint == false)
+        {
+            Logger::info("High score not submitted, the match was not played with p --fixed-point", LogField("name", name));
+            return;
+        }
+        // A submission is keyed by its history match, and a match against yourself has none
+        if (lastHistoryMatch == -1)
+        {
+            Logger::info("High score not submitted, both players have the same name", LogField("name", name));
+            return;
+        }
+
+        ScoreSubmission submission;
+        submission.matchId = (uint64_t)lastHistoryMatch;
+        submission.name = name;
+        submission.score1 = player1.getScore();
+        submission.score2 = player2.getScore();
+        submission.ruleSet = ruleSetIndex;
+        submission.flags = ReplayArchive::FLAG_FIXED_POINT;
+        submission.seed = replaySeed;
+        submission.keyframes = replayKeyframes;
+        submission.inputs = replayInputs;
+        submission.checks = replayChecks;
+        if (ScoreSubmissionLog::append("score_submissions.dat", submission) == false)
+        {
+            Logger::error("Could not queue high score submission", LogField("path", "score_submissions.dat"));
+            return;
+        }
+        Logger::info("Queued high score submission", LogField("name", name), LogField("ticks", matchTicks));
+    }
+
+    // Switch classic matches to the fixed-point backend; restarts the current match
+    void setFixedPointPhysics(bool enabled)
+    {
+        useFixedPoint = enabled;
+        resetMatch();
+    }
+
+    // Multi-ball matches run to a much higher score
+    int getWinningScore() const
+    {
+        if (isMultiBall == true)
+        {
+            return GameConstants::MULTI_BALL_MAX_SCORE;
+        }
+        else
+        {
+            return ruleSet->maxScore;
+        }
+    }
+
+    // Keyboard state as MatchInput bits
+    unsigned int readPlayerInputs()
+    {
+        unsigned int inputs = 0;
+
+        // Player 1 controls (W/D keys)
+        if (Keyboard::isKeyPressed(Keyboard::W))
+        {
+            inputs = inputs | INPUT_P1_UP;
+        }
+
+        if (Keyboard::isKeyPressed(Keyboard::D))
+        {
+            inputs = inputs | INPUT_P1_DOWN;
+        }
+
+        // Player 2 controls
+        if (isTwoPlayer == true)
+        {
+            if (Keyboard::isKeyPressed(Keyboard::Up))
+            {
+                inputs = inputs | INPUT_P2_UP;
+            }
+
+            if (Keyboard::isKeyPressed(Keyboard::Down))
+            {
+                inputs = inputs | INPUT_P2_DOWN;
+            }
+        }
+
+        return inputs;
+    }
+
+    // Multi-ball has no kernel, so its paddles are moved here
+    void applyPaddleInputs(unsigned int inputs)
+    {
+        if ((inputs & INPUT_P1_UP) != 0)
+        {
+            player1.moveUp();
+        }
+        if ((inputs & INPUT_P1_DOWN) != 0)
+        {
+            player1.moveDown();
+        }
+        if ((inputs & INPUT_P2_UP) != 0)
+        {
+            player2.moveUp();
+        }
+        if ((inputs & INPUT_P2_DOWN) != 0)
+        {
+            player2.moveDown();
+        }
+    }
+
+    // Control AI for single player mode; returns player 2's input bits
+    unsigned int controlAI()
+    {
+        PROFILE_ZONE("controlAI");
+
+        if (isMultiBall == false)
+        {
+            if (useLearnedPolicy == true)
+            {
+                return paddlePolicy.decide(match, 2, ruleSet->values);
+            }
+            if (useFixedPoint == true)
+            {
+                return ruleSet->opponentInputFixed(fixedMatch, 2);
+            }
+            return ruleSet->opponentInput(match, 2);
+        }
+
+        float ballCenterY = multiBalls.getThreatY();
+        float paddleCenterY = player2.getCenterY();
+
+        if (ballCenterY < paddleCenterY - 20)
+        {
+            return INPUT_P2_UP;
+        }
+        else if (ballCenterY > paddleCenterY + 20)
+        {
+            return INPUT_P2_DOWN;
+        }
+
+        return 0;
+    }
+
+    // Sounds, particles and score flashes for what happened in the last tick
+    void handleMatchEvents(unsigned int events, float ballYBefore)
+    {
+        float ballSize = ruleSet->ballSize;
+
+        if ((events & EVENT_WALL_BOUNCE) != 0)
+        {
+            gameSounds.playWallHit();
+            particles.emit(match.ballX + ballSize / 2, match.ballY + ballSize / 2, 20, 2.5f, 0, Color::White, 25);
+        }
+
+        if ((events & EVENT_PADDLE1_HIT) != 0)
+        {
+            gameSounds.playPaddleHit();
+            particles.emit(match.ballX, match.ballY + ballSize / 2, 40, 3.0f, 1,
+                           GameConstants::PLAYER1_COLOR, 35);
+        }
+
+        if ((events & EVENT_PADDLE2_HIT) != 0)
+        {
+            gameSounds.playPaddleHit();
+            particles.emit(match.ballX + ballSize, match.ballY + ballSize / 2, 40, 3.0f, -1,
+                           GameConstants::PLAYER2_COLOR, 35);
+        }
+
+        // Goal burst where the ball left the court
+        if ((events & EVENT_GOAL_P2) != 0)
+        {
+            particles.emit(0, ballYBefore + ballSize / 2, 300, 5.0f, 1, GameConstants::PLAYER2_COLOR, 60);
+            gameSounds.playScore();
+            startFlashEffect(2);
+        }
+        else if ((events & EVENT_GOAL_P1) != 0)
+        {
+            particles.emit(ruleSet->courtWidth, ballYBefore + ballSize / 2, 300, 5.0f, -1,
+                           GameConstants::PLAYER1_COLOR, 60);
+            gameSounds.playScore();
+            startFlashEffect(1);
+        }
+    }
+
+    // Mirror the match state into the entities that get drawn
+    void syncEntities()
+    {
+        player1.setY(match.paddle1Y);
+        player2.setY(match.paddle2Y);
+        player1.setScore(match.score1);
+        player2.setScore(match.score2);
+        gameBall.setPosition(match.ballX, match.ballY);
+    }
+
+    // Size the paddles and ball for the active rule set (multi-ball always uses the classic court)
+    void applyRuleSetGeometry()
+    {
+        if (isMultiBall == true)
+        {
+            player1.setHeight(GameConstants::PADDLE_HEIGHT);
+            player2.setHeight(GameConstants::PADDLE_HEIGHT);
+            player1.resetPosition();
+            player2.resetPosition();
+            courtView.reset(FloatRect(0, 0, GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT));
+            courtView.setViewport(FloatRect(0, 0, 1, 1));
+            return;
+        }
+
+        player1.setX(MatchSimulation<DynamicRules>::getPaddleX(1, ruleSet->values));
+        player2.setX(MatchSimulation<DynamicRules>::getPaddleX(2, ruleSet->values));
+        player1.setHeight(ruleSet->paddleHeight);
+        player2.setHeight(ruleSet->paddleHeight);
+        gameBall.setSize(ruleSet->ballSize);
+        courtView.reset(FloatRect(0, 0, ruleSet->courtWidth, ruleSet->courtHeight));
+
+        // Scale the court by the same factor both ways and centre it, leaving bars at the sides
+        float scale = min(GameConstants::WINDOW_WIDTH / ruleSet->courtWidth,
+                          GameConstants::WINDOW_HEIGHT / ruleSet->courtHeight);
+        float width = ruleSet->courtWidth * scale / GameConstants::WINDOW_WIDTH;
+        float height = ruleSet->courtHeight * scale / GameConstants::WINDOW_HEIGHT;
+        courtView.setViewport(FloatRect((1 - width) / 2, (1 - height) / 2, width, height));
+    }
+
+    // Smaller bursts than a classic match, as many balls bounce at once
+    void handleMultiBallImpacts()
+    {
+        for (int i = 0; i < multiBalls.getImpactCount(); i++)
+        {
+            const MultiBallField::Impact& impact = multiBalls.getImpact(i);
+            if (impact.player == 1)
+            {
+                particles.emit(impact.x, impact.y, 12, 3.0f, 1, GameConstants::PLAYER1_COLOR, 25);
+            }
+            else if (impact.player == 2)
+            {
+                particles.emit(impact.x, impact.y, 12, 3.0f, -1, GameConstants::PLAYER2_COLOR, 25);
+            }
+            else
+            {
+                particles.emit(impact.x, impact.y, 6, 2.5f, 0, Color::White, 20);
+            }
+        }
+    }
+
+    // Apply the goals the multi-ball field counted this tick
+    void handleMultiBallGoals()
+    {
+        int goals1 = multiBalls.takeGoals(1);
+        int goals2 = multiBalls.takeGoals(2);
+
+        if (goals1 > 0)
+        {
+            player1.setScore(player1.getScore() + goals1);
+            gameSounds.playScore();
+            particles.emit(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT / 2.0f, 30 * goals1, 5.0f, -1,
+                           GameConstants::PLAYER1_COLOR, 40);
+            startFlashEffect(1);
+        }
+
+        if (goals2 > 0)
+        {
+            player2.setScore(player2.getScore() + goals2);
+            gameSounds.playScore();
+            particles.emit(0, GameConstants::WINDOW_HEIGHT / 2.0f, 30 * goals2, 5.0f, 1,
+                           GameConstants::PLAYER2_COLOR, 40);
+            startFlashEffect(2);
+        }
+    }
+
+    // Stop any score flash and restore both paddles' colours, so nothing carries into the next match
+    void clearFlashEffect()
+    {
+        matchTimers.cancel(flashTimer);
+        player1.resetColor();
+        player2.resetColor();
+    }
+
+    // Light up the scoring player's paddle for half a second of play
+    void startFlashEffect(int player)
+    {
+        clearFlashEffect();
+        if (player == 1)
+        {
+            player1.flash();
+        }
+        else
+        {
+            player2.flash();
+        }
+        flashTimer = matchTimers.schedule(TimerWheel::TICKS_PER_SECOND / 2, &GameManager::onFlashEnd, this);
+    }
+
+    static void onFlashEnd(void* owner, int value)
+    {
+        ((GameManager*)owner)->clearFlashEffect();
+    }
+
+    // Show the name cursor and toggle it every half second while a name is being typed
+    void startCursorBlink()
+    {
+        cursorVisible = true;
+        interfaceTimers.cancel(cursorBlinkTimer);
+        cursorBlinkTimer = interfaceTimers.schedule(TimerWheel::TICKS_PER_SECOND / 2, &GameManager::onCursorBlink, this);
+    }
+
+    static void onCursorBlink(void* owner, int value)
+    {
+        GameManager* game = (GameManager*)owner;
+        if (game->nameInputState > 0)
+        {
+            game->cursorVisible = !game->cursorVisible;
+            game->cursorBlinkTimer = game->interfaceTimers.schedule(TimerWheel::TICKS_PER_SECOND / 2,
+                                                                    &GameManager::onCursorBlink, owner);
+        }
+    }
+
+    // Check if score qualifies for high score
+    void checkHighScore(int score)
+    {
+        // A match cannot normally finish before loading, but never race the worker
+        if (highScoreThread.joinable())
+        {
+            highScoreThread.join();
+        }
+
+        // Every finished match goes into the history and moves both ratings,
+        // unless both sides have the same name and it would rate a player against themselves
+        int flags = ruleSetIndex;
+        if (isMultiBall == true)
+        {
+            flags = flags | MatchHistory::FLAG_MULTI_BALL;
+        }
+        lastHistoryMatch = -1;
+        if (player1Name != getRightPlayerName())
+        {
+            lastHistoryMatch = matchHistory.addMatch(player1Name, getRightPlayerName(), player1.getScore(),
+                                                     player2.getScore(), matchTicks, flags);
+            matchHistory.flush();
+        }
+        Metrics::recordMatch();
+
+        // Multi-ball scores are not comparable with classic matches
+        if (isMultiBall == true)
+        {
+            return;
+        }
+
+        if (highScoreManager.isHighScore(score) == true)
+        {
+            if (winner == 1)
+            {
+                highScoreManager.addHighScore(player1Name, score);
+                submitHighScore(player1Name);
+            }
+            else
+            {
+                highScoreManager.addHighScore(player2Name, score);
+                submitHighScore(player2Name);
+            }
+        }
+    }
+
+    // Render everything
+    void render()
+    {
+        PROFILE_ZONE("render");
+
+        gameWindow.clear(GameConstants::BACKGROUND_COLOR);
+
+        // Without assets.pak the font never arrives, so the menu follows once loading ends, without text
+        if (loadingTasks > 0 && gameState == 0 && nameInputState == 0)
+        {
+            renderLoading();
+        }
+        else if (nameInputState > 0)
+        {
+            renderNameInput();
+        }
+        else if (gameState == 0)
+        {
+            renderMenu();
+        }
+        else if (gameState == 1)
+        {
+            renderGame();
+        }
+        else if (gameState == 2)
+        {
+            renderPaused();
+        }
+        else if (gameState == 3)
+        {
+            renderGameOver();
+        }
+        else if (gameState == 4)
+        {
+            renderHighScores();
+        }
+
+        gameWindow.display();
+    }
+
+    // Shown until the startup workers finish; needs no assets at all
+    void renderLoading()
+    {
+        PROFILE_ZONE("renderLoading");
+
+        float progress = (2 - loadingTasks) / 2.0f;
+
+        gameWindow.draw(loadingBarOutline);
+        loadingBar.setSize(Vector2f(400 * progress, 20));
+        gameWindow.draw(loadingBar);
+    }
+
+    // Render name input screen
+    void renderNameInput()
+    {
+        PROFILE_ZONE("renderNameInput");
+
+        if (nameInputState == 1)
+        {
+
+            textRenderer.drawCentered(gameWindow, "ENTER PLAYER 1 NAME", 50, 150, Color::Cyan);
+
+
+            textRenderer.drawCentered(gameWindow, "Type name using keyboard (max 10 letters)", 24, 220);
+            textRenderer.drawCentered(gameWindow, "Press ENTER to continue, ESC to cancel", 20, 260);
+
+
+            drawInputBox(350, currentInput, cursorVisible);
+
+
+            textRenderer.drawCentered(gameWindow, "Player 1 will appear as:", 24, 450);
+            const char* displayName;
+            if (currentInput.empty())
+            {
+                displayName = "Player 1";
+            }
+            else
+            {
+                displayName = currentInput.c_str();
+            }
+            textRenderer.drawCentered(gameWindow, displayName, 36, 500, GameConstants::PLAYER1_COLOR);
+        }
+        else if (nameInputState == 2)
+        {
+
+            textRenderer.drawCentered(gameWindow, "ENTER PLAYER 2 NAME", 50, 150, Color::Cyan);
+
+            // Show player 1's name
+            snprintf(frameText, sizeof(frameText), "Player 1: %s", player1Name.c_str());
+            textRenderer.drawCentered(gameWindow, frameText, 28, 220, GameConstants::PLAYER1_COLOR);
+
+            // Instructions
+            textRenderer.drawCentered(gameWindow, "Type name using keyboard (max 10 letters)", 24, 280);
+            textRenderer.drawCentered(gameWindow, "Press ENTER to continue, ESC to cancel", 20, 320);
+
+            // Draw input box
+            drawInputBox(400, currentInput, cursorVisible);
+
+            // Preview
+            textRenderer.drawCentered(gameWindow, "Player 2 will appear as:", 24, 500);
+            const char* displayName;
+            if (currentInput.empty())
+            {
+                displayName = "Player 2";
+            }
+            else
+            {
+                displayName = currentInput.c_str();
+            }
+            textRenderer.drawCentered(gameWindow, displayName, 36, 550, GameConstants::PLAYER2_COLOR);
+        }
+    }
+
+    // Draw input box with cursor
+    void drawInputBox(float yPos, const string& text, bool showCursor)
+    {
+        // Draw background rectangle
+        inputBox.setPosition(GameConstants::WINDOW_WIDTH / 2 - 200, yPos);
+        gameWindow.draw(inputBox);
+
+        // Draw text
+        if (text.empty() == false)
+        {
+            textRenderer.drawCentered(gameWindow, text, 36, yPos + 25, GameConstants::INPUT_COLOR);
+        }
+        else
+        {
+            textRenderer.drawCentered(gameWindow, "Type here...", 36, yPos + 25, Color(150, 150, 150));
+        }
+
+
+        if (showCursor && nameInputState > 0)
+        {
+            // Simple cursor - just a vertical line
+            float cursorX;
+            if (text.empty())
+            {
+                cursorX = GameConstants::WINDOW_WIDTH / 2 - 190;
+            }
+            else
+            {
+
+                cursorX = GameConstants::WINDOW_WIDTH / 2 - 190 + (text.length() * 18);
+            }
+
+            inputCursor.setPosition(cursorX, yPos + 10);
+            gameWindow.draw(inputCursor);
+        }
+    }
+
+
+    void renderMenu()
+    {
+        PROFILE_ZONE("renderMenu");
+
+        textRenderer.drawCentered(gameWindow, "Welcome To Ping Pong ", 50, 80, Color::Cyan);
+
+        textRenderer.drawCentered(gameWindow, "1. Start Two Player Game", 34, 170);
+        textRenderer.drawCentered(gameWindow, "2. Play with Computer", 34, 215);
+        textRenderer.drawCentered(gameWindow, "3. View High Scores", 34, 260);
+        textRenderer.drawCentered(gameWindow, "4. Load Saved Game", 34, 305);
+        textRenderer.drawCentered(gameWindow, "5. Multi-Ball Mode", 34, 350);
+        snprintf(frameText, sizeof(frameText), "6. Rules: %s", ruleSet->name);
+        textRenderer.drawCentered(gameWindow, frameText, 34, 395);
+        textRenderer.drawCentered(gameWindow, useLearnedPolicy == true ? "7. Computer: learned" : "7. Computer: built-in", 34, 440);
+        textRenderer.drawCentered(gameWindow, "ESC. Exit Game", 34, 485);
+
+        textRenderer.drawCentered(gameWindow, "Player 1: W/D Keys", 22, 535);
+        textRenderer.drawCentered(gameWindow, "Player 2: Up/Down Arrows", 22, 565);
+        textRenderer.drawCentered(gameWindow, "P: Pause  R: Reset  S: Save", 22, 595);
+
+        if (highScoreManager.isLoaded() == false)
+        {
+            return;
+        }
+
+        const vector<HighScoreEntry>& highScores = highScoreManager.getHighScores();
+        if (highScores.empty() == false)
+        {
+            snprintf(frameText, sizeof(frameText), "High Score: %s - %d",
+                     highScores[0].getName().c_str(), highScores[0].getScore());
+            textRenderer.drawCentered(gameWindow, frameText, 28, 640, Color::Yellow);
+        }
+    }
+
+
+    void renderGame()
+    {
+        PROFILE_ZONE("renderGame");
+
+        MatchFrame::drawCenterLine(windowBackend);
+
+        // The court is drawn in rule-set coordinates and scaled to the window
+        gameWindow.setView(courtView);
+
+        // Paddles and the ball are drawn together by the render system
+        entities.draw(gameWindow);
+        if (isMultiBall == true)
+        {
+            multiBalls.draw(gameWindow);
+        }
+        particles.draw(gameWindow);
+
+        gameWindow.setView(gameWindow.getDefaultView());
+
+        MatchFrame::drawScoreboard(windowBackend, player1.getScore(), player2.getScore(),
+                                   player1Name, getRightPlayerName());
+
+        textRenderer.draw(gameWindow, "P: Pause  R: Reset  S: Save  ESC: Menu", 18, 10,
+                         GameConstants::WINDOW_HEIGHT - 30);
+    }
+
+    // Name shown for the right-hand paddle
+    const string& getRightPlayerName() const
+    {
+        if (isTwoPlayer == true)
+        {
+            return player2Name;
+        }
+        else
+        {
+            return computerName;
+        }
+    }
+
+
+    void renderPaused()
+    {
+        PROFILE_ZONE("renderPaused");
+
+        renderGame();
+
+        gameWindow.draw(pauseOverlay);
+
+        textRenderer.drawCentered(gameWindow, "GAME PAUSED", 70, 250, Color::Yellow);
+        textRenderer.drawCentered(gameWindow, "Press P or ESC to continue", 30, 350);
+
+        int score1 = player1.getScore();
+        int score2 = player2.getScore();
+        snprintf(frameText, sizeof(frameText), "Current Score: %d - %d", score1, score2);
+        textRenderer.drawCentered(gameWindow, frameText, 36, 420);
+    }
+
+
+    void renderGameOver()
+    {
+        PROFILE_ZONE("renderGameOver");
+
+        Color winnerColor;
+        const char* winnerName;
+
+        if (winner == 1)
+        {
+            winnerName = player1Name.c_str();
+            winnerColor = GameConstants::PLAYER1_COLOR;
+        }
+        else
+        {
+            winnerName = getRightPlayerName().c_str();
+            winnerColor = GameConstants::PLAYER2_COLOR;
+        }
+
+        textRenderer.drawCentered(gameWindow, "GAME OVER", 80, 120, Color::Red);
+        snprintf(frameText, sizeof(frameText), "%s WINS!", winnerName);
+        textRenderer.drawCentered(gameWindow, frameText, 60, 220, winnerColor);
+
+        int score1 = player1.getScore();
+        int score2 = player2.getScore();
+        snprintf(frameText, sizeof(frameText), "Final Score: %d - %d", score1, score2);
+        textRenderer.drawCentered(gameWindow, frameText, 40, 320);
+
+        if (lastHistoryMatch != -1)
+        {
+            const MatchHistory::MatchRecord& record = matchHistory.getMatch(lastHistoryMatch);
+            float before1 = matchHistory.getRatingBefore(lastHistoryMatch, record.player1);
+            float before2 = matchHistory.getRatingBefore(lastHistoryMatch, record.player2);
+            snprintf(frameText, sizeof(frameText), "Rating: %.0f (%+.0f)  -  %.0f (%+.0f)",
+                     record.rating1After, record.rating1After - before1,
+                     record.rating2After, record.rating2After - before2);
+            textRenderer.drawCentered(gameWindow, frameText, 26, 372);
+        }
+
+        textRenderer.drawCentered(gameWindow, "Press ENTER to return to menu", 30, 420);
+        textRenderer.drawCentered(gameWindow, "Press R to play again", 30, 470);
+
+        int winningScore;
+        if (winner == 1)
+        {
+            winningScore = player1.getScore();
+        }
+        else
+        {
+            winningScore = player2.getScore();
+        }
+
+        if (highScoreManager.isLoaded() == true && highScoreManager.isHighScore(winningScore) == true)
+        {
+            textRenderer.drawCentered(gameWindow, "NEW HIGH SCORE!", 40, 550, Color::Yellow);
+        }
+    }
+
+
+    void renderHighScores()
+    {
+        PROFILE_ZONE("renderHighScores");
+
+        highScoreManager.displayHighScores(gameWindow, textRenderer);
+    }
+
+
+    void startNewGame()
+    {
+        resetMatch();
+        gameState = 1;
+        winner = 0;
+    }
+
+
+    void resetGame()
+    {
+        resetMatch();
+    }
+
+    // Fresh scores, a new serve and cleared effects for the current mode and rule set
+    void resetMatch()
+    {
+        particles.clear();
+        matchTimers.clear();
+        clearFlashEffect();
+        matchTicks = 0;
+        lastHistoryMatch = -1;
+        flightMatchStart = true;
+        replayInputs.clear();
+        replayKeyframes.clear();
+        replayChecks.clear();
+        replayFromServe = isMultiBall == false;
+        applyRuleSetGeometry();
+
+        if (isMultiBall == true)
+        {
+            player1.setScore(0);
+            player2.setScore(0);
+            multiBalls.spawn(GameConstants::MULTI_BALL_COUNT);
+            gameBall.setIsActive(false);
+        }
+        else
+        {
+            replaySeed = (unsigned int)rand();
+            if (useFixedPoint == true)
+            {
+                ruleSet->resetFixed(fixedMatch, replaySeed);
+                match = toMatchState(fixedMatch);
+            }
+            else
+            {
+                ruleSet->reset(match, replaySeed);
+            }
+            matchTelemetry.beginMatch(nextTelemetryMatch, match);
+            nextTelemetryMatch = nextTelemetryMatch + 1;
+            gameBall.setIsActive(true);
+            syncEntities();
+        }
+    }
+
+    // Save game state to file
+    void saveGame()
+    {
+        PROFILE_ZONE("saveGame");
+        MetricsTimer timer(Metrics::IO_SAVE_GAME);
+
+        ofstream saveFile("game_save.dat");
+
+        if (saveFile.is_open() == false)
+        {
+            Logger::error("Could not save game", LogField("path", "game_save.dat"));
+            return;
+        }
+
+        saveFile << player1.getScore() << endl;
+        saveFile << player2.getScore() << endl;
+        saveFile << isTwoPlayer << endl;
+        saveFile << gameState << endl;
+        saveFile << player1Name << endl;
+        saveFile << player2Name << endl;
+
+        saveFile.close();
+        Logger::info("Game saved", LogField("score1", player1.getScore()), LogField("score2", player2.getScore()),
+                     LogField("player1", player1Name), LogField("player2", player2Name));
+    }
+
+    // Load game state from file
+    void loadGame()
+    {
+        MetricsTimer timer(Metrics::IO_LOAD_GAME);
+        ifstream loadFile("game_save.dat");
+
+        if (loadFile.is_open() == false)
+        {
+            Logger::error("No saved game found", LogField("path", "game_save.dat"));
+            return;
+        }
+
+        int score1;
+        int score2;
+        bool twoPlayer;
+        int state;
+        string name1;
+        string name2;
+
+        loadFile >> score1;
+        loadFile >> score2;
+        loadFile >> twoPlayer;
+        loadFile >> state;
+        loadFile >> name1;
+        loadFile >> name2;
+
+        isTwoPlayer = twoPlayer;
+        gameState = state;
+        if (isMultiBall == true)
+        {
+            // Saves are always classic matches
+            isMultiBall = false;
+            resetMatch();
+        }
+        match.score1 = score1;
+        match.score2 = score2;
+        fixedMatch.score1 = score1;
+        fixedMatch.score2 = score2;
+        matchTimers.clear();
+        clearFlashEffect();
+        lastHistoryMatch = -1;
+        // The loaded match's length is unknown, so it counts from the load
+        matchTicks = 0;
+        flightMatchStart = true;
+        // No replay from a fresh serve can reach the loaded scores, so this match is never submitted
+        replayFromServe = false;
+        replayInputs.clear();
+        replayKeyframes.clear();
+        replayChecks.clear();
+        syncEntities();
+        player1Name = name1;
+        player2Name = name2;
+
+        loadFile.close();
+        Logger::info("Game loaded", LogField("score1", score1), LogField("score2", score2),
+                     LogField("player1", name1), LogField("player2", name2));
+    }
+};
+
+
+// Ticks per second of the multi-ball field against ball count, grid versus all-pairs
+int runMultiBallBenchmark()
+{
+    const int counts[] = { 100, 250, 500, 1000, 2000, 4000, 8000 };
+    ComponentStore paddleStore;
+    Paddle leftPaddle(paddleStore, 1);
+    Paddle rightPaddle(paddleStore, 2);
+
+    cout << "balls    grid ticks/s   pairs/tick   all-pairs ticks/s" << endl;
+
+    for (int c = 0; c < 7; c++)
+    {
+        double ticksPerSecond[2] = { 0, 0 };
+        long long pairsPerTick = 0;
+
+        for (int mode = 0; mode < 2; mode++)
+        {
+            // All-pairs becomes too slow to be worth timing past a few thousand balls
+            if (mode == 1 && counts[c] > 2000)
+            {
+                continue;
+            }
+
+            MultiBallField field;
+            field.setBroadphase(mode == 0);
+            field.spawn(counts[c]);
+
+            // Let the balls spread out from the spawn line before timing
+            for (int i = 0; i < 100; i++)
+            {
+                field.update(leftPaddle, rightPaddle);
+            }
+
+            long long pairsBefore = field.getPairTests();
+            Clock clock;
+            int ticks = 0;
+            while (clock.getElapsedTime().asSeconds() < 0.5f)
+            {
+                field.update(leftPaddle, rightPaddle);
+                ticks = ticks + 1;
+            }
+
+            ticksPerSecond[mode] = ticks / clock.getElapsedTime().asSeconds();
+            if (mode == 0)
+            {
+                pairsPerTick = (field.getPairTests() - pairsBefore) / ticks;
+            }
+        }
+
+        printf("%5d %17.0f %12lld ", counts[c], ticksPerSecond[0], pairsPerTick);
+        if (ticksPerSecond[1] > 0)
+        {
+            printf("%19.0f\n", ticksPerSecond[1]);
+        }
+        else
+        {
+            printf("%19s\n", "-");
+        }
+    }
+
+    return 0;
+}
+
+
+// Entity updates per second: component store against the old heap-allocated virtual objects
+int runEntityBenchmark()
+{
+    // The layout the component store replaced: one heap object per entity,
+    // a vtable, and an SFML shape carried along inside every object.
+    class LegacyObject
+    {
+    public:
+        float xPosition;
+        float yPosition;
+        float width;
+        float height;
+        Color objectColor;
+
+        virtual ~LegacyObject()
+        {
+        }
+
+        virtual void update() = 0;
+    };
+
+    class LegacyBall : public LegacyObject
+    {
+    public:
+        float velocityX;
+        float velocityY;
+        CircleShape ballShape;
+
+        void update()
+        {
+            xPosition = xPosition + velocityX;
+            yPosition = yPosition + velocityY;
+        }
+    };
+
+    const int counts[] = { 1000, 10000, 100000, 1000000 };
+
+    cout << "entities   store ns/entity   objects ns/entity   speed-up" << endl;
+
+    for (int c = 0; c < 4; c++)
+    {
+        int count = counts[c];
+        int passes = 20000000 / count;
+
+        ComponentStore store;
+        vector<LegacyObject*> objects;
+        for (int i = 0; i < count; i++)
+        {
+            int entity = store.createEntity((float)i, (float)i, 10, 10, Color::White, ComponentStore::SHAPE_CIRCLE);
+            store.velocity(entity).x = 0.5f;
+            store.velocity(entity).y = -0.5f;
+
+            LegacyBall* ball = new LegacyBall();
+            ball->xPosition = (float)i;
+            ball->yPosition = (float)i;
+            ball->velocityX = 0.5f;
+            ball->velocityY = -0.5f;
+            objects.push_back(ball);
+        }
+
+        Clock clock;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            store.integrate();
+        }
+        double storeNs = clock.restart().asMicroseconds() * 1000.0 / ((double)passes * count);
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            for (size_t i = 0; i < objects.size(); i++)
+            {
+                objects[i]->update();
+            }
+        }
+        double objectNs = clock.restart().asMicroseconds() * 1000.0 / ((double)passes * count);
+
+        // Read the results back so the loops cannot be optimised away
+        float checksum = store.transform(count - 1).x + objects[count - 1]->xPosition;
+
+        printf("%8d %17.3f %19.3f %9.1fx   (%.0f)\n", count, storeNs, objectNs, objectNs / storeNs, checksum);
+
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            delete objects[i];
+        }
+    }
+
+    return 0;
+}
+
+
+// Computer-vs-computer ticks per second for each rule set, compiled kernel against run-time values
+int runRuleSetBenchmark()
+{
+    const int MATCHES = 2000;
+
+    cout << "rule set        specialised ticks/s   run-time ticks/s   gain" << endl;
+
+    for (size_t r = 0; r < RuleSetRegistry::all().size(); r++)
+    {
+        const RuleSet& ruleSet = RuleSetRegistry::all()[r];
+
+        Clock clock;
+        long long specialisedTicks = ruleSet.simulateMatches(MATCHES, 1234);
+        double specialisedSeconds = clock.restart().asMicroseconds() / 1e6;
+
+        long long dynamicTicks = MatchSimulation<DynamicRules>::simulateMatches(MATCHES, 1234, ruleSet.values);
+        double dynamicSeconds = clock.restart().asMicroseconds() / 1e6;
+
+        // Both kernels play the same matches, so the tick counts must agree
+        if (specialisedTicks != dynamicTicks)
+        {
+            cout << "Error: " << ruleSet.name << " kernels disagree (" << specialisedTicks
+                 << " vs " << dynamicTicks << " ticks)" << endl;
+            return 1;
+        }
+
+        double specialisedRate = specialisedTicks / specialisedSeconds;
+        double dynamicRate = dynamicTicks / dynamicSeconds;
+        printf("%-15s %19.0f %18.0f %6.2fx\n", ruleSet.name, specialisedRate, dynamicRate, specialisedRate / dynamicRate);
+    }
+
+    return 0;
+}
+
+
+// Fixed-point against float throughput per rule set, plus a hash of every
+// fixed-point tick that must be identical on every build and platform
+int runFixedPointBenchmark()
+{
+    const int MATCHES = 2000;
+
+    cout << "rule set        float ticks/s   fixed ticks/s   ratio   state hash" << endl;
+
+    for (size_t r = 0; r < RuleSetRegistry::all().size(); r++)
+    {
+        const RuleSet& ruleSet = RuleSetRegistry::all()[r];
+
+        Clock clock;
+        long long floatTicks = ruleSet.simulateMatches(MATCHES, 1234);
+        double floatSeconds = clock.restart().asMicroseconds() / 1e6;
+
+        long long fixedTicks = ruleSet.simulateMatchesFixed(MATCHES, 1234, nullptr);
+        double fixedSeconds = clock.restart().asMicroseconds() / 1e6;
+
+        // Hashing runs are kept out of the timing; two of them must agree
+        uint64_t hash = 0;
+        uint64_t repeatHash = 0;
+        ruleSet.simulateMatchesFixed(MATCHES, 1234, &hash);
+        ruleSet.simulateMatchesFixed(MATCHES, 1234, &repeatHash);
+        if (repeatHash != hash)
+        {
+            cout << "Error: " << ruleSet.name << " fixed-point run is not reproducible" << endl;
+            return 1;
+        }
+
+        double floatRate = floatTicks / floatSeconds;
+        double fixedRate = fixedTicks / fixedSeconds;
+        printf("%-15s %13.0f %15.0f %6.2fx   %016llx\n", ruleSet.name, floatRate, fixedRate,
+               fixedRate / floatRate, (unsigned long long)hash);
+    }
+
+    return 0;
+}
+
+
+// Worst frame cost of the particle system after one 50,000 particle burst
+int runParticleBenchmark()
+{
+    ParticleSystem particles;
+    particles.emit(500, 350, 50000, 5.0f, 0, Color::White, 120);
+    int keptParticles = particles.getCount();
+
+    float worstUpdateMs = 0;
+    float worstBuildMs = 0;
+    Clock clock;
+
+    for (int frame = 0; frame < 240; frame++)
+    {
+        clock.restart();
+        particles.update();
+        float updateMs = clock.restart().asMicroseconds() / 1000.0f;
+        particles.buildVertices();
+        float buildMs = clock.restart().asMicroseconds() / 1000.0f;
+
+        if (updateMs > worstUpdateMs)
+        {
+            worstUpdateMs = updateMs;
+        }
+        if (buildMs > worstBuildMs)
+        {
+            worstBuildMs = buildMs;
+        }
+    }
+
+    cout << "Burst of 50000: " << keptParticles << " kept, "
+         << particles.getDroppedParticles() << " dropped" << endl;
+    cout << "Worst update: " << worstUpdateMs << " ms, worst batch build: " << worstBuildMs << " ms" << endl;
+    return 0;
+}
+
+
+// Render a computer-vs-computer classic match without a window, either as a
+// numbered PNG sequence (output_00000.png, ...) or as one raw RGBA video file.
+// The match runs on the fixed-point kernel, so a seed always gives the same video.
+int runMatchExport(unsigned int seed, int maxFrames, const string& output, bool raw)
+{
+    const int WIDTH = GameConstants::WINDOW_WIDTH;
+    const int HEIGHT = GameConstants::WINDOW_HEIGHT;
+
+    AssetArchive archive;
+    const void* fontData;
+    size_t fontSize;
+    SoftwareFont font;
+    if (archive.open("assets.pak") == false || archive.find("font.ttf", fontData, fontSize) == false ||
+        font.load(fontData, fontSize) == false)
+    {
+        cout << "Error: Could not load the font from assets.pak" << endl;
+        return 1;
+    }
+
+    // Simulating is cheap and sequential; rendering is what gets spread over cores
+    const RuleSet& ruleSet = RuleSetRegistry::all()[0];
+    vector<MatchState> frames;
+    frames.reserve(maxFrames);
+    FixedMatchState state;
+    ruleSet.resetFixed(state, seed);
+    while ((int)frames.size() < maxFrames)
+    {
+        frames.push_back(toMatchState(state));
+        if (state.score1 >= ruleSet.maxScore || state.score2 >= ruleSet.maxScore)
+        {
+            break;
+        }
+        ruleSet.stepFixed(state, ruleSet.aiInputFixed(state, 1) | ruleSet.aiInputFixed(state, 2));
+    }
+
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    vector<SoftwareRenderBackend> backends;
+    backends.reserve(threadCount * 2);
+    for (int t = 0; t < threadCount; t++)
+    {
+        backends.emplace_back(WIDTH, HEIGHT, font);
+    }
+
+    const string leftName = "Computer 1";
+    const string rightName = "Computer 2";
+    auto renderFrame = [&](SoftwareRenderBackend& backend, int index)
+    {
+        const MatchState& frame = frames[index];
+        backend.clear(GameConstants::BACKGROUND_COLOR);
+        MatchFrame::drawCenterLine(backend);
+        MatchFrame::drawCourt(backend, ruleSet, frame);
+        MatchFrame::drawScoreboard(backend, frame.score1, frame.score2, leftName, rightName);
+    };
+
+    int frameCount = (int)frames.size();
+    atomic<bool> failed(false);
+    Clock clock;
+
+    if (raw == false)
+    {
+        // Each thread renders and encodes every threadCount-th frame
+        vector<thread> workers;
+        for (int t = 0; t < threadCount; t++)
+        {
+            workers.push_back(thread([&, t]()
             {
-                if (highScores[j].getScore() > highScores[i].getScore())
+                Image image;
+                char path[512];
+                for (int i = t; i < frameCount; i = i + threadCount)
                 {
-                    HighScoreEntry temp = highScores[i];
-                    highScores[i] = highScores[j];
-                    highScores[j] = temp;
+                    renderFrame(backends[t], i);
+                    image.create(WIDTH, HEIGHT, backends[t].getPixels());
+                    snprintf(path, sizeof(path), "%s_%05d.png", output.c_str(), i);
+                    if (image.saveToFile(path) == false)
+                    {
+                        failed = true;
+                        return;
+                    }
+                }
+            }));
+        }
+
+        for (size_t t = 0; t < workers.size(); t++)
+        {
+            workers[t].join();
+        }
+    }
+    else
+    {
+        ofstream videoFile(output, ios::binary);
+        if (!videoFile)
+        {
+            cout << "Error: Could not create " << output << endl;
+            return 1;
+        }
+
+        // Workers start once and render one frame of every batch into one of two
+        // sets of backends, so the next batch renders while this one is written
+        for (int t = 0; t < threadCount; t++)
+        {
+            backends.emplace_back(WIDTH, HEIGHT, font);
+        }
+        mutex batchMutex;
+        condition_variable batchPosted;
+        condition_variable frameRendered;
+        int batchNumber = 0;
+        int batchStart = 0;
+        int rendered = 0;
+        bool finished = false;
+
+        vector<thread> workers;
+        for (int t = 0; t < threadCount; t++)
+        {
+            workers.push_back(thread([&, t]()
+            {
+                int seen = 0;
+                while (true)
+                {
+                    int frame;
+                    int half;
+                    {
+                        unique_lock<mutex> lock(batchMutex);
+                        batchPosted.wait(lock, [&]() { return finished == true || batchNumber != seen; });
+                        if (finished == true)
+                        {
+                            return;
+                        }
+                        seen = batchNumber;
+                        frame = batchStart + t;
+                        half = batchNumber % 2;
+                    }
+
+                    if (frame < frameCount)
+                    {
+                        renderFrame(backends[half * threadCount + t], frame);
+                    }
+                    {
+                        lock_guard<mutex> lock(batchMutex);
+                        rendered = rendered + 1;
+                    }
+                    frameRendered.notify_one();
                 }
+            }));
+        }
+
+        auto postBatch = [&](int start)
+        {
+            {
+                lock_guard<mutex> lock(batchMutex);
+                batchStart = start;
+                batchNumber = batchNumber + 1;
+                rendered = 0;
+            }
+            batchPosted.notify_all();
+        };
+
+        postBatch(0);
+        for (int batch = 0; batch < frameCount; batch = batch + threadCount)
+        {
+            int half;
+            {
+                unique_lock<mutex> lock(batchMutex);
+                frameRendered.wait(lock, [&]() { return rendered == threadCount; });
+                half = batchNumber % 2;
+            }
+            if (batch + threadCount < frameCount)
+            {
+                postBatch(batch + threadCount);
+            }
+
+            int batchSize = min(threadCount, frameCount - batch);
+            for (int t = 0; t < batchSize; t++)
+            {
+                videoFile.write((const char*)backends[half * threadCount + t].getPixels(), (streamsize)WIDTH * HEIGHT * 4);
             }
         }
+
+        {
+            lock_guard<mutex> lock(batchMutex);
+            finished = true;
+        }
+        batchPosted.notify_all();
+        for (size_t t = 0; t < workers.size(); t++)
+        {
+            workers[t].join();
+        }
+
+        if (!videoFile)
+        {
+            failed = true;
+        }
     }
 
-    // Get high scores for display
-    vector<HighScoreEntry> getHighScores() const
+    if (failed == true)
     {
-        return highScores;
+        cout << "Error: Could not write " << output << endl;
+        return 1;
     }
 
-    // Display high scores
-    void displayHighScores(RenderWindow& window, GameText& textRenderer)
+    double seconds = clock.getElapsedTime().asMicroseconds() / 1e6;
+    cout << "Rendered " << frameCount << " frames on " << threadCount << " threads in " << seconds
+         << " s (" << frameCount / seconds << " frames/s, real time is 60)" << endl;
+    if (raw == true)
     {
-        textRenderer.drawCentered(window, "HIGH SCORES", 50, 100, Color::Yellow);
+        cout << "Encode with: ffmpeg -f rawvideo -pixel_format rgba -video_size " << WIDTH << "x" << HEIGHT
+             << " -framerate 60 -i " << output << " match.mp4" << endl;
+    }
+    return 0;
+}
 
-        float startY = 180;
-        for (size_t i = 0; i < highScores.size(); i++)
+
+// Simulate computer-vs-computer classic matches with telemetry on, appending to a log
+int runTelemetryGenerate(const string& path, int matches)
+{
+    TelemetryLog log;
+    if (log.open(path) == false)
+    {
+        cout << "Error: Could not open " << path << endl;
+        return 1;
+    }
+
+    const RuleSet& ruleSet = RuleSetRegistry::all()[0];
+    MatchTelemetry telemetry(log);
+    MatchState state;
+    unsigned int firstMatch = (unsigned int)time(nullptr);
+    Clock clock;
+
+    for (int m = 0; m < matches; m++)
+    {
+        ruleSet.reset(state, 1000 + m);
+        telemetry.beginMatch(firstMatch + m, state);
+        while (ruleSet.getWinner(state) == 0)
         {
-            string entryNumber = to_string(i + 1) + ". ";
-            string entryName = highScores[i].getName();
-            string entryScore = to_string(highScores[i].getScore());
-            string entry = entryNumber + entryName + " - " + entryScore;
-            textRenderer.drawCentered(window, entry, 30, startY + i * 40);
+            float ballYBefore = state.ballY;
+            unsigned int events = ruleSet.step(state, ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2));
+            telemetry.recordTick(ruleSet, state, events, ballYBefore);
         }
+    }
+    log.close();
 
-        textRenderer.drawCentered(window, "Press SPACE to return to menu", 24, 600);
+    double seconds = clock.getElapsedTime().asMicroseconds() / 1e6;
+    cout << matches << " matches, " << log.getEventsWritten() << " events in " << seconds << " s ("
+         << log.getEventsWritten() / seconds << " events/s, "
+         << (double)log.getBytesWritten() / max(1LL, log.getEventsWritten()) << " bytes/event)" << endl;
+    return 0;
+}
+
+
+// Rally lengths, paddle hit heatmaps and ball speeds over a whole telemetry log,
+// read one block at a time
+int runTelemetryQuery(const string& path)
+{
+    // Rally lengths go in power-of-two buckets: 0, 1, 2-3, 4-7, ...
+    const int RALLY_BUCKETS = 16;
+    const int HIT_BUCKETS = 20;
+    const int WALL_BUCKETS = 20;
+
+    TelemetryReader reader;
+    if (reader.open(path) == false)
+    {
+        cout << "Error: " << path << " is not a telemetry log" << endl;
+        return 1;
     }
-};
 
+    long long events = 0;
+    long long rallies = 0;
+    long long rallyHitTotal = 0;
+    long long rallyLengths[RALLY_BUCKETS] = {};
+    long long hitHeatmap[2][HIT_BUCKETS] = {};
+    long long wallHeatmap[WALL_BUCKETS] = {};
+    long long hits[2] = {};
+    double speedTotal[2] = {};
+    float speedMax[2] = {};
+    long long goals[2] = {};
+    unsigned int lastMatch = 0;
+    long long matches = 0;
+
+    vector<TelemetryEvent> block;
+    while (reader.nextBlock(block) == true)
+    {
+        for (size_t i = 0; i < block.size(); i++)
+        {
+            const TelemetryEvent& event = block[i];
+            events = events + 1;
 
-class GameManager
+            if (event.match != lastMatch || matches == 0)
+            {
+                matches = matches + 1;
+                lastMatch = event.match;
+            }
+
+            if (event.type == TELEMETRY_RALLY_END)
+            {
+                int length = (int)event.value0;
+                int bucket = 0;
+                while (bucket < RALLY_BUCKETS - 1 && (1 << bucket) <= length)
+                {
+                    bucket = bucket + 1;
+                }
+                rallies = rallies + 1;
+                rallyHitTotal = rallyHitTotal + length;
+                rallyLengths[bucket]++;
+            }
+            else if (event.type == TELEMETRY_PADDLE_HIT && (event.player == 1 || event.player == 2))
+            {
+                int p = event.player - 1;
+                int bucket = (int)((event.value0 + 1) / 2 * HIT_BUCKETS);
+                hitHeatmap[p][max(0, min(HIT_BUCKETS - 1, bucket))]++;
+
+                float speed = sqrt(event.value1 * event.value1 + event.value2 * event.value2);
+                hits[p] = hits[p] + 1;
+                speedTotal[p] = speedTotal[p] + speed;
+                speedMax[p] = max(speedMax[p], speed);
+            }
+            else if (event.type == TELEMETRY_WALL_BOUNCE)
+            {
+                int bucket = (int)(event.value0 * WALL_BUCKETS);
+                wallHeatmap[max(0, min(WALL_BUCKETS - 1, bucket))]++;
+            }
+            else if (event.type == TELEMETRY_GOAL && (event.player == 1 || event.player == 2))
+            {
+                goals[event.player - 1]++;
+            }
+        }
+    }
+
+    cout << events << " events from " << matches << " matches" << endl;
+
+    cout << endl << "Rally length (paddle hits), " << rallies << " rallies, mean "
+         << (rallies > 0 ? (double)rallyHitTotal / rallies : 0) << ":" << endl;
+    for (int i = 0; i < RALLY_BUCKETS; i++)
+    {
+        if (rallyLengths[i] > 0)
+        {
+            int low = (i == 0) ? 0 : 1 << (i - 1);
+            int high = (i == 0) ? 0 : (1 << i) - 1;
+            if (i == RALLY_BUCKETS - 1)
+            {
+                printf("  %5d+      %6.2f%%\n", low, 100.0 * rallyLengths[i] / rallies);
+                continue;
+            }
+            printf("  %5d-%-5d %6.2f%%\n", low, high, 100.0 * rallyLengths[i] / rallies);
+        }
+    }
+
+    // Each row is one slice of the paddle, top to bottom, with a bar per player
+    cout << endl << "Paddle hit heatmap (top to bottom, % of each player's hits):" << endl;
+    for (int b = 0; b < HIT_BUCKETS; b++)
+    {
+        double share1 = hits[0] > 0 ? 100.0 * hitHeatmap[0][b] / hits[0] : 0;
+        double share2 = hits[1] > 0 ? 100.0 * hitHeatmap[1][b] / hits[1] : 0;
+        printf("  %+5.2f  P1 %5.1f%% %-20s  P2 %5.1f%% %s\n", -1 + (b + 0.5) * 2.0 / HIT_BUCKETS,
+               share1, string((size_t)(share1 / 2), '#').c_str(), share2, string((size_t)(share2 / 2), '#').c_str());
+    }
+
+    long long wallTotal = 0;
+    for (int b = 0; b < WALL_BUCKETS; b++)
+    {
+        wallTotal = wallTotal + wallHeatmap[b];
+    }
+    cout << endl << "Wall bounce heatmap (left to right):" << endl << "  ";
+    for (int b = 0; b < WALL_BUCKETS; b++)
+    {
+        printf("%4.1f ", wallTotal > 0 ? 100.0 * wallHeatmap[b] / wallTotal : 0);
+    }
+    cout << endl;
+
+    cout << endl << "Ball speed after paddle hits:" << endl;
+    for (int p = 0; p < 2; p++)
+    {
+        printf("  Player %d: %lld hits, mean %.2f, max %.2f, %lld goals\n", p + 1, hits[p],
+               hits[p] > 0 ? speedTotal[p] / hits[p] : 0, speedMax[p], goals[p]);
+    }
+    return 0;
+}
+
+
+#ifdef PINGPONG_PROFILE
+// Cost of one empty zone, recorded from up to four threads at once
+int runProfilerBenchmark()
 {
-private:
-    RenderWindow gameWindow;
-    Paddle* player1;
-    Paddle* player2;
-    Ball* gameBall;
-    GameText textRenderer;
-    GameSounds gameSounds;
-    HighScoreManager highScoreManager;
+    const int ZONES = 1000000;
+    const int THREADS = max(1, min(4, (int)thread::hardware_concurrency()));
 
-    int gameState;
-    int winner;
-    bool isTwoPlayer;
-    Clock gameClock;
-    Time deltaTime;
-    int flashTimer;
-    int flashPlayer;
+    vector<thread> workers;
+    vector<double> nsPerZone(THREADS);
+    for (int t = 0; t < THREADS; t++)
+    {
+        workers.push_back(thread([&nsPerZone, t]()
+        {
+            long long start = Profiler::now();
+            for (int i = 0; i < ZONES; i++)
+            {
+                PROFILE_ZONE("empty zone");
+            }
+            nsPerZone[t] = (Profiler::now() - start) * Profiler::nsPerTick() / ZONES;
+        }));
+    }
+
+    for (int t = 0; t < THREADS; t++)
+    {
+        workers[t].join();
+        cout << "thread " << t + 1 << ": " << nsPerZone[t] << " ns per zone" << endl;
+    }
+
+    long long exported = Profiler::exportTrace("profile.json");
+    cout << "Wrote " << exported << " zones to profile.json" << endl;
+    return 0;
+}
+#endif
+
+
+// Soak matches cycle through every rule set on both backends; match m uses
+// this seed, so a violation can be replayed from its match number alone
+unsigned int getSoakSeed(long long match)
+{
+    return (unsigned int)((match + 1) * 2654435761u);
+}
+
+// One soak match: step it with both sides on AI, feed the particle system
+// like the game does and check every tick. With stopAtTick >= 0 it prints
+// that tick's states instead. Returns the ticks run; violation is set on failure.
+long long runSoakMatch(long long matchIndex, ParticleSystem& particles, int stopAtTick, const char*& violation,
+                       MatchState& before, MatchState& after, unsigned int& inputs, unsigned int& events)
+{
+    const vector<RuleSet>& ruleSets = RuleSetRegistry::all();
+    const RuleSet& ruleSet = ruleSets[matchIndex % ruleSets.size()];
+    bool fixed = (matchIndex / ruleSets.size()) % 2 == 1;
+    const int MAX_TICKS = 1000000;
+
+    MatchState state;
+    FixedMatchState fixedState;
+    if (fixed == true)
+    {
+        ruleSet.resetFixed(fixedState, getSoakSeed(matchIndex));
+        state = toMatchState(fixedState);
+    }
+    else
+    {
+        ruleSet.reset(state, getSoakSeed(matchIndex));
+    }
+
+    violation = nullptr;
+    while (state.score1 < ruleSet.maxScore && state.score2 < ruleSet.maxScore)
+    {
+        before = state;
+        if (fixed == true)
+        {
+            inputs = ruleSet.aiInputFixed(fixedState, 1) | ruleSet.aiInputFixed(fixedState, 2);
+            events = ruleSet.stepFixed(fixedState, inputs);
+            state = toMatchState(fixedState);
+        }
+        else
+        {
+            inputs = ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2);
+            events = ruleSet.step(state, inputs);
+        }
+        after = state;
+
+        if ((events & EVENT_WALL_BOUNCE) != 0)
+        {
+            particles.emit(state.ballX, state.ballY, 20, 2.5f, 0, Color::White, 25);
+        }
+        if ((events & (EVENT_PADDLE1_HIT | EVENT_PADDLE2_HIT)) != 0)
+        {
+            particles.emit(state.ballX, state.ballY, 40, 3.0f, 1, GameConstants::PLAYER1_COLOR, 35);
+        }
+        if ((events & (EVENT_GOAL_P1 | EVENT_GOAL_P2)) != 0)
+        {
+            particles.emit(0, before.ballY, 300, 5.0f, 1, GameConstants::PLAYER2_COLOR, 60);
+        }
+        particles.update();
+
+        violation = SoakMonitor::checkTick(ruleSet, before, after, events);
+        if (violation == nullptr && state.tick >= MAX_TICKS)
+        {
+            violation = "match did not finish";
+        }
+        if (violation != nullptr || state.tick == stopAtTick)
+        {
+            break;
+        }
+    }
+
+    return state.tick;
+}
+
+void writeSoakState(ostream& out, const char* label, const MatchState& state)
+{
+    char line[512];
+    snprintf(line, sizeof(line), "%s: ball (%.9g, %.9g) velocity (%.9g, %.9g) paddles (%.9g, %.9g) score %d-%d tick %d random %u\n"
+             "  exact: %a %a %a %a %a %a\n", label, state.ballX, state.ballY, state.ballVelocityX, state.ballVelocityY,
+             state.paddle1Y, state.paddle2Y, state.score1, state.score2, state.tick, state.randomState,
+             state.ballX, state.ballY, state.ballVelocityX, state.ballVelocityY, state.paddle1Y, state.paddle2Y);
+    out << line;
+}
+
+void writeSoakReport(ostream& out, long long matchIndex, const char* violation, const MatchState& before,
+                     const MatchState& after, unsigned int inputs, unsigned int events)
+{
+    const vector<RuleSet>& ruleSets = RuleSetRegistry::all();
+    bool fixed = (matchIndex / ruleSets.size()) % 2 == 1;
+    out << "violation: " << (violation != nullptr ? violation : "none") << endl;
+    out << "match " << matchIndex << ", rule set " << ruleSets[matchIndex % ruleSets.size()].name << ", "
+        << (fixed == true ? "fixed-point" : "float") << " backend, seed " << getSoakSeed(matchIndex) << endl;
+    out << "inputs " << inputs << ", events " << events << endl;
+    writeSoakState(out, "before", before);
+    writeSoakState(out, "after", after);
+    out << "reproduce: p --soak-repro " << matchIndex << " " << after.tick << endl;
+}
+
+// Run AI-vs-AI matches uncapped for the given time, checking every tick, and
+// report throughput, tick-time drift, memory and allocations every ten seconds
+int runSoakTest(int seconds)
+{
+    const float REPORT_INTERVAL = 10;
+
+    ParticleSystem particles;
+    Clock clock;
+    float nextReport = REPORT_INTERVAL;
+    long long ticks = 0;
+    long long intervalTicks = 0;
+    float intervalStart = 0;
+    double baselineNsPerTick = 0;
+    long long violations = 0;
+    long long matchIndex = 0;
+    long long startRss = SoakMonitor::getResidentBytes();
+#ifdef PINGPONG_COUNT_ALLOCS
+    unsigned long long allocationsAtReport = AllocationCounter::get();
+#endif
+
+    cout << "Soak test for " << seconds << " s; a line every " << REPORT_INTERVAL << " s" << endl;
+    Metrics::startServer();
+
+    while (clock.getElapsedTime().asSeconds() < seconds)
+    {
+        MatchState before;
+        MatchState after;
+        unsigned int inputs = 0;
+        unsigned int events = 0;
+        const char* violation;
+        long long matchTicks = runSoakMatch(matchIndex, particles, -1, violation, before, after, inputs, events);
+        ticks = ticks + matchTicks;
+        intervalTicks = intervalTicks + matchTicks;
+        Metrics::addTicks(matchTicks);
+        Metrics::recordMatch();
+
+        if (violation != nullptr)
+        {
+            violations = violations + 1;
+            char path[64];
+            snprintf(path, sizeof(path), "soak_violation_%lld.txt", violations);
+            ofstream dump(path);
+            writeSoakReport(dump, matchIndex, violation, before, after, inputs, events);
+            cout << "VIOLATION in match " << matchIndex << " at tick " << after.tick << ": " << violation
+                 << " (details in " << path << ")" << endl;
+        }
+        matchIndex = matchIndex + 1;
+
+        float now = clock.getElapsedTime().asSeconds();
+        if (now >= nextReport)
+        {
+            double nsPerTick = (now - intervalStart) * 1e9 / max(1LL, intervalTicks);
+            if (baselineNsPerTick == 0)
+            {
+                baselineNsPerTick = nsPerTick;
+            }
+
+            long long rss = SoakMonitor::getResidentBytes();
+            char line[256];
+            snprintf(line, sizeof(line), "%7.0f s  %lld matches  %.1f M ticks  %.1f ns/tick (drift %+.1f%%)  RSS %.1f MB (%+.1f)",
+                     now, matchIndex, ticks / 1e6, nsPerTick, 100.0 * (nsPerTick / baselineNsPerTick - 1),
+                     rss / 1048576.0, (rss - startRss) / 1048576.0);
+            cout << line;
+#ifdef PINGPONG_COUNT_ALLOCS
+            unsigned long long allocations = AllocationCounter::get();
+            cout << "  " << allocations - allocationsAtReport << " allocations";
+            allocationsAtReport = AllocationCounter::get();
+#endif
+            cout << "  " << violations << " violations" << endl;
+
+            intervalStart = now;
+            intervalTicks = 0;
+            nextReport = now + REPORT_INTERVAL;
+        }
+    }
+
+    cout << "Soak finished: " << matchIndex << " matches, " << ticks << " ticks, " << violations << " violations" << endl;
+    return violations == 0 ? 0 : 1;
+}
+
+// Re-run one soak match up to a tick and print the states around it
+int runSoakRepro(long long matchIndex, int tick)
+{
+    ParticleSystem particles;
+    MatchState before;
+    MatchState after;
+    unsigned int inputs = 0;
+    unsigned int events = 0;
+    const char* violation;
+    runSoakMatch(matchIndex, particles, tick, violation, before, after, inputs, events);
+    writeSoakReport(cout, matchIndex, violation, before, after, inputs, events);
+    return violation == nullptr ? 0 : 1;
+}
+
+
+// Rating, record and recent matches of one player
+int runHistoryQuery(const string& path, const string& name)
+{
+    MatchHistory history;
+    if (history.load(path) == -1)
+    {
+        cout << "Error: Could not read " << path << endl;
+        return 1;
+    }
+
+    int player = history.findPlayer(name);
+    if (player == -1)
+    {
+        cout << "No matches found for " << name << " (" << history.getPlayerCount() << " players, "
+             << history.getMatchCount() << " matches)" << endl;
+        return 1;
+    }
+
+    const MatchHistory::PlayerProfile& profile = history.getPlayer(player);
+    char line[160];
+    snprintf(line, sizeof(line), "%s: rating %.0f, %d matches, %d wins, %lld - %lld points, %lld min played",
+             profile.name.c_str(), profile.rating, profile.matches, profile.wins,
+             profile.pointsFor, profile.pointsAgainst, profile.ticksPlayed / (60 * 60));
+    cout << line << endl;
+
+    int match = profile.lastMatch;
+    for (int i = 0; i < 10 && match != -1; i++)
+    {
+        const MatchHistory::MatchRecord& record = history.getMatch(match);
+        bool isPlayer1 = record.player1 == player;
+        int opponent = isPlayer1 ? record.player2 : record.player1;
+        int own = isPlayer1 ? record.score1 : record.score2;
+        int other = isPlayer1 ? record.score2 : record.score1;
+        float after = isPlayer1 ? record.rating1After : record.rating2After;
+        float change = after - history.getRatingBefore(match, player);
+
+        const char* mode = "unknown";
+        if ((record.flags & MatchHistory::FLAG_MULTI_BALL) != 0)
+        {
+            mode = "multi-ball";
+        }
+        else if (record.flags < RuleSetRegistry::all().size())
+        {
+            mode = RuleSetRegistry::all()[record.flags].name;
+        }
+
+        char date[32];
+        time_t when = (time_t)record.time;
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&when));
+        snprintf(line, sizeof(line), "  %s  %2d - %-2d vs %-12s %s %d:%02d  %.0f (%+.0f)", date, own, other,
+                 history.getPlayer(opponent).name.c_str(), mode,
+                 record.ticks / 3600, record.ticks / 60 % 60, after, change);
+        cout << line << endl;
+
+        if (isPlayer1 == true)
+        {
+            match = record.previous1;
+        }
+        else
+        {
+            match = record.previous2;
+        }
+    }
+    return 0;
+}
+
+
+// Insert, lookup and reload times for a synthetic history of the given size
+int runHistoryBenchmark(int matchCount, int playerCount)
+{
+    const char* path = "history_bench.dat";
+    remove(path);
+
+    vector<string> names(playerCount);
+    char name[32];
+    for (int i = 0; i < playerCount; i++)
+    {
+        snprintf(name, sizeof(name), "player%06d", i);
+        names[i] = name;
+    }
+
+    MatchHistory history;
+    if (history.open(path) == false)
+    {
+        cout << "Error: Could not create " << path << endl;
+        return 1;
+    }
+
+    unsigned int seed = 12345;
+    Clock clock;
+    for (int m = 0; m < matchCount; m++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int a = (int)((seed >> 8) % (unsigned int)playerCount);
+        // Never a match against yourself, which the game does not record either
+        seed = seed * 1103515245u + 12345u;
+        int b = (a + 1 + (int)((seed >> 8) % (unsigned int)(playerCount - 1))) % playerCount;
+        int loserScore = (int)(seed >> 28) % 10;
+        if ((seed & 1) == 0)
+        {
+            history.addMatch(names[a], names[b], 10, loserScore, 3000, 0);
+        }
+        else
+        {
+            history.addMatch(names[a], names[b], loserScore, 10, 3000, 0);
+        }
+    }
+    history.close();
+    double insertNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / max(1, matchCount);
 
-    // Player names
-    string player1Name;
-    string player2Name;
-    string computerName;
+    const int LOOKUPS = 1000000;
+    double ratingSum = 0;
+    clock.restart();
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int id = history.findPlayer(names[(seed >> 8) % (unsigned int)playerCount]);
+        ratingSum = ratingSum + history.getPlayer(id).rating;
+    }
+    double lookupNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / LOOKUPS;
 
-    // Name input variables
-    int nameInputState;
-    string currentInput;
-    Clock cursorBlinkClock;
-    bool cursorVisible;
-    bool nameEntered;
+    ifstream file(path, ios::binary | ios::ate);
+    long long fileBytes = (long long)file.tellg();
+    file.close();
 
-public:
-    GameManager()
+    MatchHistory reloaded;
+    clock.restart();
+    reloaded.load(path);
+    double loadMs = clock.getElapsedTime().asMicroseconds() / 1000.0;
+
+    bool same = reloaded.getMatchCount() == history.getMatchCount() &&
+                reloaded.getPlayerCount() == history.getPlayerCount();
+    for (int i = 0; i < history.getPlayerCount() && same == true; i++)
     {
-        // Create window
-        gameWindow.create(VideoMode(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT),
-                         "A Ping Pong Game ");
+        same = reloaded.getPlayer(i).rating == history.getPlayer(i).rating;
+    }
 
-        // Initialize game objects
-        player1 = new Paddle(1);
-        player2 = new Paddle(2);
-        gameBall = new Ball();
+    cout << matchCount << " matches, " << playerCount << " players, "
+         << fileBytes / (1024.0 * 1024.0) << " MB on disk" << endl;
+    cout << "  insert  " << insertNs << " ns/match" << endl;
+    cout << "  lookup  " << lookupNs << " ns/lookup (mean rating " << ratingSum / LOOKUPS << ")" << endl;
+    cout << "  reload  " << loadMs << " ms, ratings " << (same ? "identical" : "DIFFERENT") << endl;
 
-        // Game state
-        gameState = 0;
-        winner = 0;
-        isTwoPlayer = true;
-        flashTimer = 0;
-        flashPlayer = 0;
+    remove(path);
+    if (same == false)
+    {
+        return 1;
+    }
+    return 0;
+}
 
-        // Initialize player names with default values
-        player1Name = "Player 1";
-        player2Name = "Player 2";
-        computerName = "Computer";
 
-        // Name input initialization
-        nameInputState = 0;
-        currentInput = "";
-        cursorVisible = true;
-        nameEntered = false;
+// One configuration of a balancing sweep and what its matches did.
+// Rally lengths go in power-of-two buckets of paddle hits (0, 1, 2-3, 4-7, ...)
+// and match lengths in power-of-two buckets of ticks from 1024 up.
+struct SweepResult
+{
+    static const int PARAMETERS = 5;
+    static const int BUCKETS = 16;
+
+    float parameters[PARAMETERS];
+    uint32_t finished;
+    uint32_t unfinished;
+    uint32_t player1Wins;
+    uint64_t ticks;
+    uint64_t rallies;
+    uint64_t hits;
+    uint32_t rallyBuckets[BUCKETS];
+    uint32_t matchBuckets[BUCKETS];
+};
 
-        // Window settings
-        gameWindow.setFramerateLimit(60);
-        gameWindow.setKeyRepeatEnabled(false);
+// Results files hold SweepResult records as laid out here: little-endian, no padding
+static_assert(sizeof(SweepResult) == 184, "SweepResult is written to results files as is");
 
-        // Seed random number generator
-        srand(static_cast<unsigned int>(time(0)));
+// Parameters a sweep varies, with their range relative to the base rule set
+struct SweepParameter
+{
+    const char* name;
+    float DynamicRules::*field;
+    float minScale;
+    float maxScale;
+};
 
-        cout << "Game initialized successfully!" << endl;
-        cout << "Window size: " << GameConstants::WINDOW_WIDTH << "x" << GameConstants::WINDOW_HEIGHT << endl;
-    }
+const SweepParameter SWEEP_PARAMETERS[SweepResult::PARAMETERS] =
+{
+    { "ball_speed", &DynamicRules::BALL_SPEED, 0.5f, 1.5f },
+    { "paddle_speed", &DynamicRules::PADDLE_SPEED, 0.5f, 1.5f },
+    { "paddle_height", &DynamicRules::PADDLE_HEIGHT, 0.5f, 1.5f },
+    { "speed_up", &DynamicRules::SPEED_UP, 1.0f / 1.05f, 1.1f / 1.05f },
+    { "ai_dead_zone", &DynamicRules::AI_DEAD_ZONE, 0.0f, 2.0f }
+};
 
-    ~GameManager()
+int getSweepBucket(uint64_t value)
+{
+    int bucket = 0;
+    while (value > 0 && bucket < SweepResult::BUCKETS - 1)
     {
-        delete player1;
-        delete player2;
-        delete gameBall;
-        cout << "Game cleaned up successfully!" << endl;
+        value = value >> 1;
+        bucket = bucket + 1;
     }
+    return bucket;
+}
 
-    // Main game loop
-    void run()
+// Play computer-vs-computer matches on one configuration; the same seeds are
+// used for every configuration, so differences come from the parameters
+void runSweepConfiguration(const DynamicRules& rules, int matches, SweepResult& result)
+{
+    // A match where neither side can miss is given up on after about an hour of play
+    const int MAX_TICKS = 200000;
+
+    result.finished = 0;
+    result.unfinished = 0;
+    result.player1Wins = 0;
+    result.ticks = 0;
+    result.rallies = 0;
+    result.hits = 0;
+    for (int b = 0; b < SweepResult::BUCKETS; b++)
     {
-        while (gameWindow.isOpen())
-        {
-            handleEvents();
-            update();
-            render();
-        }
+        result.rallyBuckets[b] = 0;
+        result.matchBuckets[b] = 0;
     }
 
-    // Handle input events
-    void handleEvents()
+    MatchState state;
+    for (int m = 0; m < matches; m++)
     {
-        Event event;
-        while (gameWindow.pollEvent(event))
+        MatchSimulation<DynamicRules>::reset(state, 5000 + m, rules);
+        int rallyHits = 0;
+        while (MatchSimulation<DynamicRules>::getWinner(state, rules) == 0 && state.tick < MAX_TICKS)
         {
-            if (event.type == Event::Closed)
+            unsigned int inputs = MatchSimulation<DynamicRules>::aiInput(state, 1, rules) |
+                                  MatchSimulation<DynamicRules>::aiInput(state, 2, rules);
+            unsigned int events = MatchSimulation<DynamicRules>::step(state, inputs, rules);
+
+            if ((events & (EVENT_PADDLE1_HIT | EVENT_PADDLE2_HIT)) != 0)
             {
-                gameWindow.close();
+                rallyHits = rallyHits + 1;
             }
-
-            // Keyboard presses
-            if (event.type == Event::KeyPressed)
+            if ((events & (EVENT_GOAL_P1 | EVENT_GOAL_P2)) != 0)
             {
-                handleKeyPress(event.key.code);
+                result.rallyBuckets[getSweepBucket(rallyHits)]++;
+                result.rallies = result.rallies + 1;
+                result.hits = result.hits + rallyHits;
+                rallyHits = 0;
             }
         }
-    }
 
-    // Handle keyboard input
-    void handleKeyPress(Keyboard::Key key)
-    {
-        // If we're getting player names
-        if (nameInputState > 0)
+        int winner = MatchSimulation<DynamicRules>::getWinner(state, rules);
+        if (winner == 0)
         {
-            handleNameInputKey(key);
-            return;
+            result.unfinished = result.unfinished + 1;
+            continue;
         }
 
-        if (gameState == 0)
+        result.finished = result.finished + 1;
+        if (winner == 1)
         {
-            handleMenuInput(key);
+            result.player1Wins = result.player1Wins + 1;
         }
-        else if (gameState == 1)
+        result.ticks = result.ticks + state.tick;
+        result.matchBuckets[getSweepBucket((uint64_t)state.tick >> 10)]++;
+    }
+}
+
+// Run a grid (steps per parameter) or a random sample (count configurations) of
+// the balancing parameters around a rule set, on every core, into a results file
+int runParameterSweep(const string& ruleSetName, bool grid, int size, int matches, const string& path)
+{
+    const RuleSet* base = RuleSetRegistry::find(ruleSetName);
+    if (base == nullptr || size < 1 || matches < 1)
+    {
+        cout << "Error: usage is --sweep <rule set> grid|random <steps|configurations> <matches> <output>" << endl;
+        return 1;
+    }
+    if (grid == true && size == 1)
+    {
+        cout << "Error: a grid needs at least 2 steps per parameter" << endl;
+        return 1;
+    }
+
+    vector<SweepResult> results;
+    if (grid == true)
+    {
+        int count = 1;
+        for (int p = 0; p < SweepResult::PARAMETERS; p++)
         {
-            handleGameInput(key);
+            count = count * size;
         }
-        else if (gameState == 2)
+        results.resize(count);
+        for (int c = 0; c < count; c++)
         {
-            if (key == Keyboard::P || key == Keyboard::Escape)
+            int index = c;
+            for (int p = 0; p < SweepResult::PARAMETERS; p++)
             {
-                gameState = 1;
+                float t = (float)(index % size) / (size - 1);
+                index = index / size;
+                const SweepParameter& parameter = SWEEP_PARAMETERS[p];
+                float scale = parameter.minScale + (parameter.maxScale - parameter.minScale) * t;
+                results[c].parameters[p] = base->values.*parameter.field * scale;
             }
         }
-        else if (gameState == 3)
-        {
-            handleGameOverInput(key);
-        }
-        else if (gameState == 4)
+    }
+    else
+    {
+        results.resize(size);
+        unsigned int seed = 2024;
+        for (int c = 0; c < size; c++)
         {
-            if (key == Keyboard::Space || key == Keyboard::Escape)
+            for (int p = 0; p < SweepResult::PARAMETERS; p++)
             {
-                gameState = 0;
+                seed = seed * 1103515245u + 12345u;
+                float t = (seed >> 8) / 16777215.0f;
+                const SweepParameter& parameter = SWEEP_PARAMETERS[p];
+                float scale = parameter.minScale + (parameter.maxScale - parameter.minScale) * t;
+                results[c].parameters[p] = base->values.*parameter.field * scale;
             }
         }
     }
 
-    // Handle name input keys
-    void handleNameInputKey(Keyboard::Key key)
+    int configCount = (int)results.size();
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    cout << "Sweeping " << configCount << " configurations of " << base->name << ", " << matches
+         << " matches each, on " << threadCount << " threads" << endl;
+
+    // Threads take the next configuration as they finish, since some play far longer than others
+    atomic<int> nextConfig(0);
+    atomic<int> doneConfigs(0);
+    Clock clock;
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++)
     {
-        if (key == Keyboard::Enter)
+        workers.push_back(thread([&]()
         {
-            // Save the entered name
-            if (nameInputState == 1)
+            while (true)
             {
-                // Player 1 name
-                if (currentInput.empty() == false)
+                int c = nextConfig.fetch_add(1);
+                if (c >= configCount)
                 {
-                    player1Name = currentInput;
+                    return;
                 }
 
-                if (isTwoPlayer == true)
-                {
-
-                    nameInputState = 2;
-                    currentInput = "";
-                    nameEntered = false;
-                }
-                else
-                {
-                    // Single player mode, start game
-                    nameInputState = 0;
-                    startNewGame();
-                }
-            }
-            else if (nameInputState == 2)
-            {
-                // Player 2 name
-                if (currentInput.empty() == false)
+                DynamicRules rules = base->values;
+                for (int p = 0; p < SweepResult::PARAMETERS; p++)
                 {
-                    player2Name = currentInput;
+                    rules.*SWEEP_PARAMETERS[p].field = results[c].parameters[p];
                 }
+                // Keep the serve below the speed cap that stops the ball passing through paddles
+                rules.BALL_SPEED = min(rules.BALL_SPEED, rules.MAX_BALL_SPEED);
+                results[c].parameters[0] = rules.BALL_SPEED;
 
-                // Start the game
-                nameInputState = 0;
-                startNewGame();
-            }
-        }
-        else if (key == Keyboard::Escape)
-        {
-            // Cancel name input
-            nameInputState = 0;
-            currentInput = "";
-        }
-        else if (key == Keyboard::BackSpace)
-        {
-            // Remove last character
-            if (currentInput.empty() == false)
-            {
-                currentInput = currentInput.substr(0, currentInput.length() - 1);
-            }
-        }
-        else
-        {
-            // Check for letter keys
-            if (key >= Keyboard::A && key <= Keyboard::Z)
-            {
-                char c = 'A' + (key - Keyboard::A);
-                if (currentInput.length() < 10)
-                {
-                    currentInput = currentInput + c;
-                }
-            }
-            else if (key >= Keyboard::Num0 && key <= Keyboard::Num9)
-            {
-                char c = '0' + (key - Keyboard::Num0);
-                if (currentInput.length() < 10)
-                {
-                    currentInput = currentInput + c;
-                }
-            }
-            else if (key == Keyboard::Space)
-            {
-                if (currentInput.length() < 10 && currentInput.empty() == false)
-                {
-                    currentInput = currentInput + " ";
-                }
+                runSweepConfiguration(rules, matches, results[c]);
+                doneConfigs.fetch_add(1);
             }
-        }
+        }));
     }
 
-    // Handle menu input
-    void handleMenuInput(Keyboard::Key key)
+    int reported = 0;
+    while (reported < configCount)
     {
-        if (key == Keyboard::Num1 || key == Keyboard::Enter)
-        {
-            isTwoPlayer = true;
-            // Start getting player names
-            nameInputState = 1;
-            currentInput = "";
-            cursorVisible = true;
-            nameEntered = false;
-            cursorBlinkClock.restart();
-        }
-        else if (key == Keyboard::Num2)
-        {
-            isTwoPlayer = false;
-            // Start getting player 1 name only
-            nameInputState = 1;
-            currentInput = "";
-            cursorVisible = true;
-            nameEntered = false;
-            cursorBlinkClock.restart();
-        }
-        else if (key == Keyboard::Num3)
-        {
-            gameState = 4;
-        }
-        else if (key == Keyboard::Num4)
-        {
-            loadGame();
-        }
-        else if (key == Keyboard::Escape)
+        this_thread::sleep_for(chrono::milliseconds(100));
+        int done = doneConfigs.load();
+        if (done * 10 / configCount > reported * 10 / configCount || done == configCount)
         {
-            gameWindow.close();
+            double seconds = clock.getElapsedTime().asMicroseconds() / 1e6;
+            cout << "  " << done << " / " << configCount << " configurations, " << seconds << " s" << endl;
         }
+        reported = done;
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
     }
 
-    // Handle in game input
-    void handleGameInput(Keyboard::Key key)
+    ofstream file(path, ios::binary);
+    if (!file)
     {
-        if (key == Keyboard::Escape || key == Keyboard::P)
-        {
-            gameState = 2;
-        }
-        else if (key == Keyboard::R)
-        {
-            resetGame();
-        }
-        else if (key == Keyboard::S)
-        {
-            saveGame();
-        }
+        cout << "Error: Could not write " << path << endl;
+        return 1;
     }
 
-    // Handle game over input
-    void handleGameOverInput(Keyboard::Key key)
+    // Header: magic, version, configuration count, matches per configuration, base rule set
+    char header[32] = { 'P', 'S', 'W', 'P' };
+    uint32_t fields[3] = { 1, (uint32_t)configCount, (uint32_t)matches };
+    memcpy(header + 4, fields, sizeof(fields));
+    strncpy(header + 16, base->name, 15);
+    file.write(header, sizeof(header));
+    file.write((const char*)results.data(), results.size() * sizeof(SweepResult));
+    file.close();
+
+    cout << "Wrote " << path << " (" << (sizeof(header) + results.size() * sizeof(SweepResult)) / 1024
+         << " KB)" << endl;
+    return 0;
+}
+
+
+// One line per configuration of a sweep results file, ready for sort or a spreadsheet
+int runSweepReport(const string& path)
+{
+    ifstream file(path, ios::binary);
+    char header[32];
+    uint32_t fields[3];
+    if (!file || !file.read(header, sizeof(header)) || memcmp(header, "PSWP", 4) != 0)
     {
-        if (key == Keyboard::Enter || key == Keyboard::Space)
-        {
-            gameState = 0;
-        }
-        else if (key == Keyboard::R)
-        {
-            startNewGame();
-        }
+        cout << "Error: " << path << " is not a sweep results file" << endl;
+        return 1;
+    }
+    memcpy(fields, header + 4, sizeof(fields));
+    if (fields[0] != 1)
+    {
+        cout << "Error: unsupported sweep results version " << fields[0] << endl;
+        return 1;
     }
 
-    // Update game logic
-    void update()
+    header[31] = 0;
+    cout << fields[1] << " configurations of " << header + 16 << ", " << fields[2] << " matches each" << endl;
+    for (int p = 0; p < SweepResult::PARAMETERS; p++)
     {
-        // Update cursor blink for name input
-        if (nameInputState > 0)
-        {
-            Time elapsed = cursorBlinkClock.getElapsedTime();
-            if (elapsed.asMilliseconds() > 500)
-            {
-                cursorVisible = !cursorVisible;
-                cursorBlinkClock.restart();
-            }
-        }
+        cout << SWEEP_PARAMETERS[p].name << " ";
+    }
+    cout << "mean_rally_hits median_rally_bucket mean_match_s p1_win_rate unfinished" << endl;
 
-        if (gameState != 1)
+    SweepResult result;
+    char line[256];
+    for (uint32_t c = 0; c < fields[1] && file.read((char*)&result, sizeof(result)); c++)
+    {
+        // Lower edge of the bucket holding the median rally
+        uint64_t seen = 0;
+        int median = 0;
+        while (median < SweepResult::BUCKETS - 1 && (seen + result.rallyBuckets[median]) * 2 < result.rallies)
         {
-            return;
+            seen = seen + result.rallyBuckets[median];
+            median = median + 1;
         }
+        int medianHits = median == 0 ? 0 : 1 << (median - 1);
+
+        snprintf(line, sizeof(line), "%.3g %.3g %.3g %.4g %.3g %.2f %d %.1f %.3f %u",
+                 result.parameters[0], result.parameters[1], result.parameters[2],
+                 result.parameters[3], result.parameters[4],
+                 result.hits / (double)max((uint64_t)1, result.rallies), medianHits,
+                 result.ticks / 60.0 / max(1u, result.finished),
+                 result.player1Wins / (double)max(1u, result.finished), result.unfinished);
+        cout << line << endl;
+    }
+    return 0;
+}
+
+
+// Turn a flight recording into a text trace: each run of consecutive ticks starts
+// with its full state, and every tick lists its inputs, events, frame time and state.
+// Runs are re-simulated from their first tick to check the trace replays exactly.
+int runFlightDecode(const string& path, const string& output)
+{
+    vector<FlightRecord> records;
+    int64_t startTime;
+    if (FlightRecorder::read(path, records, startTime) == false)
+    {
+        cout << "Error: " << path << " is not a flight recording" << endl;
+        return 1;
+    }
 
-        // Update ball
-        gameBall->update();
+    ofstream out(output);
+    if (!out)
+    {
+        cout << "Error: Could not write " << output << endl;
+        return 1;
+    }
 
-        // Player 1 controls (W/S keys)
-        if (Keyboard::isKeyPressed(Keyboard::W))
+    char started[32];
+    time_t when = (time_t)startTime;
+    strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", localtime(&when));
+    out << "# flight recording of " << path << ", session started " << started << endl;
+    out << "# sequence time_ms frame_us inputs events ballX ballY velocityX velocityY paddle1Y paddle2Y "
+        << "score1 score2 tick random" << endl;
+
+    const vector<RuleSet>& ruleSets = RuleSetRegistry::all();
+    int segments = 0;
+    long long replayed = 0;
+    long long mismatches = 0;
+    uint32_t worstFrame = 0;
+    long long slowFrames = 0;
+    char line[256];
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const FlightRecord& record = records[i];
+        bool fixed = (record.flags & FlightRecorder::FLAG_FIXED_POINT) != 0;
+        bool multiBall = (record.flags & FlightRecorder::FLAG_MULTI_BALL) != 0;
+        if (record.ruleSet >= ruleSets.size())
         {
-            player1->moveUp();
+            continue;
         }
-
-        if (Keyboard::isKeyPressed(Keyboard::D))
+        const RuleSet& ruleSet = ruleSets[record.ruleSet];
+
+        MatchState state;
+        FixedMatchState fixedState;
+        memcpy(&state, record.state, sizeof(state));
+        memcpy(&fixedState, record.state, sizeof(fixedState));
+
+        bool continues = i > 0 && records[i - 1].sequence + 1 == record.sequence &&
+                         records[i - 1].ruleSet == record.ruleSet &&
+                         (records[i - 1].flags & ~FlightRecorder::FLAG_MATCH_START) ==
+                         (record.flags & ~FlightRecorder::FLAG_MATCH_START) &&
+                         (record.flags & FlightRecorder::FLAG_MATCH_START) == 0;
+        if (continues == false)
         {
-            player1->moveDown();
+            segments = segments + 1;
+            const char* backend = multiBall ? "multi-ball" : (fixed ? "fixed-point" : "float");
+            const char* players = (record.flags & FlightRecorder::FLAG_TWO_PLAYER) != 0 ? "two players" : "one player";
+            out << "segment " << segments << " " << ruleSet.name << " " << backend << " " << players;
+            if ((record.flags & FlightRecorder::FLAG_MATCH_START) != 0)
+            {
+                out << " match start";
+            }
+            out << endl;
         }
-
-        // Player 2 controls
-        if (isTwoPlayer == true)
+        else if (multiBall == false)
         {
-            if (Keyboard::isKeyPressed(Keyboard::Up))
+            // Step the previous tick's state with this tick's inputs; it must give this state exactly
+            bool same;
+            if (fixed == true)
+            {
+                FixedMatchState expected;
+                memcpy(&expected, records[i - 1].state, sizeof(expected));
+                ruleSet.stepFixed(expected, record.inputs);
+                same = memcmp(&expected, record.state, sizeof(expected)) == 0;
+            }
+            else
             {
-                player2->moveUp();
+                MatchState expected;
+                memcpy(&expected, records[i - 1].state, sizeof(expected));
+                ruleSet.step(expected, record.inputs);
+                same = memcmp(&expected, record.state, sizeof(expected)) == 0;
             }
 
-            if (Keyboard::isKeyPressed(Keyboard::Down))
+            replayed = replayed + 1;
+            if (same == false)
             {
-                player2->moveDown();
+                if (mismatches == 0)
+                {
+                    cout << "First replay mismatch at sequence " << record.sequence << endl;
+                }
+                mismatches = mismatches + 1;
+                out << "# replay mismatch" << endl;
             }
         }
-        else
-        {
-            controlAI();
-        }
 
-        // Check collisions
-        checkCollisions();
-
-        // Check if ball is out of bounds
-        if (gameBall->isOutOfBounds() == true)
+        worstFrame = max(worstFrame, record.frameMicros);
+        if (record.frameMicros > 20000)
         {
-            handleScore();
+            slowFrames = slowFrames + 1;
         }
 
-        // Check for winner
-        if (player1->getScore() >= GameConstants::MAX_SCORE)
+        if (fixed == true)
         {
-            winner = 1;
-            gameState = 3;
-            checkHighScore(player1->getScore());
+            snprintf(line, sizeof(line), "%llu %u %u %x %x %d %d %d %d %d %d %d %d %d %u",
+                     (unsigned long long)record.sequence, record.timeMs, record.frameMicros, record.inputs, record.events,
+                     fixedState.ballX, fixedState.ballY, fixedState.ballVelocityX, fixedState.ballVelocityY,
+                     fixedState.paddle1Y, fixedState.paddle2Y, fixedState.score1, fixedState.score2,
+                     fixedState.tick, fixedState.randomState);
         }
-        else if (player2->getScore() >= GameConstants::MAX_SCORE)
+        else
         {
-            winner = 2;
-            gameState = 3;
-            checkHighScore(player2->getScore());
+            snprintf(line, sizeof(line), "%llu %u %u %x %x %.9g %.9g %.9g %.9g %.9g %.9g %d %d %d %u",
+                     (unsigned long long)record.sequence, record.timeMs, record.frameMicros, record.inputs, record.events,
+                     state.ballX, state.ballY, state.ballVelocityX, state.ballVelocityY,
+                     state.paddle1Y, state.paddle2Y, state.score1, state.score2, state.tick, state.randomState);
         }
+        out << line << endl;
+    }
 
-        // Update flash timer
-        updateFlashEffect();
+    double seconds = 0;
+    if (records.empty() == false)
+    {
+        seconds = (records.back().timeMs - records.front().timeMs) / 1000.0;
+    }
+    cout << records.size() << " ticks in " << segments << " segments covering " << seconds << " s" << endl;
+    cout << "Replayed " << replayed << " ticks, " << mismatches << " mismatches" << endl;
+    cout << "Worst frame " << worstFrame / 1000.0 << " ms, " << slowFrames << " frames over 20 ms" << endl;
+    cout << "Trace written to " << output << endl;
+
+    if (mismatches > 0)
+    {
+        return 1;
     }
+    return 0;
+}
 
-    // Control AI for single player mode
-    void controlAI()
+
+// Cost of recording one tick, written to a scratch recording
+int runFlightRecorderBenchmark()
+{
+    const int TICKS = 10000000;
+    FlightRecorder recorder;
+    if (recorder.open("flight_bench.rec") == false)
     {
-        float ballCenterY = gameBall->getY() + GameConstants::BALL_RADIUS;
-        float paddleCenterY = player2->getCenterY();
+        cout << "Error: Could not create flight_bench.rec" << endl;
+        return 1;
+    }
 
-        if (ballCenterY < paddleCenterY - 20)
+    const RuleSet& ruleSet = RuleSetRegistry::all()[0];
+    MatchState state;
+    ruleSet.reset(state, 77);
+
+    // Time the simulation alone first, so the recorder's share can be separated out
+    Clock clock;
+    for (int i = 0; i < TICKS; i++)
+    {
+        unsigned int inputs = ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2);
+        ruleSet.step(state, inputs);
+        if (ruleSet.getWinner(state) != 0)
         {
-            player2->moveUp();
+            ruleSet.reset(state, i);
         }
-        else if (ballCenterY > paddleCenterY + 20)
+    }
+    double simulationNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / TICKS;
+
+    ruleSet.reset(state, 77);
+    clock.restart();
+    for (int i = 0; i < TICKS; i++)
+    {
+        unsigned int inputs = ruleSet.aiInput(state, 1) | ruleSet.aiInput(state, 2);
+        unsigned int events = ruleSet.step(state, inputs);
+        recorder.record(&state, inputs, events, 0, 0, 16667);
+        if (ruleSet.getWinner(state) != 0)
         {
-            player2->moveDown();
+            ruleSet.reset(state, i);
         }
     }
+    double recordedNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / TICKS;
+    recorder.close();
+
+    remove("flight_bench.rec");
+    remove("flight_bench.rec.prev");
+
+    cout << "Simulation only:    " << simulationNs << " ns/tick" << endl;
+    cout << "With flight record: " << recordedNs << " ns/tick (+" << recordedNs - simulationNs << " ns)" << endl;
+    return 0;
+}
 
-    // Check for collisions between ball and paddles
-    void checkCollisions()
+
+// Timer wheel under load: every timer re-arms itself when it fires, as
+// power-ups and particle effects would, and a share is cancelled early.
+// A countdown array scanned every tick is timed alongside for comparison.
+struct TimerBenchmark
+{
+    TimerWheel* wheel;
+    unsigned int randomState;
+    long long fired;
+
+    int nextDelay()
     {
-        // Check collision with player 1 paddle
-        float ballX = gameBall->getX();
-        float ballY = gameBall->getY();
-        float ballWidth = gameBall->getWidth();
-        float ballHeight = gameBall->getHeight();
+        randomState = randomState * 1664525 + 1013904223;
+        return 1 + (int)((randomState >> 8) % 1200);
+    }
 
-        float p1X = player1->getX();
-        float p1Y = player1->getY();
-        float p1Width = player1->getWidth();
-        float p1Height = player1->getHeight();
+    static void onFire(void* owner, int value)
+    {
+        TimerBenchmark* bench = (TimerBenchmark*)owner;
+        bench->fired = bench->fired + 1;
+        bench->wheel->schedule(bench->nextDelay(), &TimerBenchmark::onFire, owner, value);
+    }
+};
 
-        bool collisionP1 = false;
+int runTimerBenchmark(int timerCount, int ticks)
+{
+    TimerWheel wheel(timerCount);
+    TimerBenchmark bench;
+    bench.wheel = &wheel;
+    bench.randomState = 12345;
+    bench.fired = 0;
+
+    Clock clock;
+    vector<uint64_t> ids(timerCount);
+    for (int i = 0; i < timerCount; i++)
+    {
+        ids[i] = wheel.schedule(bench.nextDelay(), &TimerBenchmark::onFire, &bench, i);
+    }
+    double scheduleNs = clock.restart().asMicroseconds() * 1000.0 / timerCount;
 
-        if (ballX < p1X + p1Width)
+    // Cancel and re-arm a tenth of them
+    int cancelled = 0;
+    for (int i = 0; i < timerCount; i = i + 10)
+    {
+        if (wheel.cancel(ids[i]) == true)
         {
-            if (ballX + ballWidth > p1X)
-            {
-                if (ballY < p1Y + p1Height)
-                {
-                    if (ballY + ballHeight > p1Y)
-                    {
-                        collisionP1 = true;
-                    }
-                }
-            }
+            cancelled = cancelled + 1;
         }
+        wheel.schedule(bench.nextDelay(), &TimerBenchmark::onFire, &bench, i);
+    }
+    double cancelNs = clock.restart().asMicroseconds() * 1000.0 / max(1, cancelled);
+
+    for (int t = 0; t < ticks; t++)
+    {
+        wheel.advance(1);
+    }
+    double wheelUs = clock.restart().asMicroseconds() / (double)ticks;
 
-        if (collisionP1 == true)
+    // The same load as countdowns decremented every tick
+    vector<int> countdowns(timerCount);
+    for (int i = 0; i < timerCount; i++)
+    {
+        countdowns[i] = bench.nextDelay();
+    }
+    long long scanFired = 0;
+    clock.restart();
+    for (int t = 0; t < ticks; t++)
+    {
+        for (int i = 0; i < timerCount; i++)
         {
-            gameBall->bounceFromPaddle(*player1);
-            gameSounds.playPaddleHit();
+            countdowns[i] = countdowns[i] - 1;
+            if (countdowns[i] == 0)
+            {
+                scanFired = scanFired + 1;
+                countdowns[i] = bench.nextDelay();
+            }
         }
+    }
+    double scanUs = clock.getElapsedTime().asMicroseconds() / (double)ticks;
+
+    cout << timerCount << " timers over " << ticks << " ticks: " << wheel.getPending() << " pending, "
+         << bench.fired << " fired (scan fired " << scanFired << ")" << endl;
+    cout << "Schedule: " << scheduleNs << " ns, cancel: " << cancelNs << " ns" << endl;
+    cout << "Wheel tick: " << wheelUs << " us, countdown scan tick: " << scanUs << " us" << endl;
+    return 0;
+}
+
+
+// Write a hand-set network that plays like the built-in tracker without its aim
+// error: two hidden units measure how far the ball is above or below the paddle,
+// less the rule set's dead zone. It is a working example of the file format and
+// a baseline for trained policies; the unused units are zero.
+int runPolicyBaseline(const string& path, const string& ruleSetName)
+{
+    const RuleSet* ruleSet = RuleSetRegistry::find(ruleSetName);
+    if (ruleSet == nullptr)
+    {
+        cout << "Error: unknown rule set " << ruleSetName << endl;
+        return 1;
+    }
+
+    PaddlePolicy policy;
+    const int sizes[3] = { 16, 16, PaddlePolicy::OUTPUTS };
+    policy.create(3, sizes);
+
+    float deadZone = ruleSet->values.AI_DEAD_ZONE / ruleSet->values.COURT_HEIGHT;
+    policy.setWeight(0, 0, 1, 1);
+    policy.setWeight(0, 0, 4, -1);
+    policy.setBias(0, 0, -deadZone);
+    policy.setWeight(0, 1, 1, -1);
+    policy.setWeight(0, 1, 4, 1);
+    policy.setBias(0, 1, -deadZone);
+    policy.setWeight(1, 0, 0, 1);
+    policy.setWeight(1, 1, 1, 1);
+    policy.setWeight(2, 0, 1, 1);
+    policy.setWeight(2, 2, 0, 1);
+
+    if (policy.save(path) == false)
+    {
+        cout << "Error: Could not write " << path << endl;
+        return 1;
+    }
+    cout << "Wrote an 8-16-16-3 tracker for " << ruleSet->name << " to " << path << endl;
+    return 0;
+}
+
+// Play the policy (right paddle) against the built-in computer player in many
+// matches at once. Every tick, one batched call decides for all running matches.
+int runPolicyEvaluation(const string& path, int matchCount, const string& ruleSetName)
+{
+    const int MAX_TICKS = 200000;
+    const RuleSet* ruleSet = RuleSetRegistry::find(ruleSetName);
+    if (ruleSet == nullptr)
+    {
+        cout << "Error: unknown rule set " << ruleSetName << endl;
+        return 1;
+    }
+
+    PaddlePolicy policy;
+    if (policy.load(path) == false)
+    {
+        cout << "Error: Could not load a paddle policy from " << path << endl;
+        return 1;
+    }
 
+    vector<MatchState> states(matchCount);
+    vector<unsigned int> inputs(matchCount);
+    for (int i = 0; i < matchCount; i++)
+    {
+        ruleSet->reset(states[i], 1000 + i);
+    }
 
-        float p2X = player2->getX();
-        float p2Y = player2->getY();
-        float p2Width = player2->getWidth();
-        float p2Height = player2->getHeight();
+    int running = matchCount;
+    int wins = 0;
+    int losses = 0;
+    long long pointsFor = 0;
+    long long pointsAgainst = 0;
 
-        bool collisionP2 = false;
+    for (int tick = 0; tick < MAX_TICKS && running > 0; tick++)
+    {
+        policy.decideBatch(states.data(), running, 2, ruleSet->values, inputs.data());
 
-        if (ballX < p2X + p2Width)
+        // Finished matches are swapped to the end, so the running ones stay one batch
+        for (int i = 0; i < running; i++)
         {
-            if (ballX + ballWidth > p2X)
+            ruleSet->step(states[i], inputs[i] | ruleSet->aiInput(states[i], 1));
+            int winner = ruleSet->getWinner(states[i]);
+            if (winner != 0)
             {
-                if (ballY < p2Y + p2Height)
+                if (winner == 2)
                 {
-                    if (ballY + ballHeight > p2Y)
-                    {
-                        collisionP2 = true;
-                    }
+                    wins = wins + 1;
+                }
+                else
+                {
+                    losses = losses + 1;
                 }
+                pointsFor = pointsFor + states[i].score2;
+                pointsAgainst = pointsAgainst + states[i].score1;
+                running = running - 1;
+                swap(states[i], states[running]);
+                i = i - 1;
             }
         }
+    }
 
-        if (collisionP2 == true)
-        {
-            gameBall->bounceFromPaddle(*player2);
-            gameSounds.playPaddleHit();
-        }
+    // Decision cost for the whole batch at once, then one at a time as the game makes them
+    const int DECISIONS = 4000000;
+    for (int i = 0; i < matchCount; i++)
+    {
+        ruleSet->reset(states[i], 1000 + i);
+    }
+    unsigned int checksum = 0;
+    Clock clock;
+    for (int done = 0; done < DECISIONS; done = done + matchCount)
+    {
+        policy.decideBatch(states.data(), matchCount, 2, ruleSet->values, inputs.data());
+        checksum = checksum + inputs[0];
     }
+    double batchNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / ((DECISIONS + matchCount - 1) / matchCount * matchCount);
 
+    MatchState state = states[0];
+    clock.restart();
+    for (int i = 0; i < DECISIONS; i++)
+    {
+        state.ballY = (float)(i % 600);
+        checksum = checksum + policy.decide(state, 2, ruleSet->values);
+    }
+    double singleNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / DECISIONS;
 
-    void handleScore()
+    cout << "Policy ";
+    for (int layer = 0; layer <= policy.getLayerCount(); layer++)
     {
-        int outSide = gameBall->getOutSide();
+        cout << (layer > 0 ? "-" : "") << policy.getSize(layer);
+    }
+    cout << " on " << ruleSet->name << ": " << wins << " won, " << losses << " lost, " << running
+         << " unfinished after " << MAX_TICKS << " ticks" << endl;
+    cout << "Points: " << pointsFor << " for, " << pointsAgainst << " against" << endl;
+    cout << "Batch of " << matchCount << ": " << batchNs << " ns/decision, one at a time: " << singleNs
+         << " ns/decision (checksum " << checksum % 100 << ")" << endl;
+    return 0;
+}
 
-        if (outSide == 1)
-        {
-            player2->incrementScore();
-            gameSounds.playScore();
-            flashPlayer = 2;
-            flashTimer = 30;
-        }
-        else if (outSide == 2)
-        {
-            player1->incrementScore();
-            gameSounds.playScore();
-            flashPlayer = 1;
-            flashTimer = 30;
-        }
 
-        gameBall->reset();
-        player1->resetPosition();
-        player2->resetPosition();
+// Play computer-vs-computer matches, alternating float and fixed-point physics,
+// and store them all in one replay archive
+int runReplayPack(const string& path, int matchCount, const string& ruleSetName)
+{
+    const RuleSet* ruleSet = RuleSetRegistry::find(ruleSetName);
+    if (ruleSet == nullptr)
+    {
+        cout << "Error: unknown rule set " << ruleSetName << endl;
+        return 1;
     }
+    int ruleSetIndex = (int)(ruleSet - &RuleSetRegistry::all()[0]);
 
-    // Update flash effect for scoring
-    void updateFlashEffect()
+    ReplayArchive archive;
+    if (archive.create(path) == false)
     {
-        if (flashTimer > 0)
-        {
-            flashTimer = flashTimer - 1;
+        cout << "Error: Could not create " << path << endl;
+        return 1;
+    }
 
-            if (flashPlayer == 1)
-            {
-                player1->flash();
-            }
-            else if (flashPlayer == 2)
-            {
-                player2->flash();
-            }
+    long long ticks = 0;
+    Clock clock;
+    for (int m = 0; m < matchCount; m++)
+    {
+        HeadlessMatch match;
+        match.play(*ruleSet, 7000 + m, 200000, m % 2 == 1);
+        archive.addReplay(m + 1, ruleSetIndex, match.fixedPoint, match.seed, match.inputs.data(), (int)match.inputs.size());
+        ticks = ticks + match.inputs.size();
+    }
+    if (archive.close() == false)
+    {
+        cout << "Error: Could not write " << path << endl;
+        return 1;
+    }
 
-            if (flashTimer == 0)
-            {
-                player1->resetColor();
-                player2->resetColor();
-                flashPlayer = 0;
-            }
-        }
+    double minutes = ticks / (60.0 * 60.0);
+    cout << "Stored " << matchCount << " matches, " << minutes << " minutes of play, in " << archive.getBytesWritten()
+         << " bytes (" << archive.getBytesWritten() / max(minutes, 1e-9) << " bytes/minute) in "
+         << clock.getElapsedTime().asSeconds() << " s" << endl;
+    return 0;
+}
+
+// Sizes of a replay archive, then the cost of seeking to random ticks
+int runReplayInfo(const string& path)
+{
+    ReplayReader reader;
+    if (reader.open(path) == false)
+    {
+        cout << "Error: Could not read " << path << endl;
+        return 1;
     }
 
-    // Check if score qualifies for high score
-    void checkHighScore(int score)
+    ifstream file(path, ios::binary | ios::ate);
+    long long fileBytes = (long long)file.tellg();
+    long long ticks = 0;
+    long long blocks = 0;
+    for (int i = 0; i < reader.getReplayCount(); i++)
     {
-        if (highScoreManager.isHighScore(score) == true)
-        {
-            if (winner == 1)
-            {
-                highScoreManager.addHighScore(player1Name, score);
-            }
-            else
-            {
-                highScoreManager.addHighScore(player2Name, score);
-            }
-        }
+        ticks = ticks + reader.getReplay(i).ticks;
+        blocks = blocks + reader.getBlockCount(i);
     }
+    double minutes = ticks / (60.0 * 60.0);
+    cout << reader.getReplayCount() << " replays, " << minutes << " minutes of play, " << blocks << " blocks, "
+         << fileBytes << " bytes (" << fileBytes / max(minutes, 1e-9) << " bytes/minute)" << endl;
 
-    // Render everything
-    void render()
+    if (reader.getReplayCount() == 0)
     {
-        gameWindow.clear(GameConstants::BACKGROUND_COLOR);
+        return 0;
+    }
 
-        if (nameInputState > 0)
-        {
-            renderNameInput();
-        }
-        else if (gameState == 0)
-        {
-            renderMenu();
-        }
-        else if (gameState == 1)
-        {
-            renderGame();
-        }
-        else if (gameState == 2)
-        {
-            renderPaused();
-        }
-        else if (gameState == 3)
-        {
-            renderGameOver();
-        }
-        else if (gameState == 4)
+    const int SEEKS = 10000;
+    unsigned int random = 99;
+    long long readBefore = reader.getBytesRead();
+    MatchState state;
+    Clock clock;
+    for (int i = 0; i < SEEKS; i++)
+    {
+        random = random * 1664525 + 1013904223;
+        int replay = (int)((random >> 8) % reader.getReplayCount());
+        random = random * 1664525 + 1013904223;
+        int tick = (int)((random >> 8) % (reader.getReplay(replay).ticks + 1));
+        if (reader.seek(replay, tick, state) == false || state.tick != tick)
         {
-            renderHighScores();
+            cout << "Error: seek to tick " << tick << " of match " << reader.getReplay(replay).matchId << " failed" << endl;
+            return 1;
         }
-
-        gameWindow.display();
     }
+    cout << "Random seeks: " << clock.getElapsedTime().asMicroseconds() / (double)SEEKS << " us and "
+         << (reader.getBytesRead() - readBefore) / SEEKS << " bytes read each" << endl;
+    return 0;
+}
 
-    // Render name input screen
-    void renderNameInput()
+int runReplaySeek(const string& path, uint64_t matchId, int tick)
+{
+    ReplayReader reader;
+    if (reader.open(path) == false)
     {
-        if (nameInputState == 1)
-        {
-
-            textRenderer.drawCentered(gameWindow, "ENTER PLAYER 1 NAME", 50, 150, Color::Cyan);
+        cout << "Error: Could not read " << path << endl;
+        return 1;
+    }
+    int replay = reader.findReplay(matchId);
+    if (replay < 0)
+    {
+        cout << "Error: no match " << matchId << " in " << path << endl;
+        return 1;
+    }
 
+    MatchState state;
+    if (reader.seek(replay, tick, state) == false)
+    {
+        cout << "Error: match " << matchId << " has " << reader.getReplay(replay).ticks << " ticks" << endl;
+        return 1;
+    }
+    cout << "Match " << matchId << " (" << RuleSetRegistry::all()[reader.getReplay(replay).ruleSet].name
+         << ((reader.getReplay(replay).flags & ReplayArchive::FLAG_FIXED_POINT) != 0 ? ", fixed point" : "")
+         << ") at tick " << state.tick << " of " << reader.getReplay(replay).ticks << ", " << reader.getBytesRead()
+         << " bytes read" << endl;
+    writeSoakState(cout, "state", state);
+    return 0;
+}
 
-            textRenderer.drawCentered(gameWindow, "Type name using keyboard (max 10 letters)", 24, 220);
-            textRenderer.drawCentered(gameWindow, "Press ENTER to continue, ESC to cancel", 20, 260);
 
+// Play one computer-vs-computer match the way the game records it for a submission
+template <class State>
+void playSubmissionSample(State& state, unsigned int (*aiInput)(const State&, int),
+                          unsigned int (*step)(State&, unsigned int), int maxScore, ScoreSubmission& out)
+{
+    const int MAX_TICKS = 200000;
+    out.keyframes.clear();
+    out.inputs.clear();
+    out.checks.clear();
+    while (state.score1 < maxScore && state.score2 < maxScore && (int)out.inputs.size() < MAX_TICKS)
+    {
+        if (out.inputs.size() % ReplayArchive::KEYFRAME_INTERVAL == 0)
+        {
+            uint32_t words[ReplayArchive::STATE_WORDS];
+            memcpy(words, &state, ReplayArchive::KEYFRAME_BYTES);
+            out.keyframes.insert(out.keyframes.end(), words, words + ReplayArchive::STATE_WORDS);
+        }
+        unsigned int inputs = aiInput(state, 1) | aiInput(state, 2);
+        out.inputs.push_back((unsigned char)inputs);
+        step(state, inputs);
+        out.checks.push_back(ScoreSubmission::checkState(&state));
+    }
+    out.score1 = state.score1;
+    out.score2 = state.score2;
+}
 
-            drawInputBox(350, currentInput, cursorVisible);
+// Write a backlog of submissions from computer-vs-computer matches. With
+// forgeEvery above 0 every forgeEvery-th one is forged, in turn by claiming
+// the loser's score, by idling player 1 for the second half, or by starting
+// from an edited save.
+int runSubmissionSample(const string& path, int count, int forgeEvery, const string& ruleSetName)
+{
+    const RuleSet* ruleSet = RuleSetRegistry::find(ruleSetName);
+    if (ruleSet == nullptr)
+    {
+        cout << "Error: unknown rule set " << ruleSetName << endl;
+        return 1;
+    }
 
+    ofstream file(path, ios::binary | ios::trunc);
+    if (file.is_open() == false)
+    {
+        cout << "Error: Could not create " << path << endl;
+        return 1;
+    }
 
-            textRenderer.drawCentered(gameWindow, "Player 1 will appear as:", 24, 450);
-            string displayName;
-            if (currentInput.empty())
+    ScoreSubmission submission;
+    vector<ReplayArchive::Run> runs;
+    vector<unsigned char> bytes;
+    int forged = 0;
+    for (int i = 0; i < count; i++)
+    {
+        submission.matchId = (uint64_t)(i + 1);
+        submission.name = "Player" + to_string(i % 100);
+        submission.ruleSet = (int)(ruleSet - &RuleSetRegistry::all()[0]);
+        submission.seed = 9000 + i;
+        FixedMatchState state;
+        ruleSet->resetFixed(state, submission.seed);
+        submission.flags = ReplayArchive::FLAG_FIXED_POINT;
+        playSubmissionSample(state, ruleSet->aiInputFixed, ruleSet->stepFixed, ruleSet->maxScore, submission);
+
+        if (forgeEvery > 0 && (i + 1) % forgeEvery == 0)
+        {
+            int kind = (i + 1) / forgeEvery % 3;
+            if (kind == 0)
             {
-                displayName = "Player 1";
+                swap(submission.score1, submission.score2);
+            }
+            else if (kind == 1)
+            {
+                for (size_t t = submission.inputs.size() / 2; t < submission.inputs.size(); t++)
+                {
+                    submission.inputs[t] = (unsigned char)(submission.inputs[t] & (INPUT_P2_UP | INPUT_P2_DOWN));
+                }
             }
             else
             {
-                displayName = currentInput;
+                submission.keyframes[6] = submission.keyframes[6] + 5;
             }
-            textRenderer.drawCentered(gameWindow, displayName, 36, 500, GameConstants::PLAYER1_COLOR);
+            forged = forged + 1;
         }
-        else if (nameInputState == 2)
-        {
-
-            textRenderer.drawCentered(gameWindow, "ENTER PLAYER 2 NAME", 50, 150, Color::Cyan);
-
-            // Show player 1's name
-            textRenderer.drawCentered(gameWindow, "Player 1: " + player1Name, 28, 220, GameConstants::PLAYER1_COLOR);
 
-            // Instructions
-            textRenderer.drawCentered(gameWindow, "Type name using keyboard (max 10 letters)", 24, 280);
-            textRenderer.drawCentered(gameWindow, "Press ENTER to continue, ESC to cancel", 20, 320);
+        ScoreSubmissionLog::encode(submission, runs, bytes);
+        file.write((const char*)bytes.data(), bytes.size());
+    }
+    if (file.good() == false)
+    {
+        cout << "Error: Could not write " << path << endl;
+        return 1;
+    }
+    cout << "Wrote " << count << " submissions, " << forged << " of them forged, " << (long long)file.tellp()
+         << " bytes" << endl;
+    return 0;
+}
 
-            // Draw input box
-            drawInputBox(400, currentInput, cursorVisible);
+// Play every queued submission again on all cores, report the ones that do not
+// reproduce, and add the rest to a high score table
+int runScoreVerifier(const string& path, const string& tablePath)
+{
+    vector<unsigned char> bytes;
+    vector<size_t> offsets;
+    if (ScoreSubmissionLog::read(path, bytes, offsets) == false)
+    {
+        cout << "Error: Could not read " << path << endl;
+        return 1;
+    }
+    int count = (int)offsets.size() - 1;
+    if (offsets.back() != bytes.size())
+    {
+        cout << "Ignoring " << bytes.size() - offsets.back() << " bytes of a cut-off submission at the end" << endl;
+    }
 
-            // Preview
-            textRenderer.drawCentered(gameWindow, "Player 2 will appear as:", 24, 500);
-            string displayName;
-            if (currentInput.empty())
-            {
-                displayName = "Player 2";
-            }
-            else
+    struct Result
+    {
+        bool decoded;
+        SubmissionVerdict verdict;
+        uint64_t matchId;
+        string name;
+        int score1;
+        int score2;
+        int ticks;
+    };
+    vector<Result> results(count);
+
+    // Submissions differ a lot in length, so threads take small batches as they finish
+    const int BATCH = 16;
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    atomic<int> next(0);
+    Clock clock;
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++)
+    {
+        workers.push_back(thread([&]()
+        {
+            ScoreSubmission submission;
+            vector<ReplayArchive::Run> runs;
+            while (true)
             {
-                displayName = currentInput;
+                int first = next.fetch_add(BATCH);
+                if (first >= count)
+                {
+                    return;
+                }
+                for (int i = first; i < min(first + BATCH, count); i++)
+                {
+                    Result& result = results[i];
+                    result.decoded = ScoreSubmissionLog::decode(&bytes[offsets[i]], offsets[i + 1] - offsets[i], runs,
+                                                                submission);
+                    if (result.decoded == false)
+                    {
+                        continue;
+                    }
+                    result.verdict = verifySubmission(submission);
+                    result.matchId = submission.matchId;
+                    result.name = submission.name;
+                    result.score1 = submission.score1;
+                    result.score2 = submission.score2;
+                    result.ticks = (int)submission.inputs.size();
+                }
             }
-            textRenderer.drawCentered(gameWindow, displayName, 36, 550, GameConstants::PLAYER2_COLOR);
-        }
+        }));
     }
-
-    // Draw input box with cursor
-    void drawInputBox(float yPos, string text, bool showCursor)
+    for (size_t t = 0; t < workers.size(); t++)
     {
-        // Draw background rectangle
-        RectangleShape inputBox(Vector2f(400, 50));
-        inputBox.setPosition(GameConstants::WINDOW_WIDTH / 2 - 200, yPos);
-        inputBox.setFillColor(Color(30, 30, 60, 200));
-        inputBox.setOutlineThickness(2);
-        inputBox.setOutlineColor(Color::White);
-        gameWindow.draw(inputBox);
+        workers[t].join();
+    }
+    double seconds = clock.getElapsedTime().asMicroseconds() / 1e6;
+
+    HighScoreManager table;
+    table.setFilename(tablePath);
+    table.loadHighScores();
+
+    // Match ids accepted by earlier runs, one per line next to the table; a copy is never counted twice
+    string idsPath = tablePath + ".ids";
+    vector<uint64_t> verifiedIds;
+    ifstream idsFile(idsPath);
+    unsigned long long id;
+    while (idsFile >> id)
+    {
+        verifiedIds.push_back(id);
+    }
+    idsFile.close();
+    sort(verifiedIds.begin(), verifiedIds.end());
+    ofstream newIds(idsPath, ios::app);
 
-        // Draw text
-        if (text.empty() == false)
+    int accepted = 0;
+    long long ticks = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const Result& result = results[i];
+        if (result.decoded == false)
         {
-            textRenderer.drawCentered(gameWindow, text, 36, yPos + 25, GameConstants::INPUT_COLOR);
+            cout << "Rejected submission " << i << ": the record is malformed" << endl;
+            continue;
         }
-        else
+        ticks = ticks + result.ticks;
+        if (result.verdict.accepted == false)
         {
-            textRenderer.drawCentered(gameWindow, "Type here...", 36, yPos + 25, Color(150, 150, 150));
+            cout << "Rejected match " << result.matchId << " (" << result.name << ", " << result.score1 << "-"
+                 << result.score2 << "): " << result.verdict.reason << " at tick " << result.verdict.tick << endl;
+            continue;
         }
-
-
-        if (showCursor && nameInputState > 0)
+        vector<uint64_t>::iterator position = lower_bound(verifiedIds.begin(), verifiedIds.end(), result.matchId);
+        if (position != verifiedIds.end() && *position == result.matchId)
         {
-            // Simple cursor - just a vertical line
-            float cursorX;
-            if (text.empty())
-            {
-                cursorX = GameConstants::WINDOW_WIDTH / 2 - 190;
-            }
-            else
-            {
-
-                cursorX = GameConstants::WINDOW_WIDTH / 2 - 190 + (text.length() * 18);
-            }
+            cout << "Rejected match " << result.matchId << " (" << result.name << ", " << result.score1 << "-"
+                 << result.score2 << "): the match was already verified" << endl;
+            continue;
+        }
+        verifiedIds.insert(position, result.matchId);
+        newIds << result.matchId << endl;
 
-            RectangleShape cursor(Vector2f(2, 30));
-            cursor.setPosition(cursorX, yPos + 10);
-            cursor.setFillColor(Color::White);
-            gameWindow.draw(cursor);
+        accepted = accepted + 1;
+        int score = max(result.score1, result.score2);
+        if (table.isHighScore(score) == true)
+        {
+            table.addHighScore(result.name, score);
         }
     }
 
+    cout << count << " submissions, " << accepted << " accepted, " << count - accepted << " rejected, in " << seconds
+         << " s on " << threadCount << " threads (" << count / max(seconds, 1e-9) * 60 << " submissions/minute, "
+         << ticks / max(seconds, 1e-9) << " ticks/s)" << endl;
+    return 0;
+}
 
-    void renderMenu()
+// Cost of a log call on the calling thread, with every core logging at once.
+// Each round stays within the queue size, then waits for the writer to catch up.
+int runLoggerBenchmark()
+{
+    const int ROUNDS = 50;
+    const int CALLS = 1000;
+    Logger::setPath("logger_bench.log");
+    remove("logger_bench.log");
+
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    vector<double> callNs(threadCount);
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++)
     {
-        textRenderer.drawCentered(gameWindow, "Welcome To Ping Pong ", 50, 80, Color::Cyan);
-
-        textRenderer.drawCentered(gameWindow, "1. Start Two Player Game", 36, 180);
-        textRenderer.drawCentered(gameWindow, "2. Play with Computer", 36, 230);
-        textRenderer.drawCentered(gameWindow, "3. View High Scores", 36, 280);
-        textRenderer.drawCentered(gameWindow, "4. Load Saved Game", 36, 330);
-        textRenderer.drawCentered(gameWindow, "ESC. Exit Game", 36, 380);
-
-        textRenderer.drawCentered(gameWindow, "Player 1: W/D Keys", 24, 460);
-        textRenderer.drawCentered(gameWindow, "Player 2: Up/Down Arrows", 24, 500);
-        textRenderer.drawCentered(gameWindow, "P: Pause  R: Reset  S: Save", 24, 540);
-
-        vector<HighScoreEntry> highScores = highScoreManager.getHighScores();
-        if (highScores.empty() == false)
+        workers.push_back(thread([&, t]()
         {
-            string highScoreName = highScores[0].getName();
-            int highScoreValue = highScores[0].getScore();
-            string highScoreStr = "High Score: " + highScoreName + " - " + to_string(highScoreValue);
-            textRenderer.drawCentered(gameWindow, highScoreStr, 28, 600, Color::Yellow);
-        }
+            long long totalNs = 0;
+            for (int round = 0; round < ROUNDS; round++)
+            {
+                Clock clock;
+                for (int i = 0; i < CALLS; i++)
+                {
+                    Logger::debug("Benchmark record", LogField("thread", t), LogField("round", round),
+                                  LogField("value", i * 0.5), LogField("name", "benchmark"));
+                }
+                totalNs = totalNs + clock.getElapsedTime().asMicroseconds() * 1000LL;
+                Logger::flush();
+                this_thread::sleep_for(chrono::milliseconds(30));
+            }
+            callNs[t] = totalNs / (double)(ROUNDS * CALLS);
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
     }
 
-
-    void renderGame()
+    double mean = 0;
+    for (int t = 0; t < threadCount; t++)
     {
-        drawCenterLine();
+        mean = mean + callNs[t] / threadCount;
+    }
+    cout << threadCount << " threads, " << ROUNDS * CALLS << " calls each: " << mean << " ns per call, "
+         << Logger::getDropped() << " dropped" << endl;
+    cout << "Records are written to logger_bench.log" << endl;
+    return 0;
+}
 
-        player1->draw(gameWindow);
-        player2->draw(gameWindow);
-        gameBall->draw(gameWindow);
 
-        int score1 = player1->getScore();
-        int score2 = player2->getScore();
-        string scoreText = to_string(score1) + "   :   " + to_string(score2);
-        textRenderer.drawCentered(gameWindow, scoreText, 80, 30);
+// Watch columns x columns computer-vs-computer matches at once, each drawn as a
+// scaled-down court. Every board goes into the same two vertex batches, so the
+// frame costs two draw calls however many boards there are. Click a board to
+// follow it at full size; click again or press Escape to go back to the grid.
+int runObserver(int columns, const string& ruleSetName)
+{
+    const RuleSet* ruleSet = RuleSetRegistry::find(ruleSetName);
+    if (ruleSet == nullptr || columns < 1 || columns > 16)
+    {
+        cout << "Error: usage is --observe <columns 1-16> [rule set]" << endl;
+        return 1;
+    }
 
-        // Display player names
-        string leftPlayerName = player1Name;
-        string rightPlayerName;
+    AssetArchive archive;
+    GameText textRenderer;
+    GlyphCache glyphs;
+    if (archive.open("assets.pak") == true)
+    {
+        textRenderer.loadFont(archive);
+    }
+    if (textRenderer.isFontLoaded() == true)
+    {
+        glyphs.load(textRenderer.getFont());
+    }
 
-        if (isTwoPlayer == true)
-        {
-            rightPlayerName = player2Name;
-        }
-        else
+    int boardCount = columns * columns;
+    vector<MatchState> matches(boardCount);
+    unsigned int nextSeed = (unsigned int)time(nullptr);
+    for (int i = 0; i < boardCount; i++)
+    {
+        ruleSet->reset(matches[i], nextSeed);
+        nextSeed = nextSeed + 1;
+    }
+    long long finished = 0;
+    long long wins[2] = { 0, 0 };
+
+    RenderWindow window(VideoMode(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT), "A Ping Pong Game - Observer");
+    window.setFramerateLimit(60);
+    window.setKeyRepeatEnabled(false);
+
+    BatchRenderBackend backend(glyphs);
+    const string leftName = "Computer";
+    const string rightName = "Computer";
+    float cellWidth = (float)GameConstants::WINDOW_WIDTH / columns;
+    float cellHeight = (float)GameConstants::WINDOW_HEIGHT / columns;
+    float boardScale = 1.0f / columns * 0.97f;
+    int zoomed = -1;
+
+    Clock titleClock;
+    Clock buildClock;
+    float buildMs = 0;
+    char title[128];
+
+    while (window.isOpen())
+    {
+        Event event;
+        while (window.pollEvent(event))
         {
-            rightPlayerName = computerName;
+            if (event.type == Event::Closed)
+            {
+                window.close();
+            }
+            else if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)
+            {
+                if (zoomed == -1)
+                {
+                    window.close();
+                }
+                zoomed = -1;
+            }
+            else if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+            {
+                if (zoomed != -1)
+                {
+                    zoomed = -1;
+                }
+                else
+                {
+                    int column = min(columns - 1, max(0, (int)(event.mouseButton.x / cellWidth)));
+                    int row = min(columns - 1, max(0, (int)(event.mouseButton.y / cellHeight)));
+                    zoomed = row * columns + column;
+                }
+            }
         }
 
-        // Adjust positions to fit on screen
-        textRenderer.draw(gameWindow, leftPlayerName, 24, 150, 100, GameConstants::PLAYER1_COLOR);
-
-        // Calculate width of right player name
-        int rightNameWidth = rightPlayerName.length() * 15; // Approximate width
-        int rightNameX = GameConstants::WINDOW_WIDTH - 50 - rightNameWidth;
-        if (rightNameX < GameConstants::WINDOW_WIDTH - 200)
+        // One tick of every match; a finished match is replaced by a new one
+        for (int i = 0; i < boardCount; i++)
         {
-            rightNameX = GameConstants::WINDOW_WIDTH - 200;
+            MatchState& state = matches[i];
+            ruleSet->step(state, ruleSet->aiInput(state, 1) | ruleSet->aiInput(state, 2));
+            int winner = ruleSet->getWinner(state);
+            if (winner != 0)
+            {
+                finished = finished + 1;
+                wins[winner - 1] = wins[winner - 1] + 1;
+                ruleSet->reset(state, nextSeed);
+                nextSeed = nextSeed + 1;
+            }
         }
-        textRenderer.draw(gameWindow, rightPlayerName, 24, rightNameX, 100, GameConstants::PLAYER2_COLOR);
 
-        string modeText;
-        if (isTwoPlayer == true)
+        // The same MatchFrame drawing as the game's renderGame, once per board
+        buildClock.restart();
+        backend.begin();
+        int first = 0;
+        int last = boardCount;
+        if (zoomed != -1)
         {
-            modeText = "TWO PLAYER MODE";
+            first = zoomed;
+            last = zoomed + 1;
         }
-        else
+        for (int i = first; i < last; i++)
         {
-            modeText = "VS COMPUTER MOD";
-        }
+            if (zoomed == -1)
+            {
+                float x = (i % columns) * cellWidth + cellWidth * 0.015f;
+                float y = (i / columns) * cellHeight + cellHeight * 0.015f;
+                backend.setBoard(x, y, boardScale);
+            }
+            else
+            {
+                backend.setBoard(0, 0, 1);
+            }
 
+            backend.clear(GameConstants::BACKGROUND_COLOR);
+            MatchFrame::drawCenterLine(backend);
+            MatchFrame::drawCourt(backend, *ruleSet, matches[i]);
+            MatchFrame::drawScoreboard(backend, matches[i].score1, matches[i].score2, leftName, rightName);
+        }
+        buildMs = buildClock.getElapsedTime().asMicroseconds() / 1000.0f;
 
+        window.clear(Color(40, 40, 40));
+        backend.flush(window);
+        window.display();
 
-        textRenderer.draw(gameWindow, "P: Pause  R: Reset  S: Save  ESC: Menu", 18, 10,
-                         GameConstants::WINDOW_HEIGHT - 30);
+        if (titleClock.getElapsedTime().asSeconds() >= 1)
+        {
+            titleClock.restart();
+            snprintf(title, sizeof(title), "Observer - %d %s matches, %lld finished (%lld-%lld), %d vertices in %.2f ms",
+                     boardCount, ruleSet->name, finished, wins[0], wins[1], backend.getVertexCount(), buildMs);
+            window.setTitle(title);
+        }
     }
+    return 0;
+}
 
 
-    void drawCenterLine()
+int main(int argc, char* argv[])
+{
+    // p --pack-assets assets.pak font.ttf paddle_hit.wav wall_hit.wav score.wav
+    if (argc == 7 && string(argv[1]) == "--pack-assets")
     {
-        RectangleShape line(Vector2f(2, GameConstants::WINDOW_HEIGHT));
-        line.setPosition(GameConstants::WINDOW_WIDTH / 2, 0);
-        line.setFillColor(GameConstants::LINE_COLOR);
-        gameWindow.draw(line);
+        vector<string> names;
+        vector<string> files;
+        for (int i = 0; i < AssetArchive::REQUIRED_COUNT; i++)
+        {
+            names.push_back(AssetArchive::REQUIRED_ASSETS[i]);
+            files.push_back(argv[3 + i]);
+        }
 
-        for (int i = 0; i < GameConstants::WINDOW_HEIGHT; i = i + 40)
+        if (AssetArchive::pack(argv[2], names, files) == false)
         {
-            RectangleShape dash(Vector2f(2, 20));
-            dash.setPosition(GameConstants::WINDOW_WIDTH / 2, i);
-            dash.setFillColor(Color::White);
-            gameWindow.draw(dash);
+            return 1;
         }
+        return 0;
     }
 
-
-    void renderPaused()
+    if (argc == 2 && string(argv[1]) == "--bench-multiball")
     {
-        renderGame();
+        return runMultiBallBenchmark();
+    }
 
-        RectangleShape overlay(Vector2f(GameConstants::WINDOW_WIDTH, GameConstants::WINDOW_HEIGHT));
-        overlay.setFillColor(Color(0, 0, 0, 150));
-        gameWindow.draw(overlay);
+    if (argc == 2 && string(argv[1]) == "--bench-entities")
+    {
+        return runEntityBenchmark();
+    }
 
-        textRenderer.drawCentered(gameWindow, "GAME PAUSED", 70, 250, Color::Yellow);
-        textRenderer.drawCentered(gameWindow, "Press P or ESC to continue", 30, 350);
+    if (argc == 2 && string(argv[1]) == "--bench-rules")
+    {
+        return runRuleSetBenchmark();
+    }
 
-        int score1 = player1->getScore();
-        int score2 = player2->getScore();
-        string scoreStr = "Current Score: " + to_string(score1) + " - " + to_string(score2);
-        textRenderer.drawCentered(gameWindow, scoreStr, 36, 420);
+    if (argc == 2 && string(argv[1]) == "--bench-particles")
+    {
+        return runParticleBenchmark();
     }
 
+    if (argc == 2 && string(argv[1]) == "--bench-fixed")
+    {
+        return runFixedPointBenchmark();
+    }
 
-    void renderGameOver()
+    if (argc == 4 && string(argv[1]) == "--telemetry-generate")
     {
-        string winnerText;
-        Color winnerColor;
-        string winnerName;
+        return runTelemetryGenerate(argv[2], atoi(argv[3]));
+    }
 
-        if (winner == 1)
-        {
-            winnerName = player1Name;
-            winnerColor = GameConstants::PLAYER1_COLOR;
-        }
-        else
-        {
-            if (isTwoPlayer == true)
-            {
-                winnerName = player2Name;
-            }
-            else
-            {
-                winnerName = computerName;
-            }
-            winnerColor = GameConstants::PLAYER2_COLOR;
-        }
+    if (argc == 3 && string(argv[1]) == "--telemetry-query")
+    {
+        return runTelemetryQuery(argv[2]);
+    }
 
-        textRenderer.drawCentered(gameWindow, "GAME OVER", 80, 120, Color::Red);
-        textRenderer.drawCentered(gameWindow, winnerName + " WINS!", 60, 220, winnerColor);
+    if (argc == 3 && string(argv[1]) == "--soak")
+    {
+        return runSoakTest(atoi(argv[2]));
+    }
 
-        int score1 = player1->getScore();
-        int score2 = player2->getScore();
-        string finalScore = "Final Score: " + to_string(score1) + " - " + to_string(score2);
-        textRenderer.drawCentered(gameWindow, finalScore, 40, 320);
+    if (argc == 4 && string(argv[1]) == "--soak-repro")
+    {
+        return runSoakRepro(atoll(argv[2]), atoi(argv[3]));
+    }
 
-        textRenderer.drawCentered(gameWindow, "Press ENTER to return to menu", 30, 420);
-        textRenderer.drawCentered(gameWindow, "Press R to play again", 30, 470);
+    if (argc == 3 && string(argv[1]) == "--history")
+    {
+        return runHistoryQuery("match_history.dat", argv[2]);
+    }
 
-        int winningScore;
-        if (winner == 1)
-        {
-            winningScore = player1->getScore();
-        }
-        else
+    if (argc == 4 && string(argv[1]) == "--bench-history")
+    {
+        if (atoi(argv[2]) < 1 || atoi(argv[3]) < 2)
         {
-            winningScore = player2->getScore();
+            cout << "Error: the history benchmark needs at least 1 match and 2 players" << endl;
+            return 1;
         }
+        return runHistoryBenchmark(atoi(argv[2]), atoi(argv[3]));
+    }
 
-        if (highScoreManager.isHighScore(winningScore) == true)
+    // p --sweep <rule set> grid|random <steps|configurations> <matches> <output>
+    if (argc == 7 && string(argv[1]) == "--sweep")
+    {
+        string mode = argv[3];
+        if (mode != "grid" && mode != "random")
         {
-            textRenderer.drawCentered(gameWindow, "NEW HIGH SCORE!", 40, 550, Color::Yellow);
+            cout << "Error: sweep mode must be grid or random" << endl;
+            return 1;
         }
+        return runParameterSweep(argv[2], mode == "grid", atoi(argv[4]), atoi(argv[5]), argv[6]);
     }
 
-
-    void renderHighScores()
+    if (argc == 3 && string(argv[1]) == "--sweep-report")
     {
-        highScoreManager.displayHighScores(gameWindow, textRenderer);
+        return runSweepReport(argv[2]);
     }
 
-
-    void startNewGame()
+    if (argc == 4 && string(argv[1]) == "--flight-decode")
     {
-        player1->setScore(0);
-        player2->setScore(0);
-        player1->resetPosition();
-        player2->resetPosition();
-        gameBall->reset();
-        gameState = 1;
-        winner = 0;
-        flashTimer = 0;
-        flashPlayer = 0;
+        return runFlightDecode(argv[2], argv[3]);
     }
 
+    if (argc == 2 && string(argv[1]) == "--bench-flight")
+    {
+        return runFlightRecorderBenchmark();
+    }
 
-    void resetGame()
+    if (argc == 2 && string(argv[1]) == "--bench-logger")
     {
-        player1->setScore(0);
-        player2->setScore(0);
-        player1->resetPosition();
-        player2->resetPosition();
-        gameBall->reset();
-        flashTimer = 0;
-        flashPlayer = 0;
+        return runLoggerBenchmark();
     }
 
-    // Save game state to file
-    void saveGame()
+    // p --policy-baseline <file> [rule set]
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--policy-baseline")
     {
-        ofstream saveFile("game_save.dat");
+        return runPolicyBaseline(argv[2], argc == 4 ? argv[3] : "classic");
+    }
 
-        if (saveFile.is_open() == false)
-        {
-            cout << "Error: Could not save game!" << endl;
-            return;
-        }
+    // p --policy-eval <file> <matches> [rule set]
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "--policy-eval")
+    {
+        return runPolicyEvaluation(argv[2], max(1, atoi(argv[3])), argc == 5 ? argv[4] : "classic");
+    }
 
-        saveFile << player1->getScore() << endl;
-        saveFile << player2->getScore() << endl;
-        saveFile << isTwoPlayer << endl;
-        saveFile << gameState << endl;
-        saveFile << player1Name << endl;
-        saveFile << player2Name << endl;
+    // p --replay-pack <file> <matches> [rule set]
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "--replay-pack")
+    {
+        return runReplayPack(argv[2], max(1, atoi(argv[3])), argc == 5 ? argv[4] : "classic");
+    }
 
-        saveFile.close();
-        cout << "Game saved successfully!" << endl;
+    if (argc == 3 && string(argv[1]) == "--replay-info")
+    {
+        return runReplayInfo(argv[2]);
     }
 
-    // Load game state from file
-    void loadGame()
+    // p --replay-seek <file> <match id> <tick>
+    if (argc == 5 && string(argv[1]) == "--replay-seek")
     {
-        ifstream loadFile("game_save.dat");
+        return runReplaySeek(argv[2], strtoull(argv[3], nullptr, 10), atoi(argv[4]));
+    }
 
-        if (loadFile.is_open() == false)
-        {
-            cout << "Error: No saved game found!" << endl;
-            return;
-        }
+    // p --submissions-sample <file> <submissions> [forge every] [rule set]
+    if (argc >= 4 && argc <= 6 && string(argv[1]) == "--submissions-sample")
+    {
+        return runSubmissionSample(argv[2], max(1, atoi(argv[3])), argc >= 5 ? atoi(argv[4]) : 0,
+                                   argc == 6 ? argv[5] : "classic");
+    }
 
-        int score1;
-        int score2;
-        bool twoPlayer;
-        int state;
-        string name1;
-        string name2;
+    // p --verify-scores <file> [high score file]
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--verify-scores")
+    {
+        return runScoreVerifier(argv[2], argc == 4 ? argv[3] : "verified_highscores.txt");
+    }
 
-        loadFile >> score1;
-        loadFile >> score2;
-        loadFile >> twoPlayer;
-        loadFile >> state;
-        loadFile >> name1;
-        loadFile >> name2;
+    // p --bench-timers <timers> <ticks>
+    if (argc == 4 && string(argv[1]) == "--bench-timers")
+    {
+        return runTimerBenchmark(max(1, atoi(argv[2])), max(1, atoi(argv[3])));
+    }
 
-        player1->setScore(score1);
-        player2->setScore(score2);
-        isTwoPlayer = twoPlayer;
-        gameState = state;
-        player1Name = name1;
-        player2Name = name2;
+    // p --observe <columns> [rule set]
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--observe")
+    {
+        return runObserver(atoi(argv[2]), argc == 4 ? argv[3] : "classic");
+    }
 
-        loadFile.close();
-        cout << "Game loaded successfully!" << endl;
+    // p --export-match <seed> <frames> <output> png|raw
+    if (argc == 6 && string(argv[1]) == "--export-match")
+    {
+        string format = argv[5];
+        if (format != "png" && format != "raw")
+        {
+            cout << "Error: export format must be png or raw" << endl;
+            return 1;
+        }
+        if (atoi(argv[3]) < 1)
+        {
+            cout << "Error: export needs at least 1 frame" << endl;
+            return 1;
+        }
+        return runMatchExport((unsigned int)strtoul(argv[2], nullptr, 10), atoi(argv[3]), argv[4], format == "raw");
     }
-};
 
+#ifdef PINGPONG_PROFILE
+    if (argc == 2 && string(argv[1]) == "--bench-profiler")
+    {
+        return runProfilerBenchmark();
+    }
+#endif
 
-int main()
-{
+#ifdef PINGPONG_COUNT_ALLOCS
+    if (argc == 2 && string(argv[1]) == "--alloc-test")
+    {
+        GameManager game;
+        if (game.runAllocationTest() != 0)
+        {
+            return 1;
+        }
+        return 0;
+    }
+#endif
 
     cout<<"PING PONG GAME"<<endl;
+    Metrics::startServer();
 
     GameManager game;
+    if (argc == 2 && string(argv[1]) == "--fixed-point")
+    {
+        game.setFixedPointPhysics(true);
+    }
     game.run();
 
     cout<<"Game ended successfully"<<endl;